@@ -231,11 +231,7 @@ static value* make_code_from_args(pool* p, const char* line, va_list args) {
     static char buffer[BUFFER_SIZE];
     vsnprintf(buffer, sizeof(buffer), line, args);
 
-    value* source = parse_from_str(buffer);
-    value* result = pool_import(p, source);
-    value_dispose(source);
-
-    return result;
+    return parse_from_str_using(buffer, pool_allocate, p);
 }
 
 static value* make_code(pool* p, const char* line, ...) {
@@ -1095,7 +1091,7 @@ static value* make_application_sequence(
     value* op_seq = compile_rec(p, op_exp, "proc", "next");
 
     value* call_seq;
-    if (op_exp != NULL && op_exp->type == VALUE_SYMBOL && is_primitive(op_exp->symbol)) {
+    if (op_exp != NULL && op_exp->type == VALUE_SYMBOL && is_primitive(op_exp)) {
         call_seq = compile_primitive_call(p, target, linkage);
     } else {
         call_seq = compile_general_call(p, target, linkage);
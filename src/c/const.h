@@ -2,11 +2,23 @@
 #define COMMON_H_
 
 #define BUFFER_SIZE 16348
-#define INITIAL_NUM_BUCKETS 5
+#define MAP_INLINE_RECORDS 8
 #define MAX_ERROR_ARGS 5
 
 #define MAX_STACK_VALUES 100000
-#define MAX_GARBAGE_VALUES 1000000
+#define POOL_SLAB_SIZE (64 * 1024)
+
+#define GC_COPYING 0  // 1: the machines' pools collect by copying
+#define GC_GROWTH_FACTOR 2.0
+#define GC_MIN_ALLOWANCE 1000000
+#define GC_MAX_ALLOWANCE 64000000
+#define GC_SOFT_LIMIT 0
+#define GC_STEP_INTERVAL 100
+#define GC_STEP_QUANTUM 10000
+#define GC_STEP_BUDGET 0.001
+#define GC_THREADS 1  // >1: full collections mark and sweep in parallel
+#define GC_PAUSE_BUCKETS 5
+#define GC_PAUSE_BUCKET_BASE 1e-4
 
 #define HISTORY_PATH "./.history"
 #define EVALUATOR_PATH "./lib/machines/evaluator.scm"
@@ -8,9 +8,9 @@
 #include "pool.h"
 #include "value.h"
 
-map_record* env_lookup(const value* env, const char* name, const int recursive) {
+map_record* env_lookup(const value* env, const value* name, const int recursive) {
     while (env != NULL) {
-        map_record* r = map_get((map*)env->ptr, name);
+        map_record* r = map_get((map*)env->ptr, name->symbol);
 
         if (r != NULL) {
             return r;
@@ -24,18 +24,30 @@ map_record* env_lookup(const value* env, const char* name, const int recursive)
     return NULL;
 }
 
+value* env_lookup_frame(const value* env, const value* name) {
+    while (env != NULL) {
+        if (map_has((map*)env->ptr, name->symbol)) {
+            return (value*)env;
+        }
+        env = env->cdr;
+    }
+
+    return NULL;
+}
+
 value* env_get_value(const map_record* r) {
-    return r->val->car;
+    return r->val;
 }
 
-void env_update_value(map_record* r, value* v) {
-    r->val->car = v;
+void env_update_value(value* frame, map_record* r, value* v, pool* p) {
+    // the frame holds the record
+    r->val = v;
+    pool_write_barrier(p, frame);
 }
 
-void env_add_value(value* env, const char* name, value* v, pool* p) {
-    // to keep a tracable link to the val during GC
-    env->car = pool_new_pair(p, v, env->car);
-    map_add((map*)env->ptr, name, env->car);
+void env_add_value(value* env, const value* name, value* v, pool* p) {
+    map_add((map*)env->ptr, name->symbol, v);
+    pool_write_barrier(p, env);
 }
 
 value* env_extend(value* env, value* parent_env) {
@@ -5,11 +5,15 @@
 #include "pool.h"
 #include "value.h"
 
-map_record* env_lookup(const value* env, const char* name, const int recursive);
+// the names are (interned) symbols. an env is a frame: its
+// map's records bind the names directly to the values (the
+// pools trace them) and its cdr is the parent env
+map_record* env_lookup(const value* env, const value* name, const int recursive);
+value* env_lookup_frame(const value* env, const value* name);
 
 value* env_get_value(const map_record* r);
-void env_update_value(map_record* r, value* v);
-void env_add_value(value* env, const char* name, value* v, pool* p);
+void env_update_value(value* frame, map_record* r, value* v, pool* p);
+void env_add_value(value* env, const value* name, value* v, pool* p);
 
 value* env_extend(value* env, value* parent_env);
 
@@ -393,10 +393,10 @@ static value* op_lookup_variable_value(machine* m, const value* args) {
     value* env = args->cdr->car->car;
 
     value* primitive;
-    if ((primitive = get_primitive(name->symbol)) != NULL) {
+    if ((primitive = get_primitive(name)) != NULL) {
         return primitive;
     } else {
-        map_record* record = env_lookup(env, name->symbol, 1);
+        map_record* record = env_lookup(env, name, 1);
 
         if (record == NULL) {
             return pool_new_error(m->pool, "%s is unbound", name->symbol);
@@ -411,15 +411,16 @@ static value* op_set_variable_value(machine* m, const value* args) {
     value* val = args->cdr->car->car;
     value* env = args->cdr->cdr->car->car;
 
-    if (is_primitive(name->symbol)) {
+    if (is_primitive(name)) {
         return pool_new_error(m->pool, "can't update the <primitive '%s'>", name->symbol);
     } else {
-        map_record* record = env_lookup(env, name->symbol, 1);
+        value* frame = env_lookup_frame(env, name);
 
-        if (record == NULL) {
+        if (frame == NULL) {
             return pool_new_error(m->pool, "%s is unbound", name->symbol);
         } else {
-            env_update_value(record, val);
+            map_record* record = env_lookup(frame, name, 0);
+            env_update_value(frame, record, val, m->pool);
 
             return NULL;
         }
@@ -431,17 +432,17 @@ static value* op_define_variable(machine* m, const value* args) {
     value* val = args->cdr->car->car;
     value* env = args->cdr->cdr->car->car;
 
-    if (is_primitive(name->symbol)) {
+    if (is_primitive(name)) {
         return pool_new_error(m->pool, "can't update the <primitive '%s'>", name->symbol);
     } else {
-        map_record* record = env_lookup(env, name->symbol, 0);
+        map_record* record = env_lookup(env, name, 0);
 
         if (record == NULL) {
-            env_add_value(env, name->symbol, val, m->pool);
+            env_add_value(env, name, val, m->pool);
 
             return pool_new_info(m->pool, "%s is defined", name->symbol);
         } else {
-            env_update_value(record, val);
+            env_update_value(env, record, val, m->pool);
 
             return pool_new_info(m->pool, "%s is updated", name->symbol);
         }
@@ -485,10 +486,10 @@ static value* op_extend_environment(machine* m, const value* args) {
             if (names->type == VALUE_SYMBOL) {
                 // the rest of the values are bound
                 // to the parameter y in (x . y)
-                env_add_value(env, names->symbol, values, m->pool);
+                env_add_value(env, names, values, m->pool);
                 break;
             } else {
-                env_add_value(env, names->car->symbol, values->car, m->pool);
+                env_add_value(env, names->car, values->car, m->pool);
             }
             names = names->cdr;
             values = values->cdr;
@@ -513,30 +514,41 @@ static value* op_add_dispatch_record(machine* m, const value* args) {
     value* name = args->cdr->car->car;
     value* label = args->cdr->cdr->car;
 
-    env_add_value(dispatch, name->symbol, label, m->pool);
+    // the name is a string: keyed by its symbol
+    env_add_value(dispatch, value_new_symbol(name->symbol), label, m->pool);
 
     return dispatch;
 }
 
 static value* op_dispatch_on_type(machine* m, const value* args) {
+    // interned once: looked up by the pointers
+    static value* self_symbol = NULL;
+    static value* var_symbol = NULL;
+    static value* default_symbol = NULL;
+    if (self_symbol == NULL) {
+        self_symbol = value_new_symbol("self");
+        var_symbol = value_new_symbol("var");
+        default_symbol = value_new_symbol("default");
+    }
+
     value* exp = args->car->car;
     value* dispatch = args->cdr->car->car;
 
     map_record* record = NULL;
     if (is_self_evaluating(exp)) {
         // self-evaluating expression
-        record = env_lookup(dispatch, "self", 0);
+        record = env_lookup(dispatch, self_symbol, 0);
     } else if (is_variable(exp)) {
         // named variable
-        record = env_lookup(dispatch, "var", 0);
+        record = env_lookup(dispatch, var_symbol, 0);
     } else if (starts_with_symbol(exp)) {
         // maybe special form (list starting with a symbol)
-        record = env_lookup(dispatch, exp->car->symbol, 0);
+        record = env_lookup(dispatch, exp->car, 0);
     }
 
     if (record == NULL) {
         // default dispatch (application)
-        record = env_lookup(dispatch, "default", 0);
+        record = env_lookup(dispatch, default_symbol, 0);
     }
 
     return env_get_value(record)->car;
@@ -652,10 +664,10 @@ static value* make_global_environment(eval* e) {
     value* env = pool_new_env(e->machine->pool);
 
     // constants
-    env_add_value(env, "#t", pool_new_bool(p, 1), p);
-    env_add_value(env, "#f", pool_new_bool(p, 0), p);
-    env_add_value(env, "PI", pool_new_number(p, 3.1415926536), p);
-    env_add_value(env, "E", pool_new_number(p, 2.7182818285), p);
+    env_add_value(env, value_new_symbol("#t"), pool_new_bool(p, 1), p);
+    env_add_value(env, value_new_symbol("#f"), pool_new_bool(p, 0), p);
+    env_add_value(env, value_new_symbol("PI"), pool_new_number(p, 3.1415926536), p);
+    env_add_value(env, value_new_symbol("E"), pool_new_number(p, 2.7182818285), p);
 
     return env;
 }
@@ -667,10 +679,12 @@ eval* eval_new(const char* path_to_code) {
     assert(code->type != VALUE_ERROR);
     e->machine = machine_new(code, "val");
     value_dispose(code);
+    machine_set_incremental_gc(e->machine, GC_STEP_INTERVAL, GC_STEP_QUANTUM, GC_STEP_BUDGET);
+    machine_set_gc_threads(e->machine, GC_THREADS);
 
     bind_machine_ops(e);
 
-    e->env = make_global_environment(e);
+    e->env = machine_pin(e->machine, make_global_environment(e));
 
     return e;
 }
@@ -682,13 +696,53 @@ void eval_dispose(eval* e) {
 }
 
 value* eval_evaluate(eval* e, value* v) {
-    machine_get_register(e->machine, "env")->car = e->env;  // set the env
-    machine_copy_to_register(e->machine, "exp", v);         // set the input
-    machine_run(e->machine);                                // compute the output
+    value* env_reg = machine_get_register(e->machine, "env");
+    env_reg->car = e->env;  // set the env
+    pool_write_barrier(e->machine->pool, env_reg);
+
+    machine_copy_to_register(e->machine, "exp", v);  // set the input
+    machine_run(e->machine);                         // compute the output
 
     return machine_export_output(e->machine);
 }
 
+value* eval_parse_from_str(eval* e, const char* input) {
+    value* result = parse_from_str_using(input, pool_allocate, e->machine->pool);
+
+    return machine_pin(e->machine, result);
+}
+
+value* eval_parse_from_file(eval* e, const char* path) {
+    value* result = parse_from_file_using(path, pool_allocate, e->machine->pool);
+
+    return machine_pin(e->machine, result);
+}
+
+value* eval_evaluate_pinned(eval* e, value* v) {
+    value* env_reg = machine_get_register(e->machine, "env");
+    env_reg->car = e->env;  // set the env
+    pool_write_barrier(e->machine->pool, env_reg);
+
+    machine_set_register(e->machine, "exp", v);  // set the input
+    machine_run(e->machine);                     // compute the output
+
+    return machine_pin_output(e->machine);
+}
+
+value* eval_next_pinned(eval* e, value* v) {
+    // the next pair is pinned before v is
+    // released: a cursor along a pinned list
+    value* next = machine_pin(e->machine, v->cdr);
+    machine_release(e->machine, v);
+
+    return next;
+}
+
+void eval_release(eval* e, value* v) {
+    machine_release(e->machine, v);
+}
+
 void eval_reset_env(eval* e) {
-    e->env = make_global_environment(e);
+    machine_release(e->machine, e->env);
+    e->env = machine_pin(e->machine, make_global_environment(e));
 }
@@ -15,6 +15,14 @@ eval* eval_new(const char* path_to_code);
 void eval_dispose(eval* e);
 
 value* eval_evaluate(eval* e, value* v);
+
+// zero-copy: parsed right into the machine's pool, the
+// input and the output pinned there until released
+value* eval_parse_from_str(eval* e, const char* input);
+value* eval_parse_from_file(eval* e, const char* path);
+value* eval_evaluate_pinned(eval* e, value* v);
+value* eval_next_pinned(eval* e, value* v);
+void eval_release(eval* e, value* v);
 void eval_reset_env(eval* e);
 
 #endif  // EVAL_H_
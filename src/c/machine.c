@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <locale.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -20,61 +21,81 @@ typedef enum {
     INST_RESTORE = 5,
 } instruction_type;
 
+#define NO_POSITION SIZE_MAX  // the pc of a halted machine
+
+// an instruction resolved from its value: the
+// records (pointer . name) of the registers,
+// labels, and ops, and the op's function
+struct machine_inst {
+    uint8_t type;   // instruction_type
+    value* reg;     // dst (assign, call, restore) or src (save) register
+    value* src;     // assign: src register, label, or const
+    value* target;  // branch: label; goto: register or label
+    value* op;      // call, branch: op
+    machine_op fn;  // call, branch: op's function (NULL if unbound)
+    value* args;    // call, branch: op's args
+    value* line;    // instrumented line (for tracing)
+};
+
 static double get_time() {
     struct timespec t;
     timespec_get(&t, TIME_UTC);
     return t.tv_sec + t.tv_nsec / 1000000000.0;
 }
 
-static value* get_or_create_record(machine* m, value* table, const char* name) {
-    value* pair = table->cdr;
-    value* record = NULL;
-    value* key = NULL;
-
-    while (pair != NULL) {
-        record = pair->car;
-        key = record->cdr;
-        if (strcmp(key->symbol, name) == 0) {
-            // found: the key matches the name
-            return record;
-        }
-        pair = pair->cdr;
-    }
-
-    // find the previous pair in the
-    // lexicographic order wrt. the name
-    value* prev = table;
-    while (prev->cdr != NULL && strcmp(prev->cdr->car->cdr->symbol, name) < 0) {
-        // the record's key is "less" than the name
-        prev = prev->cdr;
+static value* get_or_create_record(machine* m, value* table, value* index, const char* name) {
+    value* key = value_new_symbol(name);  // interned
+    map_record* r = env_lookup(index, key, 0);
+    if (r != NULL) {
+        // found by the name
+        return env_get_value(r);
     }
 
-    key = pool_new_symbol(m->pool, name);                   // new key
-    record = pool_new_pair(m->pool, NULL, key);             // NULL value
-    prev->cdr = pool_new_pair(m->pool, record, prev->cdr);  // add to the table
+    value* record = pool_new_pair(m->pool, NULL, key);        // NULL value
+    table->cdr = pool_new_pair(m->pool, record, table->cdr);  // add to the table
+    pool_write_barrier(m->pool, table);
+    env_add_value(index, key, record, m->pool);
 
     return record;
 }
 
 static value* get_register(machine* m, const char* name) {
-    return get_or_create_record(m, m->registers, name);
+    return get_or_create_record(m, m->registers, m->register_index, name);
 }
 
 static value* get_label(machine* m, const char* name) {
-    return get_or_create_record(m, m->labels, name);
+    return get_or_create_record(m, m->labels, m->label_index, name);
 }
 
 static value* get_op(machine* m, const char* name) {
-    return get_or_create_record(m, m->ops, name);
+    return get_or_create_record(m, m->ops, m->op_index, name);
 }
 
 static value* make_constant(machine* m, value* source) {
     value* constant = pool_import(m->pool, source);  // clone locally
     m->constants->cdr = pool_new_pair(m->pool, constant, m->constants->cdr);
+    pool_write_barrier(m->pool, m->constants);
 
     return m->constants->cdr;
 }
 
+static void create_indices(machine* m) {
+    // roots: not moved by a copying collection
+    m->register_index = pool_new_env(m->pool);
+    m->label_index = pool_new_env(m->pool);
+    m->op_index = pool_new_env(m->pool);
+
+    pool_register_root(m->pool, m->register_index);
+    pool_register_root(m->pool, m->label_index);
+    pool_register_root(m->pool, m->op_index);
+}
+
+static void cleanup_indices(machine* m) {
+    pool_unregister_root(m->pool, m->register_index);
+    pool_unregister_root(m->pool, m->label_index);
+    pool_unregister_root(m->pool, m->op_index);
+}
+
 static void create_backbone(machine* m, const char* output_register_name) {
     // chain of containers to keep the machine state:
     // cars are used as links, cdrs are for the content
@@ -85,8 +106,14 @@ static void create_backbone(machine* m, const char* output_register_name) {
     m->code_head = pool_new_pair(m->pool, m->ops, NULL);
     m->code_tail = pool_new_pair(m->pool, m->code_head, NULL);
     m->stack = pool_new_pair(m->pool, m->code_tail, NULL);
-    m->pc = pool_new_pair(m->pool, m->stack, NULL);
-    m->root = pool_new_pair(m->pool, m->pc, NULL);  // memory root
+    m->root = pool_new_pair(m->pool, m->stack, NULL);  // memory root
+
+    // the root's content: the slots to park
+    // the code tail and the output register
+    // during a copying collection
+    m->root->cdr = pool_new_pair(
+        m->pool, NULL,
+        pool_new_pair(m->pool, NULL, NULL));
 
     m->val = get_register(m, output_register_name);  // output register
     m->code_tail = m->code_head;                     // initially no code
@@ -95,6 +122,7 @@ static void create_backbone(machine* m, const char* output_register_name) {
 static void push_to_stack(machine* m, value* v) {
     // add a new record to the stack with the value as car
     m->stack->cdr = pool_new_pair(m->pool, v, m->stack->cdr);
+    pool_write_barrier(m->pool, m->stack);
 }
 
 static value* pop_from_stack(machine* m) {
@@ -102,6 +130,7 @@ static value* pop_from_stack(machine* m) {
 
     value* v = m->stack->cdr->car;       // pop the value
     m->stack->cdr = m->stack->cdr->cdr;  // evict the record
+    pool_write_barrier(m->pool, m->stack);
 
     return v;
 }
@@ -110,14 +139,25 @@ static void clear_stack(machine* m) {
     m->stack->cdr = NULL;
 }
 
-static value* call_op(machine* m, value* op, value* args) {
+static void set_position(value* code, const size_t position) {
+    // the code value refers to its instruction by the index:
+    // the array moves as it grows, the code value may too
+    code->ptr = (void*)(uintptr_t)position;
+}
+
+static size_t get_position(const value* code) {
+    // no code: halt
+    return (code != NULL ? (size_t)(uintptr_t)code->ptr : NO_POSITION);
+}
+
+static value* call_op(machine* m, value* op, machine_op fn, value* args) {
     value* result = NULL;
-    if (op->car == NULL) {
+    if (fn == NULL) {
         // the op record is not bound to a machine op
         result = pool_new_error(m->pool, "machine op %s is unbound", op->cdr->symbol);
     } else {
         // call the machine op
-        result = ((machine_op)op->car->ptr)(m, args);
+        result = fn(m, args);
     }
 
     return result;
@@ -127,14 +167,18 @@ static value* update_count_env(machine* m, value* env, value* table) {
     value* pair = table->cdr;
     while (pair != NULL) {
         value* record = pair->car;
-        char* name = record->cdr->symbol;
+        value* name = record->cdr;
 
-        if (env_lookup(env, name, 0) == NULL) {
-            // add the name's count (0) to the env if absent
-            value* count = pool_new_number(m->pool, 0);
-            env_add_value(env, name, count, m->pool);
+        if (env_lookup(env, name, 0) != NULL) {
+            // the new records are in front:
+            // the rest are in the env already
+            break;
         }
 
+        // add the name's count (0) to the env
+        value* count = pool_new_number(m->pool, 0);
+        env_add_value(env, name, count, m->pool);
+
         pair = pair->cdr;
     }
 
@@ -149,7 +193,7 @@ static void reset_count_env(value* env, value* table) {
 
         // reset each name's count to zero
         // (assuming every name is present in the env)
-        map_record* r = env_lookup(env, name->symbol, 0);
+        map_record* r = env_lookup(env, name, 0);
         value* count = env_get_value(r);
         count->number = 0;
 
@@ -157,7 +201,7 @@ static void reset_count_env(value* env, value* table) {
     }
 }
 
-static void increment_count(value* env, char* name) {
+static void increment_count(value* env, value* name) {
     // increment the name's current count
     map_record* r = env_lookup(env, name, 0);
     if (r != NULL) {  // ignore if the name isn't there
@@ -166,23 +210,43 @@ static void increment_count(value* env, char* name) {
     }
 }
 
+static int compare_records(const void* r1, const void* r2) {
+    // lexicographic order of the names
+    return strcmp((*(value**)r1)->cdr->symbol, (*(value**)r2)->cdr->symbol);
+}
+
 static void print_counts(value* env, value* table, const char* format) {
+    size_t num_records = 0;
     value* pair = table->cdr;
     while (pair != NULL) {
-        value* record = pair->car;
-        value* name = record->cdr;
+        num_records++;
+        pair = pair->cdr;
+    }
+
+    // the table is in the order of creation:
+    // sorted by the names only for printing
+    value** records = malloc(num_records * sizeof(value*));
+    pair = table->cdr;
+    for (size_t i = 0; i < num_records; i++) {
+        records[i] = pair->car;
+        pair = pair->cdr;
+    }
+    qsort(records, num_records, sizeof(value*), compare_records);
+
+    for (size_t i = 0; i < num_records; i++) {
+        value* name = records[i]->cdr;
 
         // retrieve the name's current count
-        map_record* r = env_lookup(env, name->symbol, 0);
+        map_record* r = env_lookup(env, name, 0);
         value* count = env_get_value(r);
 
         if (count->number > 0) {
             // print only if the count is positive
             printf(format, name->symbol, (long)count->number);
         }
-
-        pair = pair->cdr;
     }
+
+    free(records);
 }
 
 static void init_stats(machine* m) {
@@ -233,6 +297,12 @@ static void reset_stats(machine* m) {
     s->garbage_collected_times = 0;
     s->garbage_collected_values = 0;
     s->garbage_collection_time = 0;
+    s->garbage_max_pause = 0;
+    s->garbage_parallel_time = 0;
+    s->garbage_parallel_work = 0;
+    for (int i = 0; i < GC_PAUSE_BUCKETS; i++) {
+        s->garbage_pauses[i] = 0;
+    }
 
     s->flag = 0;
 
@@ -488,6 +558,72 @@ static void instrument_code(machine* m, value* line) {
     }
 }
 
+static size_t new_inst(machine* m) {
+    if (m->num_insts == m->max_insts) {
+        m->max_insts = (m->max_insts == 0 ? 1024 : 2 * m->max_insts);
+        m->insts = realloc(m->insts, m->max_insts * sizeof(machine_inst));
+    }
+
+    return m->num_insts++;
+}
+
+static void resolve_inst(machine* m, const value* code) {
+    // the instruction's values are in the code's
+    // car (instruction . line): the pointers to
+    // them are read once here, not on execution
+    machine_inst* inst = &m->insts[get_position(code)];
+    value* instruction = code->car->car;
+    value* operands = instruction->cdr;
+
+    inst->type = (int)instruction->car->number;
+    inst->reg = NULL;
+    inst->src = NULL;
+    inst->target = NULL;
+    inst->op = NULL;
+    inst->fn = NULL;
+    inst->args = NULL;
+    inst->line = code->car->cdr;
+
+    switch (inst->type) {
+        case INST_ASSIGN:
+            inst->reg = operands->car;
+            inst->src = operands->cdr;
+            break;
+        case INST_CALL:
+            inst->reg = operands->car;
+            inst->op = operands->cdr->car;
+            inst->args = operands->cdr->cdr;
+            break;
+        case INST_BRANCH:
+            inst->target = operands->car;
+            inst->op = operands->cdr->car;
+            inst->args = operands->cdr->cdr;
+            break;
+        case INST_GOTO:
+            inst->target = operands;
+            break;
+        case INST_SAVE:
+        case INST_RESTORE:
+            inst->reg = operands;
+            break;
+    }
+
+    if (inst->op != NULL && inst->op->car != NULL) {
+        // the op is bound already
+        inst->fn = (machine_op)inst->op->car->ptr;
+    }
+}
+
+static void resolve_code(machine* m) {
+    // the values have moved: resolve
+    // all instructions from the code
+    value* code = m->code_head->cdr;
+    while (code != NULL) {
+        resolve_inst(m, code);
+        code = code->cdr;
+    }
+}
+
 static value* append_code(machine* m, const value* source) {
     value* head = m->code_tail;
     value* tail = m->code_tail;
@@ -537,14 +673,21 @@ static value* append_code(machine* m, const value* source) {
                     instruction,
                     local_line),
                 NULL);
+            pool_write_barrier(m->pool, tail);
             tail = tail->cdr;
 
+            // resolve the instruction into
+            // the next one in the array
+            set_position(tail, new_inst(m));
+            resolve_inst(m, tail);
+
             // while any labels are pending
             while (pending_labels != NULL) {
                 // point the first pending label in the
                 // chain to the current instruction
                 value* label = pending_labels->car;
                 label->car = tail;
+                pool_write_barrier(m->pool, label);
 
                 // move to the next pending label
                 pending_labels = pending_labels->cdr;
@@ -565,186 +708,292 @@ static value* append_code(machine* m, const value* source) {
     return head->cdr;
 }
 
-static void execute_assign(machine* m, value* inst) {
-    value* dst_reg = inst->car;  // dst register
-    value* src = inst->cdr;      // src: register, label, or const
+static void park_pointers(machine* m) {
+    value* slot = m->root->cdr;
+    slot->car = m->code_tail;
+    slot->cdr->car = m->val;
+}
+
+static void unpark_pointers(machine* m) {
+    value* slot = m->root->cdr;
+    m->code_tail = slot->car;
+    m->val = slot->cdr->car;
+    slot->car = slot->cdr->car = NULL;
+
+    // the rest along the backbone's links
+    // from the root (pinned: not moved)
+    m->stack = m->root->car;
+    m->code_head = m->stack->car->car;
+    m->ops = m->code_head->car;
+    m->labels = m->ops->car;
+    m->constants = m->labels->car;
+    m->registers = m->constants->car;
+}
+
+static void collect_garbage(machine* m, void (*collect)(pool* p)) {
+    size_t pool_size_before = 0;
+    double start_time = 0;
+    if (m->trace >= TRACE_GENERAL) {
+        pool_size_before = m->pool->size;
+        start_time = get_time();
+    }
+
+    if (m->pool->collector == POOL_COPYING) {
+        // the values move: the machine's
+        // pointers are updated through the pool
+        park_pointers(m);
+        collect(m->pool);
+        unpark_pointers(m);
+        resolve_code(m);
+    } else {
+        collect(m->pool);
+    }
+
+    if (m->trace >= TRACE_GENERAL) {
+        double pause = get_time() - start_time;
+
+        int bucket = 0;
+        double limit = GC_PAUSE_BUCKET_BASE;
+        while (bucket < GC_PAUSE_BUCKETS - 1 && pause >= limit) {
+            limit *= 10;
+            bucket++;
+        }
+
+        m->stats.garbage_collected_times += 1;
+        m->stats.garbage_collected_values += (pool_size_before - m->pool->size);
+        m->stats.garbage_collection_time += pause;
+        m->stats.garbage_pauses[bucket] += 1;
+        if (pause > m->stats.garbage_max_pause) {
+            m->stats.garbage_max_pause = pause;
+        }
+    }
+}
+
+static void collect_if_due(machine* m) {
+    if (m->pool->collection_due) {
+        // interim garbage collection: mostly of the values
+        // allocated since the last (or an incremental step)
+        collect_garbage(m, pool_collect_interim);
+    }
+}
+
+static void jump(machine* m, const size_t position) {
+    if (position <= m->pc && m->stop) {
+        // every loop jumps back: an interrupt is
+        // noticed there, not on each instruction
+        m->val->car = pool_new_error(m->pool, "keyboard interrupt");
+        pool_write_barrier(m->pool, m->val);
+        m->pc = NO_POSITION;
+    } else {
+        m->pc = position;
+    }
+}
+
+static inline void execute_assign(machine* m, const machine_inst* inst, const int traced) {
+    value* dst_reg = inst->reg;  // dst register
+    value* src = inst->src;      // src: register, label, or const
 
     // assign to the dst register from
     // src register, label, or const
     dst_reg->car = src->car;
+    pool_write_barrier(m->pool, dst_reg);
     // advance the pc
-    m->pc = m->pc->cdr;
+    m->pc += 1;
 
-    if (m->trace >= TRACE_SUMMARY) {
+    if (traced && m->trace >= TRACE_SUMMARY) {
         m->stats.num_inst_assign += 1;
 
         if (m->trace >= TRACE_COUNTS) {
-            increment_count(m->stats.cnt_register_assigns, dst_reg->cdr->symbol);
+            increment_count(m->stats.cnt_register_assigns, dst_reg->cdr);
         }
     }
 }
 
-static void execute_call(machine* m, value* inst) {
-    value* dst_reg = inst->car;    // dst register (if any)
-    value* op = inst->cdr->car;    // op record (pointer . name)
-    value* args = inst->cdr->cdr;  // op's args
+static inline void execute_call(machine* m, const machine_inst* inst, const int traced) {
+    // the op may append code, moving the
+    // array: nothing is read from inst after
+    value* dst_reg = inst->reg;  // dst register (if any)
+    value* op = inst->op;        // op record (pointer . name)
 
     // advance the pc before the call
     // to allow the op to modify the pc
-    m->pc = m->pc->cdr;
+    m->pc += 1;
 
     // call the op
-    value* result = call_op(m, op, args);
+    value* result = call_op(m, op, inst->fn, inst->args);
 
     if (result != NULL && result->type == VALUE_ERROR) {
         // set the output register to the error
         // and halt immediately
         m->val->car = result;
-        m->pc = NULL;
+        pool_write_barrier(m->pool, m->val);
+        m->pc = NO_POSITION;
     } else {
         if (dst_reg != NULL) {
             // set the register from the result
             dst_reg->car = result;
+            pool_write_barrier(m->pool, dst_reg);
         }
     }
 
-    if (m->trace >= TRACE_SUMMARY) {
+    if (traced && m->trace >= TRACE_SUMMARY) {
         m->stats.num_inst_call += 1;
 
         if (m->trace >= TRACE_COUNTS) {
-            increment_count(m->stats.cnt_op_calls, op->cdr->symbol);
+            increment_count(m->stats.cnt_op_calls, op->cdr);
 
             if (dst_reg != NULL) {
-                increment_count(m->stats.cnt_register_assigns, dst_reg->cdr->symbol);
+                increment_count(m->stats.cnt_register_assigns, dst_reg->cdr);
             }
         }
     }
+
+    collect_if_due(m);
 }
 
-static void execute_branch(machine* m, value* inst) {
-    value* label = inst->car;
-    value* op = inst->cdr->car;    // op record (pointer . name)
-    value* args = inst->cdr->cdr;  // op's args
+static inline void execute_branch(machine* m, const machine_inst* inst, const int traced) {
+    value* label = inst->target;
+    value* op = inst->op;  // op record (pointer . name)
 
-    value* result = call_op(m, op, args);
+    value* result = call_op(m, op, inst->fn, inst->args);
 
     if (result != NULL && result->type == VALUE_ERROR) {
         // set the output register to the error
         // and halt immediately
         m->val->car = result;
-        m->pc = NULL;
+        pool_write_barrier(m->pool, m->val);
+        m->pc = NO_POSITION;
     } else if (value_is_true(result)) {
         // jump to the label
-        m->pc = label->car;
+        jump(m, get_position(label->car));
     } else {
         // advance the pc
-        m->pc = m->pc->cdr;
+        m->pc += 1;
     }
 
-    if (m->trace >= TRACE_SUMMARY) {
+    if (traced && m->trace >= TRACE_SUMMARY) {
         m->stats.num_inst_branch += 1;
 
         if (m->trace >= TRACE_COUNTS) {
-            increment_count(m->stats.cnt_op_calls, op->cdr->symbol);
+            increment_count(m->stats.cnt_op_calls, op->cdr);
 
-            if (m->pc == NULL) {
+            if (m->pc == NO_POSITION) {
                 m->stats.flag = -1;
             } else if (value_is_true(result)) {
                 m->stats.flag = 1;
-                increment_count(m->stats.cnt_label_jumps, label->cdr->symbol);
+                increment_count(m->stats.cnt_label_jumps, label->cdr);
             } else {
                 m->stats.flag = 0;
             }
         }
     }
+
+    collect_if_due(m);
 }
 
-static void execute_goto(machine* m, value* inst) {
-    value* target = inst;
+static inline void execute_goto(machine* m, const machine_inst* inst, const int traced) {
+    value* target = inst->target;
 
     // jump to the target register or label
-    m->pc = target->car;
+    jump(m, get_position(target->car));
 
-    if (m->trace >= TRACE_SUMMARY) {
+    if (traced && m->trace >= TRACE_SUMMARY) {
         m->stats.num_inst_goto += 1;
 
         if (m->trace >= TRACE_COUNTS) {
             // the count will be incremented if the target is a label
-            increment_count(m->stats.cnt_label_jumps, target->cdr->symbol);
+            increment_count(m->stats.cnt_label_jumps, target->cdr);
         }
     }
 }
 
-static void execute_save(machine* m, value* inst) {
-    value* src_reg = inst;
+static inline void execute_save(machine* m, const machine_inst* inst, const int traced) {
+    value* src_reg = inst->reg;
 
     if (m->stats.stack_depth >= MAX_STACK_VALUES) {
         // return and error and halt the program
         m->val->car = pool_new_error(m->pool, "stack limit exceeded");
-        m->pc = NULL;
+        pool_write_barrier(m->pool, m->val);
+        m->pc = NO_POSITION;
     } else {
-        // push the src register to the stack
+        // push the src register to the stack
         push_to_stack(m, src_reg->car);
         m->stats.stack_depth += 1;
         // advance the pc
-        m->pc = m->pc->cdr;
+        m->pc += 1;
     }
 
-    if (m->trace >= TRACE_SUMMARY) {
+    if (traced && m->trace >= TRACE_SUMMARY) {
         m->stats.num_inst_save += 1;
         if (m->stats.stack_depth > m->stats.stack_depth_max) {
             m->stats.stack_depth_max = m->stats.stack_depth;
         }
 
         if (m->trace >= TRACE_COUNTS) {
-            increment_count(m->stats.cnt_register_saves, src_reg->cdr->symbol);
+            increment_count(m->stats.cnt_register_saves, src_reg->cdr);
         }
     }
+
+    collect_if_due(m);
 }
 
-static void execute_restore(machine* m, value* inst) {
-    value* dst_reg = inst;
+static inline void execute_restore(machine* m, const machine_inst* inst, const int traced) {
+    value* dst_reg = inst->reg;
 
-    // pop the src register from the stack
+    // pop the src register from the stack
     dst_reg->car = pop_from_stack(m);
+    pool_write_barrier(m->pool, dst_reg);
     m->stats.stack_depth -= 1;
     // advance the pc
-    m->pc = m->pc->cdr;
+    m->pc += 1;
 
-    if (m->trace >= TRACE_SUMMARY) {
+    if (traced && m->trace >= TRACE_SUMMARY) {
         m->stats.num_inst_restore += 1;
     }
 }
 
-// array of execution functions for quick dispatch
-static void (*execution_fns[])(machine*, value*) = {
-    execute_assign,
-    execute_call,
-    execute_branch,
-    execute_goto,
-    execute_save,
-    execute_restore,
-};
+static inline void execute_inst(machine* m, const machine_inst* inst, const int traced) {
+    // inlined with a constant traced: the
+    // untraced run loop has no stats code
+    switch (inst->type) {
+        case INST_ASSIGN:
+            execute_assign(m, inst, traced);
+            break;
+        case INST_CALL:
+            execute_call(m, inst, traced);
+            break;
+        case INST_BRANCH:
+            execute_branch(m, inst, traced);
+            break;
+        case INST_GOTO:
+            execute_goto(m, inst, traced);
+            break;
+        case INST_SAVE:
+            execute_save(m, inst, traced);
+            break;
+        case INST_RESTORE:
+            execute_restore(m, inst, traced);
+            break;
+    }
+}
 
-static void trace_before_inst(machine* m, value* line, value* instruction) {
+static void trace_before_inst(machine* m, const machine_inst* inst) {
     static char message[BUFFER_SIZE];
 
     // print the instrumented line
-    value_to_str(line, message);
+    value_to_str(inst->line, message);
     printf("\x1B[34m%05zu\x1B[0m %s", m->stats.num_inst, message);
 }
 
-static void trace_after_inst(machine* m, value* line, value* instruction) {
+static void trace_after_inst(machine* m, const machine_inst* inst) {
     static char message[BUFFER_SIZE];
 
-    switch ((int)instruction->car->number) {
+    switch (inst->type) {
         case INST_ASSIGN:
-            // print the destination register's content
-            value_to_str(instruction->cdr->car->car, message);
         case INST_CALL:
-            if (instruction->cdr->car != NULL) {
+            if (inst->reg != NULL) {
                 // print the destination register's content
-                value_to_str(instruction->cdr->car->car, message);
+                value_to_str(inst->reg->car, message);
             } else {
                 // print nothing
                 message[0] = '\0';
@@ -761,7 +1010,7 @@ static void trace_after_inst(machine* m, value* line, value* instruction) {
         case INST_SAVE:
         case INST_RESTORE:
             // print the associated register's content
-            value_to_str(instruction->cdr->car, message);
+            value_to_str(inst->reg->car, message);
             break;
         default:
             // print nothing
@@ -782,6 +1031,7 @@ static void trace_report(machine* m) {
         static const char* line = "\x1B[34m+---------------------------+-----------------+\x1B[0m\n";
         static const char* header = "\x1B[34m| %-43s |\x1B[0m\n";
         static const char* row = "\x1B[34m|\x1B[0m %-25.25s \x1B[34m|\x1B[0m %'15ld \x1B[34m|\x1B[0m\n";
+        static const char* ratio = "\x1B[34m|\x1B[0m %-25.25s \x1B[34m|\x1B[0m %'15.2f \x1B[34m|\x1B[0m\n";
 
         setlocale(LC_ALL, "en_US.UTF-8");
 
@@ -818,8 +1068,29 @@ static void trace_report(machine* m) {
             printf(row, "times collected", s->garbage_collected_times);
             printf(row, "collected values", s->garbage_collected_values);
             printf(row, "collection time, ms", (long)(s->garbage_collection_time * 1000));
+            printf(row, "max pause, us", (long)(s->garbage_max_pause * 1000000));
             printf(row, "before", s->garbage_before);
             printf(row, "after", s->garbage_after);
+            if (s->garbage_parallel_time > 0) {
+                // the threads' work over the wall time
+                printf(row, "parallel time, ms", (long)(s->garbage_parallel_time * 1000));
+                printf(ratio, "parallel speedup", s->garbage_parallel_work / s->garbage_parallel_time);
+            }
+            printf("%s", line);
+
+            printf(header, "PAUSES");
+            printf("%s", line);
+            char label[32];
+            double limit = GC_PAUSE_BUCKET_BASE * 1000000;
+            for (int i = 0; i < GC_PAUSE_BUCKETS; i++) {
+                if (i < GC_PAUSE_BUCKETS - 1) {
+                    sprintf(label, "< %g us", limit);
+                } else {
+                    sprintf(label, ">= %g us", limit / 10);
+                }
+                printf(row, label, s->garbage_pauses[i]);
+                limit *= 10;
+            }
             printf("%s", line);
         }
 
@@ -847,49 +1118,26 @@ static void trace_report(machine* m) {
     }
 }
 
-static void execute_next_instruction(machine* m) {
-    value* instruction = m->pc->car->car;  // current instruction
-    value* line = NULL;
-
-    if (m->stop) {
-        m->val->car = pool_new_error(m->pool, "keyboard interrupt");
-        m->pc = NULL;
-        return;
+static void run_untraced(machine* m) {
+    while (m->pc < m->num_insts) {
+        execute_inst(m, &m->insts[m->pc], 0);
     }
+}
 
-    if (m->trace >= TRACE_GENERAL) {
+static void run_traced(machine* m) {
+    while (m->pc < m->num_insts) {
+        size_t position = m->pc;  // current instruction
         m->stats.num_inst += 1;
 
         if (m->trace >= TRACE_INSTRUCTIONS) {
-            line = m->pc->car->cdr;
-            trace_before_inst(m, line, instruction);
-        }
-    }
-
-    instruction_type type = (int)instruction->car->number;
-    execution_fns[type](m, instruction->cdr);
-
-    if (m->trace >= TRACE_INSTRUCTIONS) {
-        trace_after_inst(m, line, instruction);
-    }
-
-    if (m->pool->size >= MAX_GARBAGE_VALUES) {
-        size_t pool_size_before = 0;
-        double start_time = 0;
-        if (m->trace >= TRACE_GENERAL) {
-            pool_size_before = m->pool->size;
-            start_time = get_time();
+            trace_before_inst(m, &m->insts[position]);
         }
 
-        // interim garbage collection:
-        // can be inefficient if many
-        // of the values are in use
-        pool_collect_garbage(m->pool);
+        execute_inst(m, &m->insts[position], 1);
 
-        if (m->trace >= TRACE_GENERAL) {
-            m->stats.garbage_collected_times += 1;
-            m->stats.garbage_collected_values += (pool_size_before - m->pool->size);
-            m->stats.garbage_collection_time += (get_time() - start_time);
+        if (m->trace >= TRACE_INSTRUCTIONS) {
+            // the array may have moved
+            trace_after_inst(m, &m->insts[position]);
         }
     }
 }
@@ -897,7 +1145,13 @@ static void execute_next_instruction(machine* m) {
 machine* machine_new(value* code, const char* output_register_name) {
     machine* m = malloc(sizeof(machine));
 
-    m->pool = pool_new();
+    m->pool = pool_new(GC_COPYING ? POOL_COPYING : POOL_MARK_SWEEP);
+    m->insts = NULL;
+    m->num_insts = 0;
+    m->max_insts = 0;
+    m->pc = NO_POSITION;
+
+    create_indices(m);
     create_backbone(m, output_register_name);
     pool_register_root(m->pool, m->root);
 
@@ -913,15 +1167,25 @@ machine* machine_new(value* code, const char* output_register_name) {
 
 void machine_dispose(machine* m) {
     cleanup_stats(m);
+    cleanup_indices(m);
     pool_unregister_root(m->pool, m->root);
     pool_dispose(m->pool);
 
+    free(m->insts);
     free(m);
 }
 
 void machine_bind_op(machine* m, const char* name, machine_op fn) {
     value* op = get_op(m, name);
     op->car = pool_new_primitive(m->pool, fn, name);
+    pool_write_barrier(m->pool, op);
+
+    // bind the op in the code processed so far
+    for (size_t i = 0; i < m->num_insts; i++) {
+        if (m->insts[i].op == op) {
+            m->insts[i].fn = fn;
+        }
+    }
 
     // add newly bound op to the op calls count env
     // if it wasn't in the code  processed so far
@@ -931,6 +1195,13 @@ void machine_bind_op(machine* m, const char* name, machine_op fn) {
 void machine_copy_to_register(machine* m, const char* name, value* v) {
     value* dst_reg = get_register(m, name);
     dst_reg->car = pool_import(m->pool, v);
+    pool_write_barrier(m->pool, dst_reg);
+}
+
+void machine_set_register(machine* m, const char* name, value* v) {
+    value* dst_reg = get_register(m, name);
+    dst_reg->car = v;
+    pool_write_barrier(m->pool, dst_reg);
 }
 
 value* machine_append_code(machine* m, const value* code) {
@@ -938,7 +1209,7 @@ value* machine_append_code(machine* m, const value* code) {
 }
 
 void machine_set_code_position(machine* m, value* pos) {
-    m->pc = pos;
+    m->pc = get_position(pos);
 }
 
 value* machine_copy_from_register(machine* m, const char* name) {
@@ -959,6 +1230,24 @@ value* machine_export_output(machine* m) {
     return pool_export(m->pool, m->val->car);
 }
 
+value* machine_pin_output(machine* m) {
+    return machine_pin(m, m->val->car);
+}
+
+value* machine_pin(machine* m, value* v) {
+    if (v != NULL) {
+        pool_register_root(m->pool, v);
+    }
+
+    return v;
+}
+
+void machine_release(machine* m, value* v) {
+    if (v != NULL) {
+        pool_unregister_root(m->pool, v);
+    }
+}
+
 void machine_run(machine* m) {
     clear_stack(m);
     reset_stats(m);
@@ -966,26 +1255,49 @@ void machine_run(machine* m) {
     if (m->trace >= TRACE_GENERAL) {
         m->stats.start_time = get_time();
         m->stats.garbage_before = m->pool->size;
+        m->stats.garbage_parallel_time = m->pool->parallel_time;
+        m->stats.garbage_parallel_work = m->pool->parallel_work;
     }
 
     m->stop = 0;
-    m->pc = m->code_head->cdr;
-    while (m->pc != NULL) {
-        execute_next_instruction(m);
+    m->pc = get_position(m->code_head->cdr);
+    if (m->trace >= TRACE_GENERAL) {
+        run_traced(m);
+    } else {
+        run_untraced(m);
     }
 
     if (m->trace >= TRACE_GENERAL) {
         m->stats.end_time = get_time();
         m->stats.garbage_after = m->pool->size;
+        m->stats.garbage_parallel_time = m->pool->parallel_time - m->stats.garbage_parallel_time;
+        m->stats.garbage_parallel_work = m->pool->parallel_work - m->stats.garbage_parallel_work;
 
         trace_report(m);
     }
 }
 
+void machine_collect_garbage(machine* m) {
+    // full: between the runs
+    collect_garbage(m, pool_collect_garbage);
+}
+
 void machine_set_trace(machine* m, const machine_trace_level level) {
     m->trace = level;
 }
 
+void machine_set_incremental_gc(machine* m, const size_t interval, const size_t quantum, const double budget) {
+    // interval == 0 turns the incremental collection off
+    pool_set_incremental(m->pool, interval, (interval > 0 ? quantum : 0), budget);
+}
+
+void machine_set_gc_threads(machine* m, const size_t num_threads) {
+    // num_threads > 1 parallelizes the full collections
+    // (mark-sweep only: the copying collector ignores it,
+    // so the trace report shows no parallel speedup there)
+    pool_set_threads(m->pool, num_threads);
+}
+
 void machine_interrupt(machine* m) {
     m->stop = 1;
 }
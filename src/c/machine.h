@@ -1,11 +1,13 @@
 #ifndef MACHINE_H_
 #define MACHINE_H_
 
+#include "const.h"
 #include "pool.h"
 #include "value.h"
 
 typedef struct machine machine;
 typedef struct machine_stats machine_stats;
+typedef struct machine_inst machine_inst;
 typedef value* (*machine_op)(machine* m, const value* args);
 
 typedef enum {
@@ -37,6 +39,10 @@ struct machine_stats {
     long garbage_collected_times;
     long garbage_collected_values;
     double garbage_collection_time;
+    double garbage_max_pause;
+    long garbage_pauses[GC_PAUSE_BUCKETS];  // x10 apart from GC_PAUSE_BUCKET_BASE seconds
+    double garbage_parallel_time;
+    double garbage_parallel_work;
 
     int flag;
 
@@ -55,11 +61,23 @@ struct machine {
     value* labels;
     value* ops;
 
+    // the records of the tables
+    // above (envs) by the names
+    value* register_index;
+    value* label_index;
+    value* op_index;
+
     value* code_head;
     value* code_tail;
 
+    // the code's instructions resolved
+    // from the values: the pc indexes them
+    machine_inst* insts;
+    size_t num_insts;
+    size_t max_insts;
+
     value* stack;
-    value* pc;
+    size_t pc;
     value* val;
 
     machine_stats stats;
@@ -78,12 +96,23 @@ value* machine_get_register(machine* m, const char* name);
 value* machine_get_label(machine* m, const char* name);
 value* machine_export_output(machine* m);
 
+// zero-copy: the values are in the machine's pool. a pinned
+// value (and what it references) isn't collected until it
+// is released: pin the values held between the runs
+void machine_set_register(machine* m, const char* name, value* v);
+value* machine_pin_output(machine* m);
+value* machine_pin(machine* m, value* v);
+void machine_release(machine* m, value* v);
+
 void machine_run(machine* m);
+void machine_collect_garbage(machine* m);
 
 value* machine_append_code(machine* m, const value* code);
 void machine_set_code_position(machine* m, value* pos);
 
 void machine_set_trace(machine* m, const machine_trace_level level);
+void machine_set_incremental_gc(machine* m, const size_t interval, const size_t quantum, const double budget);
+void machine_set_gc_threads(machine* m, const size_t num_threads);
 void machine_interrupt(machine* m);
 
 #endif  // MACHINE_H_
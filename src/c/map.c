@@ -1,12 +1,21 @@
 #include "map.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "const.h"
 #include "value.h"
 
-static size_t get_bucket_id(const map* m, const char* key) {
+static size_t get_hash(const map* m, const char* key) {
+    if (m->interned) {
+        // the low bits are the alignment: the
+        // rest is mixed into the low bits used
+        // to index the table (Fibonacci hashing)
+        size_t hash = ((uintptr_t)key >> 4) * 11400714819323198485ull;
+        return hash ^ (hash >> 32);
+    }
+
     // http://www.cse.yorku.ca/~oz/hash.html
 
     int c;
@@ -15,142 +24,167 @@ static size_t get_bucket_id(const map* m, const char* key) {
         hash = ((hash << 5) + hash) + c;
     }
 
-    return hash % m->num_buckets;
+    return hash;
 }
 
-static void initialize_map(map* m, size_t num_buckets) {
-    m->num_buckets = num_buckets;
-    m->buckets = calloc(m->num_buckets, sizeof(map_record*));
+static int is_inline(const map* m) {
+    return m->records == m->inline_records;
 }
 
-static void expand_buckets(map* m) {
-    size_t old_num_buckets = m->num_buckets;
-    map_record** old_buckets = m->buckets;
-
-    size_t new_num_buckets = old_num_buckets * 2 + 1;
-    initialize_map(m, new_num_buckets);
-
-    for (size_t i = 0; i < old_num_buckets; i++) {
-        // iterate over the old buckets
-        map_record** old_bucket = old_buckets + i;
-        while (*old_bucket != NULL) {
-            // pop a record from the old bucket
-            map_record* r = *old_bucket;
-            *old_bucket = r->next;
+static int has_key(const map* m, const map_record* r, const char* key, const size_t hash) {
+    if (m->interned) {
+        return r->key == key;
+    } else {
+        // the hashes first: fewer strcmps
+        return r->hash == hash && strcmp(r->key, key) == 0;
+    }
+}
 
-            // push the record to the new bucket
-            size_t new_id = get_bucket_id(m, r->key);
-            map_record** new_bucket = m->buckets + new_id;
-            r->next = *new_bucket;
-            *new_bucket = r;
+static map_record* find_record(const map* m, const char* key, const size_t hash) {
+    if (is_inline(m)) {
+        for (size_t i = 0; i < m->size; i++) {
+            // scan the few records
+            map_record* r = m->records + i;
+            if (has_key(m, r, key, hash)) {
+                return r;
+            }
+        }
+    } else {
+        size_t mask = m->capacity - 1;
+        size_t i = hash & mask;
+        while (m->records[i].key != NULL) {
+            // probe until an empty slot
+            map_record* r = m->records + i;
+            if (has_key(m, r, key, hash)) {
+                return r;
+            }
+            i = (i + 1) & mask;
         }
     }
 
-    free(old_buckets);
+    return NULL;
 }
 
-static map_record* record_new(const char* key, value* val, map_record* next) {
-    map_record* r = malloc(sizeof(map_record));
-
-    r->key = malloc(strlen(key) + 1);
-    strcpy(r->key, key);
+static map_record* place_record(map* m, char* key, value* val, const size_t hash) {
+    map_record* r = NULL;
+    if (is_inline(m)) {
+        // next to the last one
+        r = m->records + m->size;
+    } else {
+        // in the first empty slot
+        size_t mask = m->capacity - 1;
+        size_t i = hash & mask;
+        while (m->records[i].key != NULL) {
+            i = (i + 1) & mask;
+        }
+        r = m->records + i;
+    }
 
+    r->key = key;
     r->val = val;
-    r->next = next;
+    r->hash = hash;
 
     return r;
 }
 
-static void record_dispose(map_record* r) {
-    free(r->key);
-    free(r);
-}
+static void expand_records(map* m) {
+    map_record* old_records = m->records;
+    size_t old_num_slots = map_num_slots(m);
+    int was_inline = is_inline(m);
+
+    // the table is at most 3/4 full: the
+    // capacity stays a power of two
+    m->capacity = (was_inline ? 4 * MAP_INLINE_RECORDS : 2 * m->capacity);
+    m->records = calloc(m->capacity, sizeof(map_record));
+
+    for (size_t i = 0; i < old_num_slots; i++) {
+        // move the records to the new table
+        map_record* r = old_records + i;
+        if (r->key != NULL) {
+            // the hash is cached
+            place_record(m, r->key, r->val, r->hash);
+        }
+    }
 
-static map_record* record_copy(const map_record* source) {
-    if (source == NULL) {
-        return NULL;
-    } else {
-        return record_new(
-            source->key,
-            source->val,
-            record_copy(source->next));
+    if (!was_inline) {
+        free(old_records);
     }
 }
 
+static void initialize_map(map* m, const int interned) {
+    m->size = 0;
+    m->capacity = 0;
+    m->records = m->inline_records;
+    m->interned = interned;
+}
+
+size_t map_num_slots(const map* m) {
+    // the inline records are packed
+    return (is_inline(m) ? m->size : m->capacity);
+}
+
 map* map_new() {
     map* m = malloc(sizeof(map));
+    initialize_map(m, 0);
+
+    return m;
+}
 
-    initialize_map(m, INITIAL_NUM_BUCKETS);
+map* map_new_interned() {
+    map* m = malloc(sizeof(map));
+    initialize_map(m, 1);
 
     return m;
 }
 
 void map_dispose(map* m) {
-    for (size_t i = 0; i < m->num_buckets; i++) {
-        // iterate over the buckets
-        map_record* r = *(m->buckets + i);
-        while (r != NULL) {
-            // dispose each record in a chain
-            map_record* next = r->next;
-            record_dispose(r);
-            r = next;
+    if (!m->interned) {
+        size_t num_slots = map_num_slots(m);
+        for (size_t i = 0; i < num_slots; i++) {
+            // free the copied keys
+            free(m->records[i].key);
         }
     }
 
-    free(m->buckets);
+    if (!is_inline(m)) {
+        free(m->records);
+    }
     free(m);
 }
 
 int map_has(const map* m, const char* key) {
-    // find the bucket for the key
-    size_t id = get_bucket_id(m, key);
-    map_record** bucket = m->buckets + id;
-
-    map_record* r = *bucket;
-    while (r != NULL) {
-        // search for the key in the bucket
-        if (strcmp(r->key, key) == 0) {
-            return 1;
-        }
-        r = r->next;
-    }
-
-    return 0;
+    return find_record(m, key, get_hash(m, key)) != NULL;
 }
 
 map_record* map_get(const map* m, const char* key) {
-    // find the bucket for the key
-    size_t id = get_bucket_id(m, key);
-    map_record** bucket = m->buckets + id;
-
-    map_record* r = *bucket;
-    while (r != NULL) {
-        // search for the key in the bucket
-        if (strcmp(r->key, key) == 0) {
-            return r;
-        }
-        r = r->next;
-    }
-
-    return NULL;
+    return find_record(m, key, get_hash(m, key));
 }
 
 void map_add(map* m, const char* key, value* val) {
-    // find the bucket for the key
-    size_t id = get_bucket_id(m, key);
-    map_record** bucket = m->buckets + id;
+    size_t hash = get_hash(m, key);
+    map_record* r = find_record(m, key, hash);
+
+    if (r != NULL) {
+        // the key is there already
+        r->val = val;
+        return;
+    }
 
-    if (*bucket != NULL) {
-        // collision -> expand
-        expand_buckets(m);
+    if (is_inline(m) ? m->size == MAP_INLINE_RECORDS : 4 * (m->size + 1) > 3 * m->capacity) {
+        // no room -> expand
+        expand_records(m);
+    }
 
-        // find the new bucket for the key
-        id = get_bucket_id(m, key);
-        bucket = m->buckets + id;
+    char* own_key = NULL;
+    if (m->interned) {
+        own_key = (char*)key;
+    } else {
+        own_key = malloc(strlen(key) + 1);
+        strcpy(own_key, key);
     }
 
-    // add a new record to the chain
-    *bucket = record_new(key, val, *bucket);
+    place_record(m, own_key, val, hash);
+    m->size++;
 }
 
 map* map_copy(const map* source) {
@@ -158,13 +192,27 @@ map* map_copy(const map* source) {
         return NULL;
     } else {
         map* m = malloc(sizeof(map));
+        *m = *source;
+
+        size_t num_slots = map_num_slots(source);
+        if (is_inline(source)) {
+            // copied with the map
+            m->records = m->inline_records;
+        } else {
+            m->records = malloc(m->capacity * sizeof(map_record));
+            memcpy(m->records, source->records, m->capacity * sizeof(map_record));
+        }
 
-        initialize_map(m, source->num_buckets);
-
-        for (size_t i = 0; i < source->num_buckets; i++) {
-            // iterate over the buckets and
-            // copy each bucket's chain recursively
-            *(m->buckets + i) = record_copy(*(source->buckets + i));
+        if (!m->interned) {
+            for (size_t i = 0; i < num_slots; i++) {
+                // copy the keys
+                map_record* r = m->records + i;
+                if (r->key != NULL) {
+                    char* key = malloc(strlen(r->key) + 1);
+                    strcpy(key, r->key);
+                    r->key = key;
+                }
+            }
         }
 
         return m;
@@ -172,14 +220,24 @@ map* map_copy(const map* source) {
 }
 
 void map_dispose_values(map* m) {
-    for (size_t i = 0; i < m->num_buckets; i++) {
-        // iterate over the buckets
-        map_record* r = *(m->buckets + i);
-        while (r != NULL) {
-            // dispose each value in a chain
+    size_t num_slots = map_num_slots(m);
+    for (size_t i = 0; i < num_slots; i++) {
+        // dispose each record's value
+        map_record* r = m->records + i;
+        if (r->key != NULL) {
             value_dispose(r->val);
             r->val = NULL;
-            r = r->next;
+        }
+    }
+}
+
+void map_update_values(map* m, value* (*update)(value* val, void* context), void* context) {
+    size_t num_slots = map_num_slots(m);
+    for (size_t i = 0; i < num_slots; i++) {
+        // replace each record's value
+        map_record* r = m->records + i;
+        if (r->key != NULL) {
+            r->val = update(r->val, context);
         }
     }
 }
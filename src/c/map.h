@@ -1,6 +1,7 @@
 #ifndef MAP_H_
 #define MAP_H_
 
+#include "const.h"
 #include "value.h"
 
 typedef struct map_record map_record;
@@ -9,22 +10,39 @@ typedef struct map map;
 struct map_record {
     char* key;
     value* val;
-    map_record* next;
+    size_t hash;  // of the key (cached)
 };
 
+// open addressing: up to MAP_INLINE_RECORDS records
+// are kept in the map itself (scanned linearly), then
+// in a table of slots (probed linearly). a record may
+// move when another is added: don't keep the pointers
 struct map {
-    size_t num_buckets;
-    map_record** buckets;
+    size_t size;
+    size_t capacity;      // of the table (0 if inline)
+    map_record* records;  // the inline ones or the table
+    int interned;
+    map_record inline_records[MAP_INLINE_RECORDS];
 };
 
 map* map_new();
+
+// the keys are the names of interned symbols
+// (value_new_symbol): hashed and compared by
+// the pointers, not copied
+map* map_new_interned();
 void map_dispose(map* m);
 
 int map_has(const map* m, const char* key);
 map_record* map_get(const map* m, const char* key);
-void map_add(map* m, const char* key, value* val);
+void map_add(map* m, const char* key, value* val);  // replaces the key's value
 map* map_copy(const map* source);
 
+// the records are in the slots [0, num_slots)
+// with a non-NULL key: to iterate over them
+size_t map_num_slots(const map* m);
+
 void map_dispose_values(map* m);
+void map_update_values(map* m, value* (*update)(value* val, void* context), void* context);
 
 #endif  // MAP_H_
@@ -29,15 +29,89 @@ static char QUOTE_CHAR = '\'';
 static char* QUOTE_SYMBOL = "quote";
 static char* DOT_SYMBOL = ".";
 
+// where the parsed values go: on the heap by
+// default, or to the allocator passed to the
+// parse_*_using functions (e.g., a pool's)
+static value_allocator allocator = NULL;
+static void* allocator_context = NULL;
+
 static int parse_token(const char* input, value** v, size_t* line, size_t* col);
 
+static value* new_number(const double number) {
+    if (allocator == NULL) {
+        return value_new_number(number);
+    } else {
+        value* v = allocator(allocator_context);
+        value_init_number(v, number);
+        return v;
+    }
+}
+
+static value* new_symbol(const char* symbol) {
+    // interned: never allocated
+    return value_new_symbol(symbol);
+}
+
+static value* new_string(const char* string) {
+    if (allocator == NULL) {
+        return value_new_string(string);
+    } else {
+        value* v = allocator(allocator_context);
+        value_init_string(v, string);
+        return v;
+    }
+}
+
+static value* new_bool(const int truth) {
+    if (allocator == NULL) {
+        return value_new_bool(truth);
+    } else {
+        value* v = allocator(allocator_context);
+        value_init_bool(v, truth);
+        return v;
+    }
+}
+
+static value* new_error(const char* error, ...) {
+    va_list args;
+    va_start(args, error);
+    value* v;
+    if (allocator == NULL) {
+        v = value_new_error_from_args(error, args);
+    } else {
+        v = allocator(allocator_context);
+        value_init_error_from_args(v, error, args);
+    }
+    va_end(args);
+
+    return v;
+}
+
+static value* new_pair(value* car, value* cdr) {
+    if (allocator == NULL) {
+        return value_new_pair(car, cdr);
+    } else {
+        value* v = allocator(allocator_context);
+        value_init_pair(v, car, cdr);
+        return v;
+    }
+}
+
+static void discard(value* v) {
+    // the allocator's values are
+    // left to it (e.g., collected)
+    if (allocator == NULL) {
+        value_dispose(v);
+    }
+}
+
 static value* make_parsing_error(const size_t* line, const size_t* col, const char* format, ...) {
     va_list args;
     va_start(args, format);
     value* error = value_new_error_from_args(format, args);
     va_end(args);
 
-    value* result = value_new_error("%s at %zu:%zu", error->symbol, *line, *col);
+    value* result = new_error("%s at %zu:%zu", error->symbol, *line, *col);
     value_dispose(error);
 
     return result;
@@ -82,7 +156,7 @@ static value* make_number(const char* symbol, size_t* line, size_t* col) {
     double result = strtod(symbol, NULL);
 
     if (errno == 0) {
-        return value_new_number(result);
+        return new_number(result);
     } else {
         return make_parsing_error(line, col, "malformed number: %s", symbol);
     }
@@ -99,11 +173,11 @@ static value* make_special(const char* symbol) {
     if (strcmp(symbol, "nil") == 0) {
         return NULL;
     } else if (strcmp(symbol, "true") == 0) {
-        return value_new_bool(1);
+        return new_bool(1);
     } else if (strcmp(symbol, "false") == 0) {
-        return value_new_bool(0);
+        return new_bool(0);
     } else {
-        return value_new_error("unknown special symbol: %s", symbol);
+        return new_error("unknown special symbol: %s", symbol);
     }
 }
 static value* make_string(char* content) {
@@ -115,7 +189,7 @@ static value* make_string(char* content) {
     content++;
 
     char* unescaped = str_unescape(content);
-    value* result = value_new_string(unescaped);
+    value* result = new_string(unescaped);
     free(unescaped);
 
     return result;
@@ -142,7 +216,7 @@ static int parse_symbol(const char* input, value** v, size_t* line, size_t* col)
     } else if (is_special(symbol)) {
         *v = make_special(symbol);
     } else {
-        *v = value_new_symbol(symbol);
+        *v = new_symbol(symbol);
     }
 
     free(symbol);
@@ -182,11 +256,11 @@ static int parse_string(const char* input, value** v, size_t* line, size_t* col)
 
 static value** add_child(value** parent, value* child) {
     if (*parent == NULL) {
-        *parent = value_new_pair(child, NULL);
+        *parent = new_pair(child, NULL);
         return parent;
     } else {
         assert((*parent)->cdr == NULL);
-        (*parent)->cdr = value_new_pair(child, NULL);
+        (*parent)->cdr = new_pair(child, NULL);
         return &((*parent)->cdr);
     }
 }
@@ -203,19 +277,19 @@ static value* replace_dot_in_list(value* v) {
             value* error = NULL;
             if (running->cdr == NULL) {
                 value_to_str(v, buffer);
-                error = value_new_error("unfollowed %s in %s", DOT_SYMBOL, buffer);
+                error = new_error("unfollowed %s in %s", DOT_SYMBOL, buffer);
             } else if (running->cdr->cdr != NULL) {
                 value_to_str(v, buffer);
-                error = value_new_error("%s followed by 2+ items in %s", DOT_SYMBOL, buffer);
+                error = new_error("%s followed by 2+ items in %s", DOT_SYMBOL, buffer);
             } else if (running->cdr->car != NULL &&
                        running->cdr->car->type == VALUE_SYMBOL &&
                        strstr(running->cdr->car->symbol, DOT_SYMBOL)) {
                 value_to_str(v, buffer);
-                error = value_new_error("%s followed by %s in %s", DOT_SYMBOL, DOT_SYMBOL, buffer);
+                error = new_error("%s followed by %s in %s", DOT_SYMBOL, DOT_SYMBOL, buffer);
             } else if (prev == NULL) {
                 value* next = running->cdr->car;
                 running->cdr->car = NULL;
-                value_dispose(running);
+                discard(running);
 
                 return next;
             }
@@ -223,7 +297,7 @@ static value* replace_dot_in_list(value* v) {
             if (error == NULL) {
                 value* new_cdr = running->cdr->car;
                 running->cdr->car = NULL;
-                value_dispose(running);
+                discard(running);
                 prev->cdr = new_cdr;
             } else {
                 while (running->cdr != NULL) {
@@ -308,7 +382,7 @@ static int parse_quoted(const char* input, value** v, size_t* line, size_t* col)
 
         value* quoted = NULL;
         running += parse_token(running, &quoted, line, col);
-        value* quote = value_new_symbol(QUOTE_SYMBOL);
+        value* quote = new_symbol(QUOTE_SYMBOL);
 
         value** pair = v;
         pair = add_child(pair, quote);
@@ -367,14 +441,24 @@ value* parse_from_str(const char* input) {
 
     const value* error;
     if ((error = find_error(result)) != NULL) {
-        value* temp = value_new_error(error->symbol);
-        value_dispose(result);
+        value* temp = new_error("%s", error->symbol);
+        discard(result);
         result = temp;
     }
 
     return result;
 }
 
+value* parse_from_str_using(const char* input, value_allocator alloc, void* context) {
+    allocator = alloc;
+    allocator_context = context;
+    value* result = parse_from_str(input);
+    allocator = NULL;
+    allocator_context = NULL;
+
+    return result;
+}
+
 value* parse_from_file(const char* path) {
     FILE* file = fopen(path, "r");
     if (file) {
@@ -390,7 +474,7 @@ value* parse_from_file(const char* path) {
             // parse the full content of the file
             result = parse_from_str(content);
         } else {
-            result = value_new_error("failed to read from file: %s", path);
+            result = new_error("failed to read from file: %s", path);
         }
 
         // cleanup
@@ -399,10 +483,20 @@ value* parse_from_file(const char* path) {
 
         return result;
     } else {
-        return value_new_error("failed to open file: %s", path);
+        return new_error("failed to open file: %s", path);
     }
 }
 
+value* parse_from_file_using(const char* path, value_allocator alloc, void* context) {
+    allocator = alloc;
+    allocator_context = context;
+    value* result = parse_from_file(path);
+    allocator = NULL;
+    allocator_context = NULL;
+
+    return result;
+}
+
 static value* recover_str_rec(value* v) {
     static char buffer[BUFFER_SIZE];
 
@@ -6,6 +6,11 @@
 value* parse_from_str(const char* input);
 value* parse_from_file(const char* path);
 
+// the values are allocated by alloc (e.g., directly
+// in a pool, with no cloning) instead of the heap
+value* parse_from_str_using(const char* input, value_allocator alloc, void* context);
+value* parse_from_file_using(const char* path, value_allocator alloc, void* context);
+
 int recover_str(value* v, char* buffer);
 
 #endif  // PARSE_H_
@@ -1,67 +1,921 @@
+#define _DEFAULT_SOURCE  // for MAP_ANONYMOUS
+
 #include "pool.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 
+#include "const.h"
+#include "map.h"
 #include "value.h"
 
-static void add_to_chain(pool* p, value* v) {
-    v->gen = p->gen;
-    v->next = p->chain->next;
-    p->chain->next = v;
+// as many cells (with their in-use flags) as fit
+// in a slab after the header and the alignment
+#define SLAB_CELLS ((POOL_SLAB_SIZE - 8 * sizeof(size_t)) / (sizeof(value) + 1))
+
+struct pool_slab {
+    pool_slab* next;
+    pool_slab* next_young;
+    size_t used;
+    size_t swept;  // the incremental cycle that swept the slab last
+    int young;
+    int to_space;  // filled by the ongoing copying collection
+    unsigned char in_use[SLAB_CELLS];
+    value cells[SLAB_CELLS];
+};
+
+_Static_assert(sizeof(pool_slab) <= POOL_SLAB_SIZE, "pool_slab must fit in POOL_SLAB_SIZE");
+
+static pool_slab* slab_new() {
+    // map twice the size to cut out a slab aligned by its
+    // size: the slab of a value is found by masking the
+    // value's address. the mapped memory is zeroed
+    char* memory = mmap(
+        NULL, 2 * POOL_SLAB_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(memory != MAP_FAILED);
+
+    size_t offset = (POOL_SLAB_SIZE - (uintptr_t)memory % POOL_SLAB_SIZE) % POOL_SLAB_SIZE;
+    if (offset > 0) {
+        munmap(memory, offset);
+    }
+    munmap(memory + offset + POOL_SLAB_SIZE, POOL_SLAB_SIZE - offset);
+
+    return (pool_slab*)(memory + offset);
+}
+
+static void slab_dispose(pool_slab* s) {
+    // straight back to the OS
+    munmap(s, POOL_SLAB_SIZE);
+}
+
+static pool_slab* slab_of(const value* v) {
+    return (pool_slab*)((uintptr_t)v & ~(uintptr_t)(POOL_SLAB_SIZE - 1));
+}
+
+static void push_free_cells(pool* p, pool_slab* s) {
+    // in the reverse order: to allocate
+    // in the order of the addresses
+    for (size_t i = SLAB_CELLS; i > 0; i--) {
+        if (!s->in_use[i - 1]) {
+            value* v = &s->cells[i - 1];
+            v->car = p->free;
+            p->free = v;
+        }
+    }
+}
+
+static double get_time() {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+static double get_thread_time() {
+    // the CPU time of the calling thread
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+static void push_gray(pool* p, value* v) {
+    if (p->num_gray == p->max_gray) {
+        p->max_gray = (p->max_gray == 0 ? 1024 : 2 * p->max_gray);
+        p->gray = realloc(p->gray, p->max_gray * sizeof(value*));
+    }
+
+    v->flags |= VALUE_MARKED | VALUE_GRAY;
+    p->gray[p->num_gray++] = v;
+}
+
+static value* new_value(pool* p) {
+    if (p->free == NULL) {
+        pool_slab* s = slab_new();
+        s->next = p->slabs;
+        p->slabs = s;
+        p->num_slabs++;
+
+        if (p->phase == POOL_SWEEPING) {
+            // behind the sweep: its values
+            // are young, not kept by it
+            s->swept = p->cycle;
+        }
+
+        push_free_cells(p, s);
+    }
+
+    value* v = p->free;
+    p->free = v->car;
+
+    pool_slab* s = slab_of(v);
+    s->in_use[v - s->cells] = 1;
+    s->used++;
     p->size++;
+    p->young_size++;
+
+    if (!s->young) {
+        // sweep the slab in the next minor collection
+        s->young = 1;
+        s->next_young = p->young_slabs;
+        p->young_slabs = s;
+    }
+
+    v->flags = 0;
+    v->index = 0;
+
+    if (p->phase == POOL_MARKING) {
+        // scanned by a later step,
+        // once it is initialized
+        push_gray(p, v);
+    } else if (p->phase == POOL_SWEEPING && s->swept != p->cycle) {
+        // kept by the sweep
+        v->flags |= VALUE_MARKED;
+    }
+
+    // the collection itself waits for the machine:
+    // the values in the C locals aren't rooted
+    if (p->phase == POOL_IDLE) {
+        if (p->young_size >= p->allowance) {
+            p->collection_due = 1;
+        }
+    } else if (p->step_countdown > 0 && --p->step_countdown == 0) {
+        p->collection_due = 1;
+    }
+
+    return v;
+}
+
+static void free_cell(pool* p, pool_slab* s, const size_t i) {
+    // only cleanup, the memory is the slab's
+    value_cleanup(&s->cells[i]);
+    s->in_use[i] = 0;
+    s->used--;
+    p->size--;
+}
+
+static void sweep_slabs(pool* p) {
+    // the free list is rebuilt
+    // from the remaining slabs
+    p->free = NULL;
+
+    pool_slab** link = &p->slabs;
+    while (*link != NULL) {
+        pool_slab* s = *link;
+        for (size_t i = 0; i < SLAB_CELLS; i++) {
+            value* v = &s->cells[i];
+            if (!s->in_use[i]) {
+                continue;
+            } else if (v->flags & VALUE_MARKED) {
+                // used value: keep (as old)
+                v->flags &= ~VALUE_MARKED;
+                v->flags |= VALUE_OLD;
+            } else {
+                // useless value: sweep
+                free_cell(p, s, i);
+            }
+        }
+
+        if (s->used == 0) {
+            // empty slab: release
+            *link = s->next;
+            slab_dispose(s);
+            p->num_slabs--;
+        } else {
+            s->young = 0;
+            push_free_cells(p, s);
+            link = &s->next;
+        }
+    }
+
+    p->young_slabs = NULL;
+    p->young_size = 0;
+}
+
+static void sweep_young_slabs(pool* p) {
+    // the old values are left as they are; the
+    // empty slabs are released by a full collection
+    pool_slab* s = p->young_slabs;
+    while (s != NULL) {
+        for (size_t i = 0; i < SLAB_CELLS; i++) {
+            value* v = &s->cells[i];
+            if (!s->in_use[i] || (v->flags & VALUE_OLD)) {
+                continue;
+            } else if (v->flags & VALUE_MARKED) {
+                // used value: promote
+                v->flags &= ~VALUE_MARKED;
+                v->flags |= VALUE_OLD;
+            } else {
+                // useless value: sweep
+                free_cell(p, s, i);
+                v->car = p->free;
+                p->free = v;
+            }
+        }
+
+        s->young = 0;
+        s = s->next_young;
+    }
+
+    p->young_slabs = NULL;
+    p->young_size = 0;
+}
+
+static void forget_remembered(pool* p) {
+    for (size_t i = 0; i < p->num_remembered; i++) {
+        p->remembered[i]->flags &= ~VALUE_REMEMBERED;
+    }
+    p->num_remembered = 0;
+}
+
+static void unmark_roots(pool* p) {
+    // the sweep unmarks the values in
+    // the pool, but not the external roots
+    value* pair = p->roots;
+    while (pair != NULL) {
+        pair->car->flags &= ~VALUE_MARKED;
+        pair = pair->cdr;
+    }
 }
 
-static void add_to_chain_rec(pool* p, value* v) {
-    if (v != NULL && v->gen != p->gen) {
-        add_to_chain(p, v);
+static void abandon_cycle(pool* p) {
+    // the marks of an unfinished incremental
+    // cycle are cleared: the values survive
+    if (p->phase != POOL_IDLE) {
+        pool_slab* s = p->slabs;
+        while (s != NULL) {
+            for (size_t i = 0; i < SLAB_CELLS; i++) {
+                if (s->in_use[i]) {
+                    s->cells[i].flags &= ~(VALUE_MARKED | VALUE_GRAY);
+                }
+            }
+            s = s->next;
+        }
+
+        unmark_roots(p);
+        p->num_gray = 0;
+        p->phase = POOL_IDLE;
+    }
+}
 
-        if (is_compound_type(v->type)) {
-            add_to_chain_rec(p, v->car);
-            add_to_chain_rec(p, v->cdr);
+static void scan_gray(pool* p, value* v) {
+    v->flags &= ~VALUE_GRAY;
+    if (is_compound_type(v->type)) {
+        if (v->car != NULL && !(v->car->flags & VALUE_MARKED)) {
+            push_gray(p, v->car);
+        }
+        if (v->cdr != NULL && !(v->cdr->flags & VALUE_MARKED)) {
+            push_gray(p, v->cdr);
+        }
+        if (v->type == VALUE_ENV) {
+            // the values bound in the frame
+            map* m = (map*)v->ptr;
+            size_t num_slots = map_num_slots(m);
+            for (size_t i = 0; i < num_slots; i++) {
+                value* val = m->records[i].val;
+                if (m->records[i].key != NULL && val != NULL && !(val->flags & VALUE_MARKED)) {
+                    push_gray(p, val);
+                }
+            }
         }
     }
 }
 
-static void sweep_chain(pool* p) {
-    value* prev = p->chain;
-    value* curr = p->chain->next;
-    while (curr != NULL) {
-        if (curr->gen == p->gen) {
-            // used value: keep
-            prev = curr;
+static int points_to_young(const value* v) {
+    // neither marked nor old
+    const uint8_t seen = VALUE_MARKED | VALUE_OLD;
+    if (!is_compound_type(v->type)) {
+        return 0;
+    } else if ((v->car != NULL && !(v->car->flags & seen)) ||
+               (v->cdr != NULL && !(v->cdr->flags & seen))) {
+        return 1;
+    } else if (v->type == VALUE_ENV) {
+        // the values bound in the frame
+        map* m = (map*)v->ptr;
+        size_t num_slots = map_num_slots(m);
+        for (size_t i = 0; i < num_slots; i++) {
+            value* val = m->records[i].val;
+            if (m->records[i].key != NULL && val != NULL && !(val->flags & seen)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void finish_marking(pool* p) {
+    // everything reachable is marked now: the remembered
+    // and the young values are either garbage or about to
+    // become old in the sweep (or already are)
+    forget_remembered(p);
+
+    pool_slab* s = p->young_slabs;
+    while (s != NULL) {
+        s->young = 0;
+        s = s->next_young;
+    }
+    p->young_slabs = NULL;
+    p->young_size = 0;
+
+    p->phase = POOL_SWEEPING;
+    p->next_to_sweep = p->slabs;
+}
+
+static void sweep_slab(pool* p, pool_slab* s) {
+    for (size_t i = 0; i < SLAB_CELLS; i++) {
+        value* v = &s->cells[i];
+        if (!s->in_use[i]) {
+            continue;
+        } else if (v->flags & VALUE_MARKED) {
+            // used value: keep (as old)
+            v->flags &= ~VALUE_MARKED;
+            v->flags |= VALUE_OLD;
+
+            if (points_to_young(v)) {
+                // points to a value allocated young
+                // after its slab was swept: remember
+                pool_write_barrier(p, v);
+            }
         } else {
             // useless value: sweep
-            prev->next = curr->next;
-            // only cleanup, not dispose:
-            // to avoid recursive dispose
-            value_cleanup(curr);
-            // free manually
-            free(curr);
-            p->size--;
+            free_cell(p, s, i);
+            v->car = p->free;
+            p->free = v;
+        }
+    }
+
+    s->swept = p->cycle;
+}
+
+static void update_trigger(pool* p) {
+    p->collection_due = 0;
+
+    if (p->phase != POOL_IDLE) {
+        // the next step of the cycle
+        p->step_countdown = p->step_interval;
+        return;
+    }
+
+    // a multiple of the values left by the last
+    // collection, within the bounds: the heap grows
+    // instead of collecting over and over when most
+    // of the values are alive
+    size_t allowance = (size_t)(p->size * (p->growth_factor - 1));
+    if (allowance < p->min_allowance) {
+        allowance = p->min_allowance;
+    } else if (allowance > p->max_allowance) {
+        allowance = p->max_allowance;
+    }
+
+    if (p->soft_limit > 0) {
+        // beyond the limit: as often as the minimum allows
+        size_t limit = p->soft_limit / POOL_SLAB_SIZE * SLAB_CELLS;
+        if (p->size + allowance > limit) {
+            allowance = (limit > p->size + p->min_allowance ? limit - p->size : p->min_allowance);
+        }
+    }
+
+    p->allowance = allowance;
+}
+
+static int over_soft_limit(pool* p) {
+    return p->soft_limit > 0 && p->num_slabs * POOL_SLAB_SIZE > p->soft_limit;
+}
+
+static void finish_sweeping(pool* p) {
+    unmark_roots(p);
+
+    p->phase = POOL_IDLE;
+    p->full_size = p->size;
+}
+
+// copying collection: the values reachable from the roots are
+// copied to fresh slabs and scanned there (Cheney's algorithm),
+// the cdrs copied right after their pairs. the roots are pinned:
+// their slabs are kept with the rest of the cells freed
+
+typedef struct copy_space copy_space;
+
+struct copy_space {
+    pool* pool;
+    pool_slab* first;  // the slabs filled, in order
+    pool_slab* last;
+};
+
+static value* copy_cell(copy_space* c) {
+    pool_slab* s = c->last;
+    if (s == NULL || s->used == SLAB_CELLS) {
+        s = slab_new();
+        s->to_space = 1;
+        if (c->last == NULL) {
+            c->first = s;
+        } else {
+            c->last->next = s;
+        }
+        c->last = s;
+        c->pool->num_slabs++;
+    }
+
+    // in the order of the addresses
+    value* v = &s->cells[s->used];
+    s->in_use[s->used++] = 1;
+    c->pool->size++;
+
+    return v;
+}
+
+static int is_in_place(const value* v) {
+    // outside the pool, pinned, or copied already
+    return (v->flags & (VALUE_EXTERNAL | VALUE_MARKED)) || slab_of(v)->to_space;
+}
+
+static value* forward(copy_space* c, value* v) {
+    if (v == NULL || is_in_place(v)) {
+        return v;
+    } else if (v->flags & VALUE_FORWARDED) {
+        return v->car;
+    }
+
+    value* result = NULL;
+    value* prev = NULL;
+    while (1) {
+        value* copy = copy_cell(c);
+        *copy = *v;
+        copy->flags = 0;
+
+        // the old cell points to the copy
+        v->flags |= VALUE_FORWARDED;
+        v->car = copy;
+
+        if (prev == NULL) {
+            result = copy;
+        } else {
+            prev->cdr = copy;
+        }
+
+        // follow the cdrs: the scan
+        // forwards only the cars then
+        v = copy->cdr;
+        if (!is_compound_type(copy->type) || v == NULL || is_in_place(v)) {
+            break;
+        } else if (v->flags & VALUE_FORWARDED) {
+            copy->cdr = v->car;
+            break;
+        }
+        prev = copy;
+    }
+
+    return result;
+}
+
+static value* forward_record(value* v, void* context) {
+    return forward((copy_space*)context, v);
+}
+
+static void forward_env_records(copy_space* c, value* v) {
+    if (v->type == VALUE_ENV) {
+        // the values bound in the frame
+        // are referenced by its map only
+        map_update_values((map*)v->ptr, forward_record, c);
+    }
+}
+
+static void collect_by_copying(pool* p) {
+    copy_space c = {p, NULL, NULL};
+    pool_slab* from = p->slabs;
+
+    p->slabs = NULL;
+    p->free = NULL;
+    p->size = 0;
+
+    value* pair = p->roots;
+    while (pair != NULL) {
+        pair->car->flags |= VALUE_MARKED;
+        pair = pair->cdr;
+    }
+
+    pair = p->roots;
+    while (pair != NULL) {
+        value* root = pair->car;
+        if (is_compound_type(root->type)) {
+            root->car = forward(&c, root->car);
+            root->cdr = forward(&c, root->cdr);
+            forward_env_records(&c, root);
+        }
+        pair = pair->cdr;
+    }
+
+    // the copies are scanned in the order
+    // they are made: more are made meanwhile
+    for (pool_slab* s = c.first; s != NULL; s = s->next) {
+        for (size_t i = 0; i < s->used; i++) {
+            value* v = &s->cells[i];
+            if (is_compound_type(v->type)) {
+                v->car = forward(&c, v->car);
+                forward_env_records(&c, v);
+            }
+        }
+    }
+
+    // the old slabs: released unless
+    // holding a root (marked above)
+    pool_slab* kept = NULL;
+    while (from != NULL) {
+        pool_slab* s = from;
+        from = s->next;
+
+        s->used = 0;
+        for (size_t i = 0; i < SLAB_CELLS; i++) {
+            value* v = &s->cells[i];
+            if (!s->in_use[i]) {
+                continue;
+            } else if (v->flags & VALUE_MARKED) {
+                s->used++;
+            } else {
+                if (!(v->flags & VALUE_FORWARDED)) {
+                    // useless value: cleanup
+                    value_cleanup(v);
+                }
+                s->in_use[i] = 0;
+            }
+        }
+
+        if (s->used == 0) {
+            slab_dispose(s);
+            p->num_slabs--;
+        } else {
+            s->young = 0;
+            s->next = kept;
+            kept = s;
+            p->size += s->used;
+            push_free_cells(p, s);
+        }
+    }
+
+    // the rest of the last slab
+    // is allocated from first
+    for (pool_slab* s = c.first; s != NULL; s = s->next) {
+        s->to_space = 0;
+    }
+    if (c.last != NULL) {
+        push_free_cells(p, c.last);
+        c.last->next = kept;
+        p->slabs = c.first;
+    } else {
+        p->slabs = kept;
+    }
+
+    p->young_slabs = NULL;
+    p->young_size = 0;
+}
+
+// parallel full collection: the workers mark from their shares of
+// the roots, publishing the surplus of their private stacks in the
+// deques for the idle ones to steal, then each sweeps a partition
+// of the slabs. the marks are set atomically, as two workers may
+// reach the same value at once
+
+#define SHARE_THRESHOLD 64  // private stack size to publish the surplus at
+
+typedef struct pool_worker pool_worker;
+
+struct pool_worker {
+    pool_worker* all;
+    size_t index;
+    size_t num_workers;
+    size_t* num_idle;
+    pthread_barrier_t* barrier;
+
+    value** stack;  // private
+    size_t size;
+    size_t capacity;
+
+    value** deque;  // shared: guarded by the lock
+    size_t deque_size;
+    size_t deque_capacity;
+    pthread_mutex_t lock;
+
+    pool_slab** slabs;  // the partition to sweep
+    size_t num_slabs;
+    value* free;  // the free cells found
+    value** free_tail;
+    size_t freed;
+
+    double work;  // CPU seconds, except idling
+};
+
+static void push_private(pool_worker* w, value* v) {
+    if (w->size == w->capacity) {
+        w->capacity = (w->capacity == 0 ? 1024 : 2 * w->capacity);
+        w->stack = realloc(w->stack, w->capacity * sizeof(value*));
+    }
+
+    w->stack[w->size++] = v;
+}
+
+static void publish(pool_worker* w) {
+    // the bottom half: the oldest
+    // entries, likely more work
+    size_t half = w->size / 2;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->deque_size + half > w->deque_capacity) {
+        w->deque_capacity = 2 * (w->deque_size + half);
+        w->deque = realloc(w->deque, w->deque_capacity * sizeof(value*));
+    }
+    memcpy(w->deque + w->deque_size, w->stack, half * sizeof(value*));
+    __atomic_store_n(&w->deque_size, w->deque_size + half, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&w->lock);
+
+    memmove(w->stack, w->stack + half, (w->size - half) * sizeof(value*));
+    w->size -= half;
+}
+
+static int steal(pool_worker* w) {
+    // from the own deque first
+    for (size_t i = 0; i < w->num_workers; i++) {
+        pool_worker* victim = &w->all[(w->index + i) % w->num_workers];
+        if (__atomic_load_n(&victim->deque_size, __ATOMIC_ACQUIRE) == 0) {
+            continue;
+        }
+
+        pthread_mutex_lock(&victim->lock);
+        size_t size = victim->deque_size;
+        size_t count = (size + 1) / 2;
+        for (size_t j = 0; j < count; j++) {
+            push_private(w, victim->deque[--size]);
+        }
+        __atomic_store_n(&victim->deque_size, size, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&victim->lock);
+
+        if (count > 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int wait_for_work(pool_worker* w) {
+    // returns 0 when all the workers are idle: no deque can
+    // be filled then, as only a busy worker publishes (and
+    // checks its own deque before it becomes idle)
+    double start_time = get_thread_time();
+
+    __atomic_add_fetch(w->num_idle, 1, __ATOMIC_ACQ_REL);
+    while (1) {
+        if (__atomic_load_n(w->num_idle, __ATOMIC_ACQUIRE) == w->num_workers) {
+            w->work -= get_thread_time() - start_time;
+            return 0;
+        }
+
+        for (size_t i = 0; i < w->num_workers; i++) {
+            if (__atomic_load_n(&w->all[i].deque_size, __ATOMIC_ACQUIRE) > 0) {
+                __atomic_sub_fetch(w->num_idle, 1, __ATOMIC_ACQ_REL);
+                w->work -= get_thread_time() - start_time;
+                return 1;
+            }
+        }
+
+        sched_yield();
+    }
+}
+
+static void mark_in_parallel(pool_worker* w) {
+    while (1) {
+        while (w->size > 0) {
+            value* v = w->stack[--w->size];
+
+            // follow the cdrs: only the worker
+            // setting the mark goes further
+            while (v != NULL &&
+                   !(__atomic_load_n(&v->flags, __ATOMIC_RELAXED) & VALUE_MARKED) &&
+                   !(__atomic_fetch_or(&v->flags, VALUE_MARKED, __ATOMIC_RELAXED) & VALUE_MARKED) &&
+                   is_compound_type(v->type)) {
+                if (v->car != NULL) {
+                    push_private(w, v->car);
+                }
+                if (v->type == VALUE_ENV) {
+                    // the values bound in the frame
+                    map* m = (map*)v->ptr;
+                    size_t num_slots = map_num_slots(m);
+                    for (size_t i = 0; i < num_slots; i++) {
+                        if (m->records[i].key != NULL && m->records[i].val != NULL) {
+                            push_private(w, m->records[i].val);
+                        }
+                    }
+                }
+                v = v->cdr;
+            }
+
+            if (w->size >= SHARE_THRESHOLD &&
+                __atomic_load_n(&w->deque_size, __ATOMIC_RELAXED) == 0) {
+                publish(w);
+            }
+        }
+
+        if (!steal(w) && !wait_for_work(w)) {
+            break;
         }
-        curr = prev->next;
     }
 }
 
-pool* pool_new() {
+static void sweep_in_parallel(pool_worker* w) {
+    // the empty slabs are released and the
+    // free lists joined by the main thread
+    w->free = NULL;
+    w->free_tail = &w->free;
+    w->freed = 0;
+
+    for (size_t k = 0; k < w->num_slabs; k++) {
+        pool_slab* s = w->slabs[k];
+        for (size_t i = 0; i < SLAB_CELLS; i++) {
+            value* v = &s->cells[i];
+            if (!s->in_use[i]) {
+                continue;
+            } else if (v->flags & VALUE_MARKED) {
+                // used value: keep (as old)
+                v->flags &= ~VALUE_MARKED;
+                v->flags |= VALUE_OLD;
+            } else {
+                // useless value: sweep
+                value_cleanup(v);
+                s->in_use[i] = 0;
+                s->used--;
+                w->freed++;
+            }
+        }
+
+        if (s->used > 0) {
+            for (size_t i = 0; i < SLAB_CELLS; i++) {
+                if (!s->in_use[i]) {
+                    *w->free_tail = &s->cells[i];
+                    w->free_tail = &s->cells[i].car;
+                }
+            }
+        }
+
+        s->young = 0;
+    }
+
+    *w->free_tail = NULL;
+}
+
+static void* run_worker(void* arg) {
+    pool_worker* w = arg;
+    double start_time = get_thread_time();
+
+    mark_in_parallel(w);
+    pthread_barrier_wait(w->barrier);
+    sweep_in_parallel(w);
+
+    w->work += get_thread_time() - start_time;
+
+    return NULL;
+}
+
+static void collect_in_parallel(pool* p) {
+    size_t n = p->num_threads;
+    double start_time = get_time();
+
+    size_t num_idle = 0;
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, n);
+
+    pool_slab** slabs = malloc((p->num_slabs + 1) * sizeof(pool_slab*));
+    size_t num_slabs = 0;
+    for (pool_slab* s = p->slabs; s != NULL; s = s->next) {
+        slabs[num_slabs++] = s;
+    }
+
+    pool_worker* workers = calloc(n, sizeof(pool_worker));
+    for (size_t i = 0; i < n; i++) {
+        pool_worker* w = &workers[i];
+        w->all = workers;
+        w->index = i;
+        w->num_workers = n;
+        w->num_idle = &num_idle;
+        w->barrier = &barrier;
+        pthread_mutex_init(&w->lock, NULL);
+
+        w->slabs = slabs + num_slabs * i / n;
+        w->num_slabs = num_slabs * (i + 1) / n - num_slabs * i / n;
+    }
+
+    // the roots are dealt round robin
+    size_t k = 0;
+    for (value* pair = p->roots; pair != NULL; pair = pair->cdr) {
+        push_private(&workers[k++ % n], pair->car);
+    }
+
+    // the main thread is the worker 0
+    pthread_t* threads = malloc(n * sizeof(pthread_t));
+    for (size_t i = 1; i < n; i++) {
+        pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+    run_worker(&workers[0]);
+    for (size_t i = 1; i < n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // the free lists are joined in the
+    // order of the slabs, empty ones aside
+    p->free = NULL;
+    for (size_t i = n; i > 0; i--) {
+        pool_worker* w = &workers[i - 1];
+        if (w->free != NULL) {
+            *w->free_tail = p->free;
+            p->free = w->free;
+        }
+        p->size -= w->freed;
+        p->parallel_work += w->work;
+
+        pthread_mutex_destroy(&w->lock);
+        free(w->stack);
+        free(w->deque);
+    }
+
+    pool_slab** link = &p->slabs;
+    while (*link != NULL) {
+        pool_slab* s = *link;
+        if (s->used == 0) {
+            // empty slab: release
+            *link = s->next;
+            slab_dispose(s);
+            p->num_slabs--;
+        } else {
+            link = &s->next;
+        }
+    }
+
+    p->young_slabs = NULL;
+    p->young_size = 0;
+
+    pthread_barrier_destroy(&barrier);
+    free(threads);
+    free(workers);
+    free(slabs);
+
+    p->parallel_time += get_time() - start_time;
+}
+
+pool* pool_new(const pool_collector collector) {
     pool* p = malloc(sizeof(pool));
 
+    p->collector = collector;
     p->size = 0;
-    p->gen = 1;
     p->roots = NULL;
-    p->chain = value_new_number(0);  // dummy head value
-    p->chain->next = NULL;           // initially empty chain
+    p->slabs = NULL;
+    p->free = NULL;
+    p->num_slabs = 0;
+
+    p->young_slabs = NULL;
+    p->young_size = 0;
+    p->full_size = 0;
+    p->remembered = NULL;
+    p->num_remembered = 0;
+    p->max_remembered = 0;
+
+    p->phase = POOL_IDLE;
+    p->step_quantum = 0;
+    p->step_budget = 0;
+    p->cycle = 0;
+    p->gray = NULL;
+    p->num_gray = 0;
+    p->max_gray = 0;
+    p->next_to_sweep = NULL;
+
+    p->num_threads = 1;
+    p->parallel_time = 0;
+    p->parallel_work = 0;
+
+    p->growth_factor = GC_GROWTH_FACTOR;
+    p->min_allowance = GC_MIN_ALLOWANCE;
+    p->max_allowance = GC_MAX_ALLOWANCE;
+    p->soft_limit = GC_SOFT_LIMIT;
+    p->step_interval = 1;
+    p->step_countdown = 0;
+    update_trigger(p);
 
     return p;
 }
 
 void pool_dispose(pool* p) {
-    // collect the entire chain
-    // because no values are marked
-    p->gen++;
-    sweep_chain(p);
+    abandon_cycle(p);
+
+    // collect all the values (and release
+    // the slabs) because none are marked
+    forget_remembered(p);
+    sweep_slabs(p);
+    free(p->remembered);
+    free(p->gray);
 
     // unlink externally set roots
     // not to dispose them recursively
@@ -72,7 +926,6 @@ void pool_dispose(pool* p) {
     }
 
     value_dispose(p->roots);
-    value_dispose(p->chain);
 
     free(p);
 }
@@ -81,6 +934,11 @@ void pool_register_root(pool* p, value* root) {
     assert(root != NULL);
 
     p->roots = value_new_pair(root, p->roots);
+
+    if (p->phase == POOL_MARKING && !(root->flags & VALUE_MARKED)) {
+        // joins the ongoing marking
+        push_gray(p, root);
+    }
 }
 
 void pool_unregister_root(pool* p, value* root) {
@@ -108,142 +966,304 @@ void pool_unregister_root(pool* p, value* root) {
 }
 
 void pool_collect_garbage(pool* p) {
-    p->gen++;
+    abandon_cycle(p);
+    forget_remembered(p);
+
+    if (p->collector == POOL_COPYING) {
+        collect_by_copying(p);
+    } else if (p->num_threads > 1) {
+        collect_in_parallel(p);
+    } else {
+        value* pair = p->roots;
+        while (pair != NULL) {
+            value_mark(pair->car, 0);
+            pair = pair->cdr;
+        }
+
+        sweep_slabs(p);
+    }
+
+    unmark_roots(p);
+
+    p->full_size = p->size;
+    update_trigger(p);
+}
+
+void pool_collect_interim(pool* p) {
+    if (p->collector == POOL_COPYING) {
+        // nothing is kept in place
+        // but the roots: all copied
+        pool_collect_garbage(p);
+        return;
+    } else if (p->phase != POOL_IDLE) {
+        // an incremental cycle is
+        // going on: move it forward
+        pool_collect_step(p);
+        return;
+    }
+
+    // the old generation has grown by the factor (but at
+    // least by the minimum allowance) since the last full
+    // one, or the slabs have outgrown the soft limit
+    size_t old_size = p->size - p->young_size;
+    size_t growth = (size_t)(p->full_size * (p->growth_factor - 1));
+    if (growth < p->min_allowance) {
+        growth = p->min_allowance;
+    }
+    if (old_size >= p->full_size + growth || over_soft_limit(p)) {
+        if (p->step_quantum > 0) {
+            // begin an incremental cycle
+            pool_collect_step(p);
+        } else {
+            pool_collect_garbage(p);
+        }
+        return;
+    }
 
     value* pair = p->roots;
     while (pair != NULL) {
-        value* root = pair->car;
-        value_update_gen(root, p->gen);
+        value_mark(pair->car, 1);
         pair = pair->cdr;
     }
 
-    sweep_chain(p);
+    // the young values referenced
+    // only by the old ones
+    for (size_t i = 0; i < p->num_remembered; i++) {
+        value* v = p->remembered[i];
+        value_mark(v->car, 1);
+        value_mark(v->cdr, 1);
+        if (v->type == VALUE_ENV) {
+            // the values bound in the frame
+            map* m = (map*)v->ptr;
+            size_t num_slots = map_num_slots(m);
+            for (size_t j = 0; j < num_slots; j++) {
+                if (m->records[j].key != NULL) {
+                    value_mark(m->records[j].val, 1);
+                }
+            }
+        }
+    }
+
+    forget_remembered(p);
+    sweep_young_slabs(p);
+    unmark_roots(p);
+
+    update_trigger(p);
 }
 
-value* pool_new_number(pool* p, const double number) {
-    value* v = value_new_number(number);
+static void run_step(pool* p) {
+    if (p->phase == POOL_IDLE) {
+        // gray the roots
+        p->phase = POOL_MARKING;
+        p->cycle++;
+
+        value* pair = p->roots;
+        while (pair != NULL) {
+            if (!(pair->car->flags & VALUE_MARKED)) {
+                push_gray(p, pair->car);
+            }
+            pair = pair->cdr;
+        }
+    }
 
-    add_to_chain(p, v);
+    // the work is bounded by the quantum and the
+    // budget (checked every so often: reading
+    // the clock is not free)
+    size_t quantum = (p->step_quantum > 0 ? p->step_quantum : (size_t)-1);
+    double deadline = (p->step_budget > 0 ? get_time() + p->step_budget : 0);
+    size_t work = 0;
 
-    return v;
+    while (p->phase == POOL_MARKING && work < quantum) {
+        if (p->num_gray == 0) {
+            finish_marking(p);
+        } else {
+            scan_gray(p, p->gray[--p->num_gray]);
+            work += 1;
+
+            if (deadline > 0 && work % 1024 == 0 && get_time() >= deadline) {
+                return;
+            }
+        }
+    }
+
+    while (p->phase == POOL_SWEEPING && work < quantum) {
+        if (p->next_to_sweep == NULL) {
+            finish_sweeping(p);
+        } else {
+            sweep_slab(p, p->next_to_sweep);
+            p->next_to_sweep = p->next_to_sweep->next;
+            work += SLAB_CELLS;
+
+            if (deadline > 0 && get_time() >= deadline) {
+                return;
+            }
+        }
+    }
 }
 
-value* pool_new_symbol(pool* p, const char* symbol) {
-    value* v = value_new_symbol(symbol);
+void pool_collect_step(pool* p) {
+    if (p->collector == POOL_COPYING) {
+        pool_collect_garbage(p);
+        return;
+    }
 
-    add_to_chain(p, v);
+    run_step(p);
+    update_trigger(p);
+}
+
+void pool_set_incremental(pool* p, const size_t interval, const size_t quantum, const double budget) {
+    abandon_cycle(p);
+
+    p->step_interval = (interval > 0 ? interval : 1);
+    p->step_quantum = quantum;
+    p->step_budget = budget;
+    update_trigger(p);
+}
+
+void pool_set_heap_growth(pool* p, const double factor, const size_t min, const size_t max, const size_t soft_limit) {
+    p->growth_factor = factor;
+    p->min_allowance = min;
+    p->max_allowance = max;
+    p->soft_limit = soft_limit;
+    update_trigger(p);
+}
+
+void pool_set_threads(pool* p, const size_t num_threads) {
+    p->num_threads = (num_threads > 0 ? num_threads : 1);
+}
+
+void pool_write_barrier(pool* p, value* v) {
+    if (p->collector == POOL_COPYING) {
+        // every collection is full
+        return;
+    }
+
+    if ((v->flags & (VALUE_OLD | VALUE_REMEMBERED)) == VALUE_OLD) {
+        if (p->num_remembered == p->max_remembered) {
+            p->max_remembered = (p->max_remembered == 0 ? 64 : 2 * p->max_remembered);
+            p->remembered = realloc(p->remembered, p->max_remembered * sizeof(value*));
+        }
+
+        v->flags |= VALUE_REMEMBERED;
+        p->remembered[p->num_remembered++] = v;
+    }
+
+    if (p->phase == POOL_MARKING && (v->flags & (VALUE_MARKED | VALUE_GRAY)) == VALUE_MARKED) {
+        // a black value changed: scan it again
+        push_gray(p, v);
+    }
+}
+
+value* pool_new_number(pool* p, const double number) {
+    value* v = new_value(p);
+    value_init_number(v, number);
 
     return v;
 }
 
-value* pool_new_string(pool* p, const char* string) {
-    value* v = value_new_string(string);
+value* pool_new_symbol(pool* p, const char* symbol) {
+    // interned: outside the pool
+    return value_new_symbol(symbol);
+}
 
-    add_to_chain(p, v);
+value* pool_new_string(pool* p, const char* string) {
+    value* v = new_value(p);
+    value_init_string(v, string);
 
     return v;
 }
 
 value* pool_new_bool(pool* p, const int truth) {
-    value* v = value_new_bool(truth);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_bool(v, truth);
 
     return v;
 }
 
 value* pool_new_primitive(pool* p, void* ptr, const char* name) {
-    value* v = value_new_primitive(ptr, name);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_primitive(v, ptr, name);
 
     return v;
 }
 
 value* pool_new_error(pool* p, const char* error, ...) {
+    value* v = new_value(p);
+
     va_list args;
     va_start(args, error);
-    value* v = value_new_error_from_args(error, args);
+    value_init_error_from_args(v, error, args);
     va_end(args);
 
-    add_to_chain(p, v);
-
     return v;
 }
 
 value* pool_new_error_from_args(pool* p, const char* error, va_list args) {
-    value* v = value_new_error_from_args(error, args);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_error_from_args(v, error, args);
 
     return v;
 }
 
 value* pool_new_info(pool* p, const char* info, ...) {
+    value* v = new_value(p);
+
     va_list args;
     va_start(args, info);
-    value* v = value_new_info_from_args(info, args);
+    value_init_info_from_args(v, info, args);
     va_end(args);
 
-    add_to_chain(p, v);
-
     return v;
 }
 
 value* pool_new_info_from_args(pool* p, const char* info, va_list args) {
-    value* v = value_new_info_from_args(info, args);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_info_from_args(v, info, args);
 
     return v;
 }
 
 value* pool_new_pair(pool* p, value* car, value* cdr) {
-    value* v = value_new_pair(car, cdr);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_pair(v, car, cdr);
 
     return v;
 }
 
 value* pool_new_lambda(pool* p, value* car, value* cdr) {
-    value* v = value_new_lambda(car, cdr);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_lambda(v, car, cdr);
 
     return v;
 }
 
 value* pool_new_compiled(pool* p, value* car, value* cdr) {
-    value* v = value_new_compiled(car, cdr);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_compiled(v, car, cdr);
 
     return v;
 }
 
 value* pool_new_code(pool* p, value* car, value* cdr) {
-    value* v = value_new_code(car, cdr);
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_code(v, car, cdr);
 
     return v;
 }
 
 value* pool_new_env(pool* p) {
-    value* v = value_new_env();
-
-    add_to_chain(p, v);
+    value* v = new_value(p);
+    value_init_env(v);
 
     return v;
 }
 
-value* pool_import(pool* p, value* source) {
-    value* dest = value_clone(source);
-
-    add_to_chain_rec(p, dest);
+value* pool_allocate(void* context) {
+    return new_value((pool*)context);
+}
 
-    return dest;
+value* pool_import(pool* p, value* source) {
+    return value_clone_using(source, pool_allocate, p);
 }
 
 value* pool_export(pool* p, value* source) {
@@ -5,21 +5,105 @@
 
 #include "value.h"
 
+typedef enum {
+    POOL_MARK_SWEEP = 0,
+    POOL_COPYING = 1
+} pool_collector;
+
+typedef enum {
+    POOL_IDLE = 0,
+    POOL_MARKING = 1,
+    POOL_SWEEPING = 2
+} pool_phase;
+
 typedef struct pool pool;
+typedef struct pool_slab pool_slab;
 
 struct pool {
+    pool_collector collector;
     value* roots;
-    value* chain;
-    size_t size;
-    size_t gen;
+    pool_slab* slabs;  // page-aligned blocks of values
+    value* free;       // free cells linked through car
+    size_t size;       // values in use
+    size_t num_slabs;
+
+    // generations: the values surviving a collection become old.
+    // the old values pointing to the young ones are remembered
+    // by the write barrier: a minor collection marks from the
+    // roots and the remembered values, stopping at the old ones
+    pool_slab* young_slabs;  // slabs allocated from since the last collection
+    size_t young_size;       // values allocated since the last collection
+    size_t full_size;        // values left by the last full collection
+    value** remembered;
+    size_t num_remembered;
+    size_t max_remembered;
+
+    // incremental collection: a cycle marks (tri-color) from the
+    // roots and sweeps the slabs in steps of bounded work. the
+    // write barrier grays the black values that change, the
+    // values allocated meanwhile are kept until the next cycle
+    pool_phase phase;
+    size_t step_quantum;      // values scanned (or swept) per step, 0: off
+    double step_budget;       // seconds per step, 0: unlimited
+    size_t cycle;             // incremental cycles begun so far
+    value** gray;             // marked, but the children aren't yet
+    size_t num_gray;
+    size_t max_gray;
+    pool_slab* next_to_sweep;
+
+    // parallel full collection: the work
+    // shared by the threads (if more than 1)
+    size_t num_threads;
+    double parallel_time;  // seconds the parallel collections took
+    double parallel_work;  // CPU seconds the threads worked in them
+
+    // collection trigger: the allocation sets collection_due when
+    // the allowance (of the values allocated since the last
+    // collection) is used up or, during an incremental cycle,
+    // every step_interval values. the machine polls the flag
+    double growth_factor;  // of the values left by the last collection
+    size_t min_allowance;
+    size_t max_allowance;
+    size_t soft_limit;  // bytes in slabs, 0: no limit
+    size_t allowance;
+    size_t step_interval;
+    size_t step_countdown;
+    int collection_due;
 };
 
-pool* pool_new();
+// a copying pool moves the values reachable from the roots
+// to fresh slabs in every collection (all full), the lists
+// laid out in the order of their cdrs. the roots are pinned: they stay
+// in place, so the pointers to the other values must be
+// reachable from the roots to be updated by the collection
+pool* pool_new(const pool_collector collector);
 void pool_dispose(pool* p);
 
 void pool_register_root(pool* p, value* root);
 void pool_unregister_root(pool* p, value* root);
-void pool_collect_garbage(pool* p);
+void pool_collect_garbage(pool* p);  // full: all the values
+void pool_collect_interim(pool* p);  // minor or, if the old generation has grown, full
+void pool_collect_step(pool* p);     // an incremental step (begins a cycle if idle)
+
+// quantum > 0 makes the full collections due in
+// pool_collect_interim incremental: advanced by
+// pool_collect_step until the phase is idle again
+void pool_set_incremental(pool* p, const size_t interval, const size_t quantum, const double budget);
+
+// the allowance is (factor - 1) x the values left by the last
+// collection, within [min, max]. beyond the soft limit (bytes)
+// it shrinks, and pool_collect_interim collects in full
+void pool_set_heap_growth(pool* p, const double factor, const size_t min, const size_t max, const size_t soft_limit);
+
+// num_threads > 1 marks and sweeps in the full
+// collections (pool_collect_garbage) in parallel.
+// the copying collector ignores the thread count
+void pool_set_threads(pool* p, const size_t num_threads);
+
+// call after storing a pointer in the value:
+// not needed if the value is allocated since
+// the last collection (so can't be old)
+void pool_write_barrier(pool* p, value* v);
 
 value* pool_new_number(pool* p, const double number);
 value* pool_new_symbol(pool* p, const char* symbol);
@@ -36,6 +120,10 @@ value* pool_new_compiled(pool* p, value* car, value* cdr);
 value* pool_new_code(pool* p, value* car, value* cdr);
 value* pool_new_env(pool* p);
 
+// a value_allocator (the context is the pool):
+// the caller initializes the value (value_init_*)
+value* pool_allocate(void* context);
+
 value* pool_import(pool* p, value* source);
 value* pool_export(pool* p, value* source);
 
@@ -198,6 +198,7 @@ static value* prim_set_car(machine* m, const value* args) {
     value* second = args->cdr->car;
 
     first->car = second;
+    pool_write_barrier(m->pool, first);
 
     return NULL;
 }
@@ -210,6 +211,7 @@ static value* prim_set_cdr(machine* m, const value* args) {
     value* second = args->cdr->car;
 
     first->cdr = second;
+    pool_write_barrier(m->pool, first);
 
     return NULL;
 }
@@ -738,6 +740,14 @@ static value* prim_collect(machine* m, const value* args) {
 
     size_t values_before = m->pool->size;
 
+    if (m->pool->collector == POOL_COPYING) {
+        // can't move the values from under the
+        // running instruction: collected after it
+        m->pool->collection_due = 1;
+
+        return pool_new_info(m->pool, "collection of %zu values is due", values_before);
+    }
+
     pool_collect_garbage(m->pool);
 
     size_t values_after = m->pool->size;
@@ -790,7 +800,7 @@ static value* prim_pretty(machine* m, const value* args) {
     static char buffer[BUFFER_SIZE];
     value_to_pretty_str(exp, buffer, (int)line_len->number);
 
-    return value_new_symbol(buffer);
+    return pool_new_symbol(m->pool, buffer);
 }
 
 static value* prim_code(machine* m, const value* args) {
@@ -833,7 +843,7 @@ static value* prim_compile(machine* m, const value* args) {
 }
 
 static void add_primitive(char* name, machine_op fn) {
-    map_add(primitive_map, name, value_new_primitive(fn, name));
+    map_add(primitive_map, value_new_symbol(name)->symbol, value_new_primitive(fn, name));
 }
 
 static void add_primitives_to_map() {
@@ -909,7 +919,7 @@ static void add_primitives_to_map() {
 
 void init_primitives() {
     if (primitive_map == NULL) {
-        primitive_map = map_new();
+        primitive_map = map_new_interned();
         add_primitives_to_map();
     }
 }
@@ -921,12 +931,12 @@ void cleanup_primitives() {
     }
 }
 
-int is_primitive(const char* name) {
-    return map_has(primitive_map, name);
+int is_primitive(const value* name) {
+    return map_has(primitive_map, name->symbol);
 }
 
-value* get_primitive(const char* name) {
-    map_record* r = map_get(primitive_map, name);
+value* get_primitive(const value* name) {
+    map_record* r = map_get(primitive_map, name->symbol);
 
     if (r != NULL) {
         return r->val;
@@ -6,7 +6,8 @@
 void init_primitives();
 void cleanup_primitives();
 
-int is_primitive(const char* name);
-value* get_primitive(const char* name);
+// the names are (interned) symbols
+int is_primitive(const value* name);
+value* get_primitive(const value* name);
 
 #endif  // PRIM_H_
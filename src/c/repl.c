@@ -85,7 +85,7 @@ static command_type get_command_type(const char* line) {
 }
 
 static void process_repl_command(eval* e, hist* h, const char* input, char* output) {
-    value* parsed = parse_from_str(input);
+    value* parsed = eval_parse_from_str(e, input);
 
     if (parsed == NULL || parsed->type != VALUE_ERROR) {
         static char tidy[BUFFER_SIZE];
@@ -99,49 +99,52 @@ static void process_repl_command(eval* e, hist* h, const char* input, char* outp
         output[0] = '\0';
         value* token = parsed;
         while (token != NULL) {
-            value* result = eval_evaluate(e, token->car);
+            value* result = eval_evaluate_pinned(e, token->car);
             output += value_to_str(result, output);
-            value_dispose(result);
+            eval_release(e, result);
 
             output[0] = '\n';
             output[1] = '\0';
             output++;
-            token = token->cdr;
+            token = eval_next_pinned(e, token);
         }
     } else {
         hist_add(h, input);
         output += value_to_str(parsed, output);
         output[0] = '\n';
         output[1] = '\0';
+        eval_release(e, parsed);
     }
-
-    value_dispose(parsed);
 }
 
 value* load_from_file(eval* e, const char* path, const int verbose) {
+    // parsed into the machine's pool: the
+    // content is not copied to be evaluated
     static char buffer[BUFFER_SIZE];
-    value* content = parse_from_file(path);
+    value* content = eval_parse_from_file(e, path);
     if (content != NULL && content->type == VALUE_ERROR) {
-        return content;
+        value* error = value_clone(content);
+        eval_release(e, content);
+        return error;
     }
 
     value* running = content;
     while (running != NULL) {
-        value* result = eval_evaluate(e, running->car);
+        value* result = eval_evaluate_pinned(e, running->car);
         if (result != NULL && result->type == VALUE_ERROR) {
-            value_dispose(content);
-            return result;
+            value* error = value_clone(result);
+            eval_release(e, result);
+            eval_release(e, running);
+            return error;
         }
         if (verbose && result != NULL) {
             value_to_str(result, buffer);
             printf("%s\n", buffer);
         }
-        value_dispose(result);
-        running = running->cdr;
+        eval_release(e, result);
+        running = eval_next_pinned(e, running);
     }
 
-    value_dispose(content);
-
     return NULL;
 }
 
@@ -316,6 +319,7 @@ int main(int argc, char** argv) {
     hist_dispose(h);
     eval_dispose(e);
     cleanup_primitives();
+    cleanup_symbols();
 
     printf("\nbye!\n");
 
@@ -1,7 +1,6 @@
 #include "syntax.h"
 
 #include <stdio.h>
-#include <string.h>
 
 #include "const.h"
 #include "pool.h"
@@ -14,14 +13,44 @@
         return pool_new_error(p, text, tag, buffer); \
     }
 
-static int is_tagged_list(const value* v, const char* tag) {
+typedef enum {
+    TAG_QUOTE = 0,
+    TAG_SET = 1,
+    TAG_DEFINE = 2,
+    TAG_IF = 3,
+    TAG_LAMBDA = 4,
+    TAG_LET = 5,
+    TAG_BEGIN = 6,
+    TAG_COND = 7,
+    TAG_AND = 8,
+    TAG_OR = 9,
+    TAG_EVAL = 10,
+    TAG_APPLY = 11,
+    TAG_ELSE = 12,
+    NUM_TAGS = 13
+} syntax_tag;
+
+static const char* tag_names[NUM_TAGS] = {
+    "quote", "set!", "define", "if", "lambda", "let", "begin",
+    "cond", "and", "or", "eval", "apply", "else"};
+
+static value* get_tag_symbol(const syntax_tag tag) {
+    // interned on the first use: then
+    // compared with the exp by pointer
+    static value* symbols[NUM_TAGS];
+    if (symbols[tag] == NULL) {
+        symbols[tag] = value_new_symbol(tag_names[tag]);
+    }
+
+    return symbols[tag];
+}
+
+static int is_tagged_list(const value* v, const syntax_tag tag) {
     // (tag ...)
     return (
         v != NULL &&
         v->type == VALUE_PAIR &&
-        v->car != NULL &&
-        v->car->type == VALUE_SYMBOL &&
-        strcmp(v->car->symbol, tag) == 0);
+        v->car == get_tag_symbol(tag));
 }
 
 static int is_null_terminated_list(const value* v) {
@@ -50,51 +79,51 @@ int is_variable(const value* exp) {
 }
 
 int is_quoted(const value* exp) {
-    return is_tagged_list(exp, "quote");
+    return is_tagged_list(exp, TAG_QUOTE);
 }
 
 int is_assignment(const value* exp) {
-    return is_tagged_list(exp, "set!");
+    return is_tagged_list(exp, TAG_SET);
 }
 
 int is_definition(const value* exp) {
-    return is_tagged_list(exp, "define");
+    return is_tagged_list(exp, TAG_DEFINE);
 }
 
 int is_if(const value* exp) {
-    return is_tagged_list(exp, "if");
+    return is_tagged_list(exp, TAG_IF);
 }
 
 int is_lambda(const value* exp) {
-    return is_tagged_list(exp, "lambda");
+    return is_tagged_list(exp, TAG_LAMBDA);
 }
 
 int is_let(const value* exp) {
-    return is_tagged_list(exp, "let");
+    return is_tagged_list(exp, TAG_LET);
 }
 
 int is_begin(const value* exp) {
-    return is_tagged_list(exp, "begin");
+    return is_tagged_list(exp, TAG_BEGIN);
 }
 
 int is_cond(const value* exp) {
-    return is_tagged_list(exp, "cond");
+    return is_tagged_list(exp, TAG_COND);
 }
 
 int is_and(const value* exp) {
-    return is_tagged_list(exp, "and");
+    return is_tagged_list(exp, TAG_AND);
 }
 
 int is_or(const value* exp) {
-    return is_tagged_list(exp, "or");
+    return is_tagged_list(exp, TAG_OR);
 }
 
 int is_eval(const value* exp) {
-    return is_tagged_list(exp, "eval");
+    return is_tagged_list(exp, TAG_EVAL);
 }
 
 int is_apply(const value* exp) {
-    return is_tagged_list(exp, "apply");
+    return is_tagged_list(exp, TAG_APPLY);
 }
 
 int starts_with_symbol(const value* exp) {
@@ -249,7 +278,7 @@ value* make_if(pool* p, value* predicate, value* consequent, value* alternative)
     // pred, cons, alt -> (if pred cons alt)
     return pool_new_pair(
         p,
-        pool_new_symbol(p, "if"),
+        get_tag_symbol(TAG_IF),
         pool_new_pair(
             p,
             predicate,
@@ -298,14 +327,14 @@ value* check_lambda(pool* p, value* exp) {
             p2 = p1->cdr;
             while (p2 != NULL) {
                 if (p2->type == VALUE_SYMBOL) {
-                    if (strcmp(p1->car->symbol, p2->symbol) == 0) {
+                    if (p1->car == p2) {
                         MAKE_ERROR(
                             p, "%s: duplicate parameter names in %s",
                             tag, exp);
                     }
                     break;
                 }
-                if (strcmp(p1->car->symbol, p2->car->symbol) == 0) {
+                if (p1->car == p2->car) {
                     MAKE_ERROR(
                         p, "%s: duplicate parameter names in %s",
                         tag, exp);
@@ -334,7 +363,7 @@ value* make_lambda(pool* p, value* params, value* body) {
     // (lambda (p1 p2 ...) e1 e2 ...)
     return pool_new_pair(
         p,
-        pool_new_symbol(p, "lambda"),
+        get_tag_symbol(TAG_LAMBDA),
         pool_new_pair(p, params, body));
 }
 
@@ -440,7 +469,7 @@ value* transform_sequence(pool* p, value* seq) {
         // (a1 a2 ...) -> (begin a1 a2 ...)
         return pool_new_pair(
             p,
-            pool_new_symbol(p, "begin"),
+            get_tag_symbol(TAG_BEGIN),
             seq);
     }
 }
@@ -467,8 +496,7 @@ value* check_cond(pool* p, value* exp) {
                 value* predicate = clause->car;
                 value* actions = clause->cdr;
                 if (predicate != NULL &&
-                    predicate->type == VALUE_SYMBOL &&
-                    strcmp(predicate->symbol, "else") == 0 &&
+                    predicate == get_tag_symbol(TAG_ELSE) &&
                     running->cdr != NULL) {
                     MAKE_ERROR(p, "%s: else clause must be the last in %s", tag, exp);
                 } else if (actions == NULL) {
@@ -494,9 +522,7 @@ static value* transform_cond_rec(pool* p, value* clauses) {
         value* predicate = first->car;
         value* actions = first->cdr;
 
-        if (predicate != NULL &&
-            predicate->type == VALUE_SYMBOL &&
-            strcmp(predicate->symbol, "else") == 0) {
+        if (predicate == get_tag_symbol(TAG_ELSE)) {
             // terminal clause: actions
             return transform_sequence(p, actions);
         } else {
@@ -701,6 +727,7 @@ value* adjoin_arg(pool* p, value* arg, value* arg_list) {
             last_arg = last_arg->cdr;
         }
         last_arg->cdr = new_arg;
+        pool_write_barrier(p, last_arg);
     }
 
     return arg_list;
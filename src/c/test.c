@@ -7,6 +7,7 @@
 #include "const.h"
 #include "eval.h"
 #include "machine.h"
+#include "map.h"
 #include "parse.h"
 #include "pool.h"
 #include "prim.h"
@@ -466,6 +467,66 @@ void test_to_str() {
     test_to_str_output("env", value_new_env(), "<env>");
 }
 
+static void test_map() {
+    static char name[32];
+    value* v[100];
+    for (int i = 0; i < 100; i++) {
+        v[i] = value_new_number(i);
+    }
+
+    // inline records
+    report_test("inline records");
+    map* m = map_new_interned();
+    for (int i = 0; i < MAP_INLINE_RECORDS; i++) {
+        sprintf(name, "key%d", i);
+        map_add(m, value_new_symbol(name)->symbol, v[i]);
+    }
+    assert(m->size == MAP_INLINE_RECORDS);
+    assert(m->records == m->inline_records);
+    assert(map_get(m, value_new_symbol("key0")->symbol)->val == v[0]);
+    assert(map_get(m, "key0") == NULL);  // not the interned name
+
+    // table
+    report_test("table");
+    for (int i = MAP_INLINE_RECORDS; i < 100; i++) {
+        sprintf(name, "key%d", i);
+        map_add(m, value_new_symbol(name)->symbol, v[i]);
+    }
+    assert(m->size == 100);
+    assert(m->records != m->inline_records);
+    for (int i = 0; i < 100; i++) {
+        sprintf(name, "key%d", i);
+        assert(map_get(m, value_new_symbol(name)->symbol)->val == v[i]);
+    }
+    assert(!map_has(m, value_new_symbol("key100")->symbol));
+
+    // replaced value
+    report_test("replaced value");
+    map_add(m, value_new_symbol("key50")->symbol, v[0]);
+    assert(m->size == 100);
+    assert(map_get(m, value_new_symbol("key50")->symbol)->val == v[0]);
+    map_dispose(m);
+
+    // copied keys
+    report_test("copied keys");
+    m = map_new();
+    for (int i = 0; i < 20; i++) {
+        sprintf(name, "key%d", i);
+        map_add(m, name, v[i]);
+    }
+    map* copy = map_copy(m);
+    map_dispose(m);
+    for (int i = 0; i < 20; i++) {
+        sprintf(name, "key%d", i);
+        assert(map_get(copy, name)->val == v[i]);
+    }
+    map_dispose(copy);
+
+    for (int i = 0; i < 100; i++) {
+        value_dispose(v[i]);
+    }
+}
+
 static void test_pool() {
     // setup
     value* r1 = value_new_pair(NULL, NULL);
@@ -473,10 +534,15 @@ static void test_pool() {
     value* source = NULL;
     value* dest = NULL;
 
+    // value size
+    report_test("value size");
+    assert(sizeof(value) == 32);
+
     // init
     report_test("init");
-    pool* p = pool_new();
+    pool* p = pool_new(POOL_MARK_SWEEP);
     assert(p->size == 0);
+    assert(p->num_slabs == 0);
 
     // singleton values
     report_test("singleton values");
@@ -485,14 +551,39 @@ static void test_pool() {
     value* str = pool_new_string(p, "world");
     value* err = pool_new_error(p, "error %d %s", 123, "x");
     value* inf = pool_new_error(p, "info %d %s", 456, "y");
-    assert(p->size == 5);
+    assert(p->size == 4);
     assert(num->number == 3.14);
     assert(strcmp(sym->symbol, "hello") == 0);
     assert(strcmp(str->symbol, "world") == 0);
     assert(strcmp(err->symbol, "error 123 x") == 0);
     assert(strcmp(inf->symbol, "info 456 y") == 0);
+    assert(p->num_slabs == 1);
+    assert(num + 1 == str && str + 1 == err);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+    assert(p->num_slabs == 0);
+
+    // many values
+    report_test("many values");
+    value* list = NULL;
+    for (int i = 0; i < 10000; i++) {
+        list = pool_new_pair(p, pool_new_number(p, i), list);
+    }
+    assert(p->size == 20000);
+    assert(p->num_slabs > 1);
+    pool_register_root(p, r1);
+    r1->car = list;
+    for (int i = 0; i < 10000; i++) {
+        pool_new_number(p, i);
+    }
+    pool_collect_garbage(p);
+    assert(p->size == 20000);
+    assert(list->car->number == 9999);
+    r1->car = NULL;
+    pool_unregister_root(p, r1);
     pool_collect_garbage(p);
     assert(p->size == 0);
+    assert(p->num_slabs == 0);
 
     // compound values
     report_test("compound values");
@@ -503,7 +594,7 @@ static void test_pool() {
             pool_new_number(p, 2.71),
             NULL),
         pool_new_symbol(p, "xyz"));
-    assert(p->size == 4);
+    assert(p->size == 3);
     pool_collect_garbage(p);
     assert(p->size == 0);
 
@@ -556,6 +647,181 @@ static void test_pool() {
     pool_collect_garbage(p);
     assert(p->size == 0);
 
+    // generations
+    report_test("generations");
+    pool_register_root(p, r1);
+    r1->car = pool_new_pair(p, NULL, NULL);
+    pool_new_number(p, 1);
+    pool_collect_garbage(p);
+    assert(p->size == 1);
+    assert(r1->car->flags & VALUE_OLD);
+    r1->car->car = pool_new_number(p, 2);
+    pool_write_barrier(p, r1->car);
+    pool_new_number(p, 3);
+    assert(p->young_size == 2);
+    pool_collect_interim(p);
+    assert(p->size == 2);
+    assert(p->young_size == 0);
+    assert(r1->car->car->number == 2);
+    assert(r1->car->car->flags & VALUE_OLD);
+    r1->car->car = NULL;
+    pool_collect_interim(p);
+    assert(p->size == 2);
+    pool_collect_garbage(p);
+    assert(p->size == 1);
+    r1->car = NULL;
+    pool_unregister_root(p, r1);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+
+    // heap growth
+    report_test("heap growth");
+    pool_set_heap_growth(p, 3, 10, 1000, 0);
+    pool_register_root(p, r1);
+    for (int i = 0; i < 100; i++) {
+        r1->car = pool_new_pair(p, NULL, r1->car);
+    }
+    pool_collect_garbage(p);
+    assert(p->allowance == 200);
+    assert(!p->collection_due);
+    for (int i = 0; i < 199; i++) {
+        pool_new_number(p, i);
+    }
+    assert(!p->collection_due);
+    pool_new_number(p, 199);
+    assert(p->collection_due);
+    pool_collect_interim(p);
+    assert(p->size == 100);
+    assert(!p->collection_due);
+    pool_set_heap_growth(p, 100, 10, 1000, 0);
+    assert(p->allowance == 1000);
+    pool_set_heap_growth(p, 3, 10, 1000, 1);
+    assert(p->allowance == 10);
+    r1->car = NULL;
+    pool_unregister_root(p, r1);
+    pool_set_heap_growth(p, GC_GROWTH_FACTOR, GC_MIN_ALLOWANCE, GC_MAX_ALLOWANCE, GC_SOFT_LIMIT);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+
+    // deep structure
+    report_test("deep structure");
+    pool_register_root(p, r1);
+    for (int i = 0; i < 1000000; i++) {
+        r1->car = pool_new_pair(p, r1->car, NULL);
+    }
+    pool_collect_garbage(p);
+    assert(p->size == 1000000);
+    r1->car = NULL;
+    pool_unregister_root(p, r1);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+
+    // incremental
+    report_test("incremental");
+    pool_set_incremental(p, 1, 100, 0);
+    pool_register_root(p, r1);
+    value* last = NULL;
+    for (int i = 0; i < 1000; i++) {
+        r1->car = pool_new_pair(p, NULL, r1->car);
+        if (i == 0) {
+            last = r1->car;
+        }
+        pool_new_number(p, i);
+    }
+    assert(p->size == 2000);
+    pool_collect_step(p);
+    assert(p->phase == POOL_MARKING);
+    assert(r1->car->flags & VALUE_MARKED);
+    assert(!(last->flags & VALUE_MARKED));
+    value* before_last = r1->car;
+    while (before_last->cdr != last) {
+        before_last = before_last->cdr;
+    }
+    before_last->cdr = NULL;
+    pool_write_barrier(p, before_last);
+    r1->car->car = last;
+    pool_write_barrier(p, r1->car);
+    pool_new_number(p, 1000);
+    int steps = 1;
+    while (p->phase != POOL_IDLE) {
+        pool_collect_step(p);
+        steps++;
+    }
+    assert(steps > 10);
+    assert(p->size == 1001);
+    assert(r1->car->car == last);
+    assert(last->flags & VALUE_OLD);
+    do {
+        pool_collect_step(p);
+    } while (p->phase != POOL_IDLE);
+    assert(p->size == 1000);
+    r1->car = NULL;
+    pool_unregister_root(p, r1);
+    pool_set_incremental(p, 1, 0, 0);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+
+    // new slab while sweeping
+    report_test("new slab while sweeping");
+    pool_set_incremental(p, 1, 100, 0);
+    pool_register_root(p, r1);
+    for (int i = 0; i < 1000; i++) {
+        r1->car = pool_new_pair(p, NULL, r1->car);
+    }
+    while (p->phase != POOL_SWEEPING) {
+        pool_collect_step(p);
+    }
+    size_t num_slabs = p->num_slabs;
+    while (p->num_slabs == num_slabs) {
+        r1->car = pool_new_pair(p, NULL, r1->car);
+    }
+    value* fresh = r1->car;
+    while (p->phase != POOL_IDLE) {
+        pool_collect_step(p);
+    }
+    assert(!(fresh->flags & VALUE_MARKED));
+    fresh->car = pool_new_number(p, 42);
+    pool_write_barrier(p, fresh);
+    size_t size = p->size;
+    pool_collect_interim(p);
+    assert(p->size == size);
+    assert(fresh->car->number == 42);
+    assert(fresh->car->flags & VALUE_OLD);
+    r1->car = NULL;
+    pool_unregister_root(p, r1);
+    pool_set_incremental(p, 1, 0, 0);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+
+    // parallel
+    report_test("parallel");
+    pool_set_threads(p, 4);
+    pool_register_root(p, r1);
+    pool_register_root(p, r2);
+    for (int i = 0; i < 100000; i++) {
+        r1->car = pool_new_pair(p, pool_new_number(p, i), r1->car);
+        r2->car = pool_new_pair(p, r2->car, r1->car);
+        pool_new_string(p, "garbage");
+    }
+    assert(p->size == 400000);
+    pool_collect_garbage(p);
+    assert(p->size == 300000);
+    assert(r1->car->car->number == 99999);
+    assert(r2->car->cdr == r1->car);
+    assert(r2->car->flags & VALUE_OLD);
+    assert(!(r2->car->flags & VALUE_MARKED));
+    r1->car = NULL;
+    pool_collect_garbage(p);
+    assert(p->size == 300000);
+    r2->car = NULL;
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+    assert(p->num_slabs == 0);
+    assert(p->parallel_work > 0);
+    pool_unregister_root(p, r1);
+    pool_unregister_root(p, r2);
+    pool_set_threads(p, 1);
+
     // import
     report_test("import");
     source = value_new_pair(
@@ -564,11 +830,11 @@ static void test_pool() {
             value_new_symbol("abc"),
             NULL));
     dest = pool_import(p, source);
-    assert(p->size == 4);
+    assert(p->size == 3);
     assert(source != dest);
     assert(source->car != dest->car);
     assert(source->cdr != dest->cdr);
-    assert(source->cdr->car != dest->cdr->car);
+    assert(source->cdr->car == dest->cdr->car);  // interned
     assert(dest->car->number == 123);
     assert(strcmp(dest->cdr->car->symbol, "abc") == 0);
     pool_collect_garbage(p);
@@ -586,11 +852,11 @@ static void test_pool() {
             NULL));
     source->cdr->cdr = source;
     dest = pool_import(p, source);
-    assert(p->size == 4);
+    assert(p->size == 3);
     assert(source != dest);
     assert(source->car != dest->car);
     assert(source->cdr != dest->cdr);
-    assert(source->cdr->car != dest->cdr->car);
+    assert(source->cdr->car == dest->cdr->car);  // interned
     assert(dest->car->number == 123);
     assert(strcmp(dest->cdr->car->symbol, "abc") == 0);
     pool_collect_garbage(p);
@@ -609,11 +875,11 @@ static void test_pool() {
             pool_new_symbol(p, "abc"),
             NULL));
     dest = pool_export(p, source);
-    assert(p->size == 4);
+    assert(p->size == 3);
     assert(source != dest);
     assert(source->car != dest->car);
     assert(source->cdr != dest->cdr);
-    assert(source->cdr->car != dest->cdr->car);
+    assert(source->cdr->car == dest->cdr->car);  // interned
     assert(source->car->number == 123);
     assert(strcmp(source->cdr->car->symbol, "abc") == 0);
     pool_collect_garbage(p);
@@ -633,11 +899,11 @@ static void test_pool() {
             NULL));
     source->cdr->cdr = source;
     dest = pool_export(p, source);
-    assert(p->size == 4);
+    assert(p->size == 3);
     assert(source != dest);
     assert(source->car != dest->car);
     assert(source->cdr != dest->cdr);
-    assert(source->cdr->car != dest->cdr->car);
+    assert(source->cdr->car == dest->cdr->car);  // interned
     assert(source->car->number == 123);
     assert(strcmp(source->cdr->car->symbol, "abc") == 0);
     pool_collect_garbage(p);
@@ -646,14 +912,72 @@ static void test_pool() {
     assert(strcmp(dest->cdr->car->symbol, "abc") == 0);
     value_dispose(dest);
 
+    // interned symbols
+    report_test("interned symbols");
+    source = parse_from_str("(abc (abc . xyz))");
+    assert(source->car->car == source->car->cdr->car->car);
+    assert(source->car->car == value_new_symbol("abc"));
+    assert(source->car->car == pool_new_symbol(p, "abc"));
+    assert(source->car->cdr->car->cdr != value_new_symbol("abc"));
+    dest = source->car->cdr->car->cdr;
+    value_dispose(source);
+    assert(strcmp(dest->symbol, "xyz") == 0);
+    assert(p->size == 0);
+
+    // parse into the pool
+    report_test("parse into the pool");
+    dest = parse_from_str_using("(a '(1 \"b\") . c)", pool_allocate, p);
+    assert(p->size == 11);
+    source = parse_from_str("(a '(1 \"b\") . c)");
+    assert(value_equal(source, dest));
+    value_dispose(source);
+    dest = parse_from_str_using("(1 2", pool_allocate, p);
+    assert(dest->type == VALUE_ERROR);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+
     // cleanup
     report_test("cleanup");
     pool_new_number(p, 123);
-    pool_new_symbol(p, "hello");
+    pool_new_string(p, "hello");
     pool_new_string(p, "world");
     assert(p->size == 3);
     pool_dispose(p);
 
+    // copying
+    report_test("copying");
+    p = pool_new(POOL_COPYING);
+    list = NULL;
+    for (int i = 0; i < 1000; i++) {
+        pool_new_number(p, -1);  // garbage in between
+        list = pool_new_pair(p, pool_new_number(p, i), list);
+    }
+    r1->car = list;
+    r2->car = pool_new_string(p, "moved");
+    value* pinned = pool_new_pair(p, NULL, list);
+    pool_register_root(p, r1);
+    pool_register_root(p, r2);
+    pool_register_root(p, pinned);
+    pool_collect_garbage(p);
+    assert(p->size == 2002);
+    assert(r1->car != list);
+    assert(pinned->cdr == r1->car);
+    assert(strcmp(r2->car->symbol, "moved") == 0);
+    for (value* running = r1->car; running->cdr != NULL; running = running->cdr) {
+        assert(running->cdr == running + 1);
+        assert(running->car->number == running->cdr->car->number + 1);
+    }
+    pool_unregister_root(p, pinned);
+    pool_collect_garbage(p);
+    assert(p->size == 2001);
+    assert(r1->car->car->number == 999);
+    pool_unregister_root(p, r1);
+    pool_unregister_root(p, r2);
+    pool_collect_garbage(p);
+    assert(p->size == 0);
+    assert(p->num_slabs == 0);
+    pool_dispose(p);
+
     // teardown
     r1->car = NULL;
     r2->car = NULL;
@@ -711,6 +1035,15 @@ static void test_gcd_machine() {
 
     machine* m = machine_new(code, "a");
 
+    // the ops are bound after the code
+    machine_copy_to_register(m, "b", pool_new_number(m->pool, 1));
+    machine_run(m);
+    value* unbound = machine_export_output(m);
+    report_test("unbound op --> %s", unbound->symbol);
+    assert(unbound->type == VALUE_ERROR);
+    assert(strcmp(unbound->symbol, "machine op = is unbound") == 0);
+    value_dispose(unbound);
+
     machine_bind_op(m, "rem", op_rem);
     machine_bind_op(m, "=", op_eq);
 
@@ -814,10 +1147,39 @@ static void test_fib_machine() {
     machine_dispose(m);
 }
 
+static value* op_interrupt(machine* m, const value* args) {
+    machine_interrupt(m);
+    return NULL;
+}
+
+static void test_interrupt_machine() {
+    value* code = parse_from_str(
+        "start"
+        "    (perform (op interrupt))"
+        "    (goto (label start))");
+    assert(code->type != VALUE_ERROR);
+
+    machine* m = machine_new(code, "val");
+
+    machine_bind_op(m, "interrupt", op_interrupt);
+
+    // noticed on the jump back
+    machine_run(m);
+    value* result = machine_export_output(m);
+    report_test("interrupt --> %s", result->symbol);
+    assert(result->type == VALUE_ERROR);
+    assert(strcmp(result->symbol, "keyboard interrupt") == 0);
+    value_dispose(result);
+
+    value_dispose(code);
+    machine_dispose(m);
+}
+
 static void test_machine() {
     test_gcd_machine();
     test_fact_machine();
     test_fib_machine();
+    test_interrupt_machine();
 }
 
 static void test_syntax(eval* e) {
@@ -2005,7 +2367,7 @@ void test_predicates(eval* e) {
     test_eval_bool(e, "(eq? true true)", 0);
     test_eval_bool(e, "(eq? false false)", 0);
     test_eval_bool(e, "(eq? nil nil)", 1);
-    test_eval_bool(e, "(eq? 'a 'a)", 0);
+    test_eval_bool(e, "(eq? 'a 'a)", 1);
     test_eval_bool(e, "(eq? \"a\" \"a\")", 0);
     test_eval_bool(e, "(eq? '(1) '(1))", 0);
     test_eval_bool(e, "(eq? '(1 . 2) '(1 . 2))", 0);
@@ -2076,6 +2438,38 @@ void test_other(eval* e) {
     // info errors
     test_eval_error(e, "(info)", "expects at least 1 arg, but got 0");
     test_eval_error(e, "(info 1)", "must be string, but is number");
+
+    // parallel collection
+    machine_set_gc_threads(e->machine, 4);
+    test_eval_info(e, "(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))", "build is defined");
+    test_eval_info(e, "(define (sum l) (if (null? l) 0 (+ (car l) (sum (cdr l)))))", "sum is defined");
+    test_eval_info(e, "(define kept (build 10000 '()))", "kept is defined");
+    double work_before = e->machine->pool->parallel_work;
+    test_eval_number(e, "(begin (build 10000 '()) (collect) (sum kept))", 50005000);
+    test_eval_number(e, "(begin (set! kept (build 100 kept)) (collect) (sum kept))", 50010050);
+    machine_collect_garbage(e->machine);
+    test_eval_number(e, "(sum kept)", 50010050);
+    if (e->machine->pool->collector == POOL_MARK_SWEEP) {
+        // the copying collector ignores the threads
+        assert(e->machine->pool->parallel_work > work_before);
+    }
+    machine_set_gc_threads(e->machine, GC_THREADS);
+
+    // zero-copy
+    report_test("zero-copy");
+    value* parsed = eval_parse_from_str(e, "(define zc '(1 2)) (set-car! zc 3) zc");
+    value* quoted = parsed->car->cdr->cdr->car->cdr->car;
+    value* result = NULL;
+    for (value* running = parsed; running != NULL; running = eval_next_pinned(e, running)) {
+        eval_release(e, result);
+        result = eval_evaluate_pinned(e, running->car);
+    }
+    assert(result == quoted);
+    machine_collect_garbage(e->machine);
+    static char buffer[BUFFER_SIZE];
+    value_to_str(result, buffer);
+    assert(strcmp(buffer, "(3 2)") == 0);
+    eval_release(e, result);
 }
 
 int main(int argc, char** argv) {
@@ -2084,6 +2478,7 @@ int main(int argc, char** argv) {
 
     RUN_TEST_FN(test_parse);
     RUN_TEST_FN(test_to_str);
+    RUN_TEST_FN(test_map);
 
     RUN_TEST_FN(test_pool);
     RUN_TEST_FN(test_machine);
@@ -2100,6 +2495,7 @@ int main(int argc, char** argv) {
 
     eval_dispose(e);
     cleanup_primitives();
+    cleanup_symbols();
 
     return 0;
 }
@@ -10,72 +10,73 @@
 #include "map.h"
 #include "str.h"
 
-static void value_init_number(value* v, const double number) {
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+void value_init_number(value* v, const double number) {
     assert(v != NULL);
 
     v->type = VALUE_NUMBER;
     v->number = number;
 }
 
-static void value_init_symbol(value* v, const char* symbol) {
-    assert(v != NULL);
+static map* symbols = NULL;  // the interned symbols by name
 
-    v->type = VALUE_SYMBOL;
-    v->symbol = malloc(strlen(symbol) + 1);
-    strcpy(v->symbol, symbol);
+static void init_text(value* v, const char* text) {
+    v->symbol = malloc(strlen(text) + 1);
+    strcpy(v->symbol, text);
 }
 
-static void value_init_string(value* v, const char* string) {
+void value_init_string(value* v, const char* string) {
     assert(v != NULL);
 
     v->type = VALUE_STRING;
-    v->symbol = malloc(strlen(string) + 1);
-    strcpy(v->symbol, string);
+    init_text(v, string);
 }
 
-static void value_init_bool(value* v, const int truth) {
+void value_init_bool(value* v, const int truth) {
     assert(v != NULL);
 
     v->type = VALUE_BOOL;
     v->number = truth;
 }
 
-static void value_init_primitive(value* v, void* ptr, const char* name) {
+void value_init_primitive(value* v, void* ptr, const char* name) {
     assert(v != NULL);
 
     v->type = VALUE_PRIMITIVE;
     v->ptr = ptr;
-    v->symbol = malloc(strlen(name) + 1);
-    strcpy(v->symbol, name);
+    init_text(v, name);
 }
 
-static void value_init_symbol_from_args(value* v, const char* format, va_list args) {
-    assert(v != NULL);
-
+static void init_text_from_args(value* v, const char* format, va_list args) {
     if (args != NULL) {
         static char buffer[BUFFER_SIZE];
         vsnprintf(buffer, sizeof(buffer), format, args);
-        value_init_symbol(v, buffer);
+        init_text(v, buffer);
     } else {
-        value_init_symbol(v, format);
+        init_text(v, format);
     }
 }
 
-static void value_init_error_from_args(value* v, const char* error, va_list args) {
+void value_init_error_from_args(value* v, const char* error, va_list args) {
     assert(v != NULL);
 
-    value_init_symbol_from_args(v, error, args);
     v->type = VALUE_ERROR;
+    init_text_from_args(v, error, args);
 }
 
-static void value_init_info_from_args(value* v, const char* info, va_list args) {
+void value_init_info_from_args(value* v, const char* info, va_list args) {
     assert(v != NULL);
 
-    value_init_symbol_from_args(v, info, args);
     v->type = VALUE_INFO;
+    init_text_from_args(v, info, args);
 }
 
-static void value_init_pair(value* v, value* car, value* cdr) {
+void value_init_pair(value* v, value* car, value* cdr) {
     assert(v != NULL);
 
     v->type = VALUE_PAIR;
@@ -83,7 +84,7 @@ static void value_init_pair(value* v, value* car, value* cdr) {
     v->cdr = cdr;
 }
 
-static void value_init_lambda(value* v, value* car, value* cdr) {
+void value_init_lambda(value* v, value* car, value* cdr) {
     assert(v != NULL);
 
     v->type = VALUE_LAMBDA;
@@ -91,7 +92,7 @@ static void value_init_lambda(value* v, value* car, value* cdr) {
     v->cdr = cdr;
 }
 
-static void value_init_compiled(value* v, value* car, value* cdr) {
+void value_init_compiled(value* v, value* car, value* cdr) {
     assert(v != NULL);
 
     v->type = VALUE_COMPILED;
@@ -99,7 +100,7 @@ static void value_init_compiled(value* v, value* car, value* cdr) {
     v->cdr = cdr;
 }
 
-static void value_init_code(value* v, value* car, value* cdr) {
+void value_init_code(value* v, value* car, value* cdr) {
     assert(v != NULL);
 
     v->type = VALUE_CODE;
@@ -107,11 +108,11 @@ static void value_init_code(value* v, value* car, value* cdr) {
     v->cdr = cdr;
 }
 
-static void value_init_env(value* v) {
+void value_init_env(value* v) {
     assert(v != NULL);
 
     v->type = VALUE_ENV;
-    v->ptr = map_new();
+    v->ptr = map_new_interned();
     v->car = NULL;
     v->cdr = NULL;
 }
@@ -119,8 +120,8 @@ static void value_init_env(value* v) {
 static value* value_new() {
     value* v = malloc(sizeof(value));
 
-    v->gen = 0;
-    v->next = NULL;
+    v->flags = VALUE_EXTERNAL;
+    v->index = 0;
 
     return v;
 }
@@ -133,12 +134,40 @@ value* value_new_number(const double number) {
 }
 
 value* value_new_symbol(const char* symbol) {
+    if (symbols == NULL) {
+        symbols = map_new();
+    }
+
+    map_record* r = map_get(symbols, symbol);
+    if (r != NULL) {
+        return r->val;
+    }
+
     value* v = value_new();
-    value_init_symbol(v, symbol);
+    v->flags |= VALUE_INTERNED;
+    v->type = VALUE_SYMBOL;
+    init_text(v, symbol);
+    map_add(symbols, symbol, v);
 
     return v;
 }
 
+static value* dispose_symbol(value* v, void* context) {
+    free(v->symbol);
+    free(v);
+
+    return NULL;
+}
+
+void cleanup_symbols() {
+    // nothing may refer to them now
+    if (symbols != NULL) {
+        map_update_values(symbols, dispose_symbol, NULL);
+        map_dispose(symbols);
+        symbols = NULL;
+    }
+}
+
 value* value_new_string(const char* string) {
     value* v = value_new();
     value_init_string(v, string);
@@ -271,14 +300,61 @@ char* get_type_name(const value_type t) {
     }
 }
 
-void value_update_gen(value* v, const size_t gen) {
-    while (v != NULL && v->gen != gen) {
-        v->gen = gen;
-        if (is_compound_type(v->type)) {
-            value_update_gen(v->car, gen);
-            v = v->cdr;
-        } else {
+// the cars to mark later: an explicit stack
+// instead of the recursion, so that a deep
+// structure can't overflow the native one
+static value** mark_stack = NULL;
+static size_t mark_capacity = 0;
+
+static size_t push_to_mark(value* v, size_t size) {
+    if (size == mark_capacity) {
+        mark_capacity = (mark_capacity == 0 ? 1024 : 2 * mark_capacity);
+        mark_stack = realloc(mark_stack, mark_capacity * sizeof(value*));
+    }
+    mark_stack[size++] = v;
+    PREFETCH(v);
+
+    return size;
+}
+
+void value_mark(value* v, const int young_only) {
+    size_t size = 0;
+
+    const uint8_t stop = (young_only ? VALUE_MARKED | VALUE_OLD : VALUE_MARKED);
+    while (1) {
+        // follow the cdrs
+        while (v != NULL && !(v->flags & stop)) {
+            v->flags |= VALUE_MARKED;
+            if (is_compound_type(v->type)) {
+                if (v->type == VALUE_ENV) {
+                    // the values bound in the frame
+                    map* m = (map*)v->ptr;
+                    size_t num_slots = map_num_slots(m);
+                    for (size_t i = 0; i < num_slots; i++) {
+                        if (m->records[i].key != NULL && m->records[i].val != NULL) {
+                            size = push_to_mark(m->records[i].val, size);
+                        }
+                    }
+                }
+
+                value* car = v->car;
+                v = v->cdr;
+                PREFETCH(v);
+
+                if (car != NULL) {
+                    // checked when popped: fetching the
+                    // header now would stall the loop
+                    size = push_to_mark(car, size);
+                }
+            } else {
+                break;
+            }
+        }
+
+        if (size == 0) {
             break;
+        } else {
+            v = mark_stack[--size];
         }
     }
 }
@@ -308,17 +384,17 @@ void value_cleanup(value* v) {
 }
 
 static void break_value_cycles(value* v) {
-    while (v != NULL) {
-        v->gen = -2;
+    while (v != NULL && !(v->flags & VALUE_INTERNED)) {
+        v->flags |= VALUE_VISITED;
         if (is_compound_type(v->type)) {
-            if (v->car != NULL && v->car->gen == -2) {
+            if (v->car != NULL && (v->car->flags & VALUE_VISITED)) {
                 // break the cycle
                 v->car = NULL;
             } else {
                 break_value_cycles(v->car);
             }
 
-            if (v->cdr != NULL && v->cdr->gen == -2) {
+            if (v->cdr != NULL && (v->cdr->flags & VALUE_VISITED)) {
                 // break the cycle
                 v->cdr = NULL;
                 break;
@@ -332,7 +408,7 @@ static void break_value_cycles(value* v) {
 }
 
 static void value_dispose_rec(value* v) {
-    if (v != NULL) {
+    if (v != NULL && !(v->flags & VALUE_INTERNED)) {
         value_cleanup(v);
 
         if (is_compound_type(v->type)) {
@@ -345,7 +421,6 @@ static void value_dispose_rec(value* v) {
 }
 
 void value_dispose(value* v) {
-    value_update_gen(v, -1);
     break_value_cycles(v);
     value_dispose_rec(v);
 }
@@ -390,12 +465,12 @@ static int pair_to_str(value* v, char* buffer) {
     running += value_to_str_rec(v->car, running);
     while ((v_running = v_running->cdr) != NULL) {
         if (v_running->type == VALUE_PAIR) {
-            if (v_running->gen == -2) {
+            if (v_running->flags & VALUE_VISITED) {
                 // marked value: cycle
                 running += sprintf(running, " . " CYCLE_MARK);
                 break;
             } else {
-                v_running->gen = -2;  // mark the value
+                v_running->flags |= VALUE_VISITED;  // mark the value
                 running += sprintf(running, " ");
                 running += value_to_str_rec(v_running->car, running);
                 depth += 1;  // increment the depth
@@ -413,7 +488,7 @@ static int pair_to_str(value* v, char* buffer) {
     // as far as the depth incremented above
     v_running = v->cdr;
     for (size_t i = 0; i < depth; i++) {
-        v_running->gen = -1;
+        v_running->flags &= ~VALUE_VISITED;
         v_running = v_running->cdr;
     }
 
@@ -442,7 +517,7 @@ static int compiled_to_str(const value* v, char* buffer) {
 static int value_to_str_rec(value* v, char* buffer) {
     if (v == NULL) {
         return sprintf(buffer, "()");
-    } else if (v->gen == -2) {
+    } else if (v->flags & VALUE_VISITED) {
         // marked value: cycle
         return sprintf(buffer, CYCLE_MARK);
     } else {
@@ -470,9 +545,9 @@ static int value_to_str_rec(value* v, char* buffer) {
                 result = sprintf(buffer, "\x1B[32m%s\x1B[0m", v->symbol);
                 break;
             case VALUE_PAIR:
-                v->gen = -2;  // mark the value
+                v->flags |= VALUE_VISITED;  // mark the value
                 result = pair_to_str(v, buffer);
-                v->gen = -1;  // unmark the value
+                v->flags &= ~VALUE_VISITED;  // unmark the value
                 break;
             case VALUE_LAMBDA:
                 result = lambda_to_str(v, buffer);
@@ -489,11 +564,7 @@ static int value_to_str_rec(value* v, char* buffer) {
 }
 
 int value_to_str(value* v, char* buffer) {
-    value_update_gen(v, -1);  // prepare
-    int result = value_to_str_rec(v, buffer);
-    value_update_gen(v, 0);  // clear
-
-    return result;
+    return value_to_str_rec(v, buffer);
 }
 
 static int value_to_pretty_str_rec(value* v, char* buffer, const size_t line_len, const int indent) {
@@ -564,7 +635,7 @@ static int value_equal_rec(value* v1, value* v2) {
         return 1;
     } else if (v1 == NULL || v2 == NULL) {
         return 0;
-    } else if (v1->gen == -2 || v2->gen == -2) {
+    } else if ((v1->flags & VALUE_VISITED) || (v2->flags & VALUE_VISITED)) {
         return 0;
     } else if (v1->type != v2->type) {
         return 0;
@@ -579,6 +650,9 @@ static int value_equal_rec(value* v1, value* v2) {
                 result = v1->ptr == v2->ptr;
                 break;
             case VALUE_SYMBOL:
+                // interned: equal if the same
+                result = 0;
+                break;
             case VALUE_STRING:
             case VALUE_ERROR:
             case VALUE_INFO:
@@ -586,12 +660,12 @@ static int value_equal_rec(value* v1, value* v2) {
                 break;
             case VALUE_PAIR:
             case VALUE_LAMBDA:
-                v1->gen = -2;
-                v2->gen = -2;
+                v1->flags |= VALUE_VISITED;
+                v2->flags |= VALUE_VISITED;
                 result = (value_equal_rec(v1->car, v2->car) &&
                           value_equal_rec(v1->cdr, v2->cdr));
-                v1->gen = -1;
-                v2->gen = -1;
+                v1->flags &= ~VALUE_VISITED;
+                v2->flags &= ~VALUE_VISITED;
                 break;
             default:
                 result = 0;
@@ -602,13 +676,7 @@ static int value_equal_rec(value* v1, value* v2) {
 }
 
 int value_equal(value* v1, value* v2) {
-    value_update_gen(v1, -1);  // prepare
-    value_update_gen(v2, -1);  // prepare
-    int result = value_equal_rec(v1, v2);
-    value_update_gen(v1, 0);  // clear
-    value_update_gen(v2, 0);  // clear
-
-    return result;
+    return value_equal_rec(v1, v2);
 }
 
 static void value_copy(value* dest, const value* source) {
@@ -619,9 +687,6 @@ static void value_copy(value* dest, const value* source) {
         case VALUE_NUMBER:
             value_init_number(dest, source->number);
             break;
-        case VALUE_SYMBOL:
-            value_init_symbol(dest, source->symbol);
-            break;
         case VALUE_STRING:
             value_init_string(dest, source->symbol);
             break;
@@ -646,6 +711,10 @@ static void value_copy(value* dest, const value* source) {
         case VALUE_COMPILED:
             value_init_compiled(dest, source->car, source->cdr);
             break;
+        case VALUE_SYMBOL:
+            // interned: shared, not copied
+            assert(0);
+            break;
         case VALUE_CODE:
         case VALUE_ENV:
             // can't copy env or code
@@ -654,41 +723,76 @@ static void value_copy(value* dest, const value* source) {
     }
 }
 
-static value* value_clone_rec(value* source) {
+typedef struct {
+    value** clones;  // by the source's index - 1
+    size_t size;
+    size_t capacity;
+} clone_table;
+
+static value* value_clone_rec(value* source, clone_table* t, value_allocator alloc, void* context) {
     if (source == NULL) {
         return NULL;
+    } else if (source->type == VALUE_SYMBOL) {
+        // interned: shared
+        return source;
     } else if (source->type == VALUE_ENV || source->type == VALUE_CODE) {
         // envs and code are not allowed to be cloned
         // (maybe should be allowed in the future)
         return NULL;
-    } else if (source->gen != -1) {
+    } else if (source->index != 0) {
         // "broken heart": already cloned
-        return (value*)source->gen;
+        return t->clones[source->index - 1];
     } else {
         // empty new value
-        value* dest = value_new();
+        value* dest = alloc(context);
 
         // shallow copy from source
         value_copy(dest, source);
 
         // temporarily setup a "broken heart"
         // to avoid cycles in the recursion
-        source->gen = (size_t)dest;
+        if (t->size == t->capacity) {
+            t->capacity = (t->capacity == 0 ? 16 : 2 * t->capacity);
+            t->clones = realloc(t->clones, t->capacity * sizeof(value*));
+        }
+        t->clones[t->size++] = dest;
+        source->index = t->size;
 
-        if (is_compound_type(dest->type)) {
+        if (is_compound_type(source->type)) {
             // deep copy through the recursive calls
-            dest->car = value_clone_rec(dest->car);
-            dest->cdr = value_clone_rec(dest->cdr);
+            dest->car = value_clone_rec(dest->car, t, alloc, context);
+            dest->cdr = value_clone_rec(dest->cdr, t, alloc, context);
         }
 
         return dest;
     }
 }
 
+static void clear_index(value* v) {
+    while (v != NULL && v->index != 0) {
+        v->index = 0;
+        if (is_compound_type(v->type)) {
+            clear_index(v->car);
+            v = v->cdr;
+        } else {
+            break;
+        }
+    }
+}
+
+static value* value_alloc_heap(void* context) {
+    return value_new();
+}
+
 value* value_clone(value* source) {
-    value_update_gen(source, -1);  // prepare
-    value* dest = value_clone_rec(source);
-    value_update_gen(source, 0);  // clear
+    return value_clone_using(source, value_alloc_heap, NULL);
+}
+
+value* value_clone_using(value* source, value_allocator alloc, void* context) {
+    clone_table t = {NULL, 0, 0};
+    value* dest = value_clone_rec(source, &t, alloc, context);
+    clear_index(source);
+    free(t.clones);
 
     return dest;
 }
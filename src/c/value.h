@@ -2,6 +2,7 @@
 #define VALUE_H_
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 typedef enum {
@@ -20,23 +21,39 @@ typedef enum {
 } value_type;
 
 typedef struct value value;
+typedef value* (*value_allocator)(void* context);
 
-struct value {
-    value_type type;
-
-    double number;
-    char* symbol;
-    void* ptr;
+// value flags
+#define VALUE_MARKED 0x01      // reached by a pool's collection
+#define VALUE_VISITED 0x02     // on the path of a traversal
+#define VALUE_OLD 0x04         // survived a pool's collection
+#define VALUE_REMEMBERED 0x08  // in a pool's remembered set
+#define VALUE_GRAY 0x10        // in a pool's gray stack
+#define VALUE_FORWARDED 0x20   // copied by a pool's collection (car: the copy)
+#define VALUE_EXTERNAL 0x40    // allocated outside the pools
+#define VALUE_INTERNED 0x80    // the one symbol of its name: never freed
 
-    value* car;
-    value* cdr;
+struct value {
+    uint8_t type;    // value_type
+    uint8_t flags;   // VALUE_* flags above
+    uint32_t index;  // scratch space of a traversal
 
-    value* next;
-    size_t gen;
+    union {
+        double number;  // number, bool
+        char* symbol;   // symbol, string, error, info, primitive
+        value* car;     // compound
+    };
+    value* cdr;  // compound
+    void* ptr;   // primitive, env, code (position)
 };
 
-value* value_new_number(const double number);
+// the symbols are interned: one immortal value per
+// name, shared by all (also the pools), so they are
+// compared by the pointers (of the values or the names)
 value* value_new_symbol(const char* symbol);
+void cleanup_symbols();
+
+value* value_new_number(const double number);
 value* value_new_string(const char* string);
 value* value_new_bool(const int truth);
 value* value_new_primitive(void* ptr, const char* name);
@@ -50,9 +67,23 @@ value* value_new_compiled(value* car, value* cdr);
 value* value_new_code(value* car, value* cdr);
 value* value_new_env();
 
+// init a value in the memory allocated
+// elsewhere (e.g., in a pool's slab)
+void value_init_number(value* v, const double number);
+void value_init_string(value* v, const char* string);
+void value_init_bool(value* v, const int truth);
+void value_init_primitive(value* v, void* ptr, const char* name);
+void value_init_error_from_args(value* v, const char* error, va_list args);
+void value_init_info_from_args(value* v, const char* info, va_list args);
+void value_init_pair(value* v, value* car, value* cdr);
+void value_init_lambda(value* v, value* car, value* cdr);
+void value_init_compiled(value* v, value* car, value* cdr);
+void value_init_code(value* v, value* car, value* cdr);
+void value_init_env(value* v);
+
 void value_cleanup(value* v);  // without free
 void value_dispose(value* v);  // with free
-void value_update_gen(value* v, const size_t gen);
+void value_mark(value* v, const int young_only);
 
 int is_compound_type(const value_type t);
 char* get_type_name(const value_type t);
@@ -63,5 +94,6 @@ int value_to_pretty_str(value* v, char* buffer, const size_t line_len);
 int value_is_true(const value* v);
 int value_equal(value* v1, value* v2);
 value* value_clone(value* source);
+value* value_clone_using(value* source, value_allocator alloc, void* context);
 
 #endif  // VALUE_H_
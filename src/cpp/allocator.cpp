@@ -0,0 +1,157 @@
+#include "allocator.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+using std::aligned_alloc;
+using std::bad_alloc;
+using std::free;
+using std::memset;
+using std::vector;
+
+thread_local slab_allocator* slab_allocator::_current = nullptr;
+
+slab_allocator::slab_allocator(size_t spare_slabs) : _spare_slabs(spare_slabs) {}
+
+slab_allocator::~slab_allocator() {
+    for (size_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        slab* s = _slabs[c];
+        while (s != nullptr) {
+            slab* next = s->next;
+            if (s->live == 0) {
+                free(s);
+            } else {
+                // the cells in use outlive the allocator:
+                // the slab is freed with the last of them
+                s->owner = nullptr;
+            }
+            s = next;
+        }
+    }
+}
+
+vector<allocation_stats> slab_allocator::stats() const {
+    vector<allocation_stats> result;
+    for (size_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        result.push_back({
+            _cell_size(c),
+            _allocated[c],
+            _freed[c],
+            _allocated[c] - _freed[c],
+            _num_slabs[c],
+        });
+    }
+
+    return result;
+}
+
+void* slab_allocator::_allocate_large(size_t size) {
+    ++_large_allocated;
+
+    return ::operator new(size);
+}
+
+slab_allocator::slab* slab_allocator::_add_slab(size_t size_class) {
+    void* memory = aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+    if (memory == nullptr) {
+        throw bad_alloc();
+    }
+
+    size_t cell_size = _cell_size(size_class);
+    size_t num_cells = (SLAB_SIZE - SLAB_HEADER_SIZE) / cell_size;
+
+    slab* s = static_cast<slab*>(memory);
+    s->owner = this;
+    s->prev = nullptr;
+    s->next = nullptr;
+    s->free = nullptr;
+    s->bump = static_cast<char*>(memory) + SLAB_HEADER_SIZE;
+    s->end = s->bump + num_cells * cell_size;
+    s->size_class = size_class;
+    s->live = 0;
+    memset(s->used, 0, sizeof(s->used));
+
+    _push_front(s);
+    ++_num_slabs[size_class];
+    ++_num_spare[size_class];
+
+    return s;
+}
+
+void slab_allocator::_unlink(slab* s) {
+    if (s->prev != nullptr) {
+        s->prev->next = s->next;
+    } else {
+        _slabs[s->size_class] = s->next;
+    }
+    if (s->next != nullptr) {
+        s->next->prev = s->prev;
+    } else {
+        _tails[s->size_class] = s->prev;
+    }
+    s->prev = nullptr;
+    s->next = nullptr;
+}
+
+void slab_allocator::_push_front(slab* s) {
+    slab*& head = _slabs[s->size_class];
+    s->prev = nullptr;
+    s->next = head;
+    if (head != nullptr) {
+        head->prev = s;
+    } else {
+        _tails[s->size_class] = s;
+    }
+    head = s;
+}
+
+void slab_allocator::_push_back(slab* s) {
+    slab*& tail = _tails[s->size_class];
+    s->prev = tail;
+    s->next = nullptr;
+    if (tail != nullptr) {
+        tail->next = s;
+    } else {
+        _slabs[s->size_class] = s;
+    }
+    tail = s;
+}
+
+void slab_allocator::_release(slab* s) {
+    size_t size_class = s->size_class;
+    if (_num_spare[size_class] < _spare_slabs) {
+        // keep for the next allocations
+        ++_num_spare[size_class];
+    } else {
+        _unlink(s);
+        free(s);
+        --_num_slabs[size_class];
+    }
+}
+
+void slab_allocator::_deallocate(slab* s, void* ptr) {
+    if (_is_full(s)) {
+        // has a free cell now: move to the front
+        _unlink(s);
+        _push_front(s);
+    }
+
+    size_t offset = _offset_of(s, ptr);
+    s->used[offset / 64] &= ~(uint64_t{1} << (offset % 64));
+
+    *static_cast<void**>(ptr) = s->free;
+    s->free = ptr;
+
+    ++_freed[s->size_class];
+    if (--s->live == 0) {
+        _release(s);
+    }
+}
+
+void slab_allocator::_deallocate_orphan(slab* s) {
+    if (--s->live == 0) {
+        free(s);
+    }
+}
@@ -0,0 +1,219 @@
+#ifndef ALLOCATOR_HPP_
+#define ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::size_t;
+using std::vector;
+
+// size-class slab allocator for the small values: each slab is
+// aligned to its size, so the slab header of a cell is found by
+// masking the cell's address. larger objects go to ::operator new.
+// the header tracks the cells in use, so they can be enumerated
+
+#define SLAB_SIZE (64 * 1024)   // bytes, power of two
+#define SLAB_HEADER_SIZE 576    // bytes, the cells start after
+#define SLAB_CELL_ALIGN 16      // bytes
+#define SLAB_MAX_CELL_SIZE 128  // bytes
+#define SLAB_NUM_CLASSES (SLAB_MAX_CELL_SIZE / SLAB_CELL_ALIGN)
+#define SLAB_SPARE_SLABS 1  // empty slabs kept per class
+
+struct allocation_stats {
+    size_t cell_size;  // bytes per cell
+    size_t allocated;  // cells ever allocated
+    size_t freed;      // cells ever freed
+    size_t live;       // cells in use
+    size_t slabs;      // slabs held
+};
+
+class slab_allocator {
+   public:
+    explicit slab_allocator(size_t spare_slabs = SLAB_SPARE_SLABS);
+    ~slab_allocator();
+
+    // can't copy or move: the slabs point back to the owner
+    slab_allocator(const slab_allocator&) = delete;
+    void operator=(slab_allocator const&) = delete;
+    slab_allocator(slab_allocator&&) = delete;
+    slab_allocator& operator=(slab_allocator&&) = delete;
+
+    void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+
+    // per size class, from the smallest
+    vector<allocation_stats> stats() const;
+
+    // objects too large for the slabs
+    size_t large_allocated() const { return _large_allocated; }
+
+    // bytes ever allocated in the slabs
+    size_t allocated_bytes() const { return _allocated_bytes; }
+
+    // call fn(void*) on every cell in use
+    template <typename F>
+    void for_each_cell(F fn) const;
+
+    // the allocator serving the current thread: its own
+    // default one, unless another is installed by a scope
+    static slab_allocator& current();
+
+   private:
+    friend class allocator_scope;
+
+    struct slab {
+        slab_allocator* owner;  // nullptr once the owner is gone
+        slab* prev;             // the owner's list of the class:
+        slab* next;             // slabs with free cells go first
+        void* free;             // freed cells, linked through
+        char* bump;             // the first never used cell
+        char* end;              // past the last cell
+        uint32_t size_class;
+        uint32_t live;  // cells in use
+        uint64_t used[SLAB_SIZE / SLAB_CELL_ALIGN / 64];  // bit per cell offset
+    };
+
+    static_assert(sizeof(slab) <= SLAB_HEADER_SIZE, "slab header is too large");
+
+    static size_t _class_of(size_t size) {
+        return (size + SLAB_CELL_ALIGN - 1) / SLAB_CELL_ALIGN - 1;
+    }
+
+    static size_t _cell_size(size_t size_class) {
+        return (size_class + 1) * SLAB_CELL_ALIGN;
+    }
+
+    static slab* _slab_of(void* ptr) {
+        return reinterpret_cast<slab*>(reinterpret_cast<uintptr_t>(ptr) & ~uintptr_t{SLAB_SIZE - 1});
+    }
+
+    static bool _is_full(const slab* s) {
+        return s->free == nullptr && s->bump == s->end;
+    }
+
+    static size_t _offset_of(const slab* s, const void* ptr) {
+        return (static_cast<const char*>(ptr) - reinterpret_cast<const char*>(s)) / SLAB_CELL_ALIGN;
+    }
+
+    void* _allocate_large(size_t size);
+    slab* _add_slab(size_t size_class);
+    void _unlink(slab* s);
+    void _push_front(slab* s);
+    void _push_back(slab* s);
+    void _release(slab* s);
+    void _deallocate(slab* s, void* ptr);
+    static void _deallocate_orphan(slab* s);
+
+    slab* _slabs[SLAB_NUM_CLASSES]{};
+    slab* _tails[SLAB_NUM_CLASSES]{};
+    size_t _allocated[SLAB_NUM_CLASSES]{};
+    size_t _freed[SLAB_NUM_CLASSES]{};
+    size_t _num_slabs[SLAB_NUM_CLASSES]{};
+    size_t _num_spare[SLAB_NUM_CLASSES]{};
+    size_t _spare_slabs;
+    size_t _large_allocated{0};
+    size_t _allocated_bytes{0};
+
+    static thread_local slab_allocator* _current;
+};
+
+// installs an allocator as the current
+// thread's one for the lifetime of the scope
+
+class allocator_scope {
+   public:
+    allocator_scope(slab_allocator& allocator)
+        : _previous(slab_allocator::_current) {
+        slab_allocator::_current = &allocator;
+    }
+
+    ~allocator_scope() {
+        slab_allocator::_current = _previous;
+    }
+
+    allocator_scope(const allocator_scope&) = delete;
+    void operator=(allocator_scope const&) = delete;
+
+   private:
+    slab_allocator* _previous;
+};
+
+inline void* slab_allocator::allocate(size_t size) {
+    if (size > SLAB_MAX_CELL_SIZE) {
+        return _allocate_large(size);
+    }
+
+    size_t size_class = _class_of(size);
+    slab* s = _slabs[size_class];
+    if (s == nullptr || _is_full(s)) {
+        s = _add_slab(size_class);
+    }
+
+    void* cell;
+    if (s->free != nullptr) {
+        cell = s->free;
+        s->free = *static_cast<void**>(cell);
+    } else {
+        cell = s->bump;
+        s->bump += _cell_size(size_class);
+    }
+
+    size_t offset = _offset_of(s, cell);
+    s->used[offset / 64] |= uint64_t{1} << (offset % 64);
+
+    if (s->live++ == 0) {
+        --_num_spare[size_class];
+    }
+    if (_is_full(s)) {
+        // keep the slabs with free cells first
+        _unlink(s);
+        _push_back(s);
+    }
+
+    ++_allocated[size_class];
+    _allocated_bytes += _cell_size(size_class);
+
+    return cell;
+}
+
+inline void slab_allocator::deallocate(void* ptr, size_t size) {
+    if (size > SLAB_MAX_CELL_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    slab* s = _slab_of(ptr);
+    if (s->owner != nullptr) {
+        s->owner->_deallocate(s, ptr);
+    } else {
+        _deallocate_orphan(s);
+    }
+}
+
+template <typename F>
+void slab_allocator::for_each_cell(F fn) const {
+    for (size_t c = 0; c < SLAB_NUM_CLASSES; c++) {
+        for (const slab* s = _slabs[c]; s != nullptr; s = s->next) {
+            for (size_t w = 0; w < sizeof(s->used) / sizeof(s->used[0]); w++) {
+                uint64_t bits = s->used[w];
+                while (bits != 0) {
+                    size_t offset = w * 64 + __builtin_ctzll(bits);
+                    fn(reinterpret_cast<char*>(const_cast<slab*>(s)) + offset * SLAB_CELL_ALIGN);
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+}
+
+inline slab_allocator& slab_allocator::current() {
+    if (_current != nullptr) {
+        return *_current;
+    } else {
+        static thread_local slab_allocator default_allocator;
+        return default_allocator;
+    }
+}
+
+#endif  // ALLOCATOR_HPP_
@@ -13,13 +13,13 @@ using std::vector;
 
 // token
 
-token::token(const shared_ptr<value>& v) {
-    if (v->type() == value_t::pair) {
+token::token(const value_ref& v) {
+    if (v.type() == value_t::pair) {
         // v is a pair
         auto pair = to_ptr<value_pair>(v);
         if (pair->is_list() and pair->length() == 2) {
             // v is a two-item list
-            if (pair->car()->type() == value_t::symbol) {
+            if (pair->car().type() == value_t::symbol) {
                 // the first item is a symbol
                 string type_symbol = to_ptr<value_symbol>(pair->car())->symbol();
                 if (type_symbol == "op") {
@@ -40,7 +40,7 @@ token::token(const shared_ptr<value>& v) {
                     // use the second item (value) as is
                     _content = pair->pcdr()->car();
                 } else {
-                    if (pair->pcdr()->car()->type() == value_t::symbol) {
+                    if (pair->pcdr()->car().type() == value_t::symbol) {
                         // the second item (name) is a string
                         _content = to_ptr<value_symbol>(pair->pcdr()->car())->symbol();
                     } else {
@@ -62,13 +62,13 @@ token::token(const shared_ptr<value>& v) {
     } else {
         throw code_error(
             "token must be a list: %s",
-            v->str().c_str());
+            v.str().c_str());
     }
 
-    _str = v->str();
+    _str = v.str();
 }
 
-shared_ptr<value> token::to_value() const {
+value_ref token::to_value() const {
     switch (_type) {
         case token_t::op:
             return make_list("op", make_symbol(name()));
@@ -78,7 +78,7 @@ shared_ptr<value> token::to_value() const {
             return make_list("label", make_symbol(name()));
         case token_t::const_:
             // copy _val to avoid const conflict
-            shared_ptr<value> v = val();
+            value_ref v = val();
             return make_list("const", v);
     }
 
@@ -91,7 +91,7 @@ code_label::code_label(const value_symbol* statement) : code(code_t::label) {
     _label = statement->symbol();
 }
 
-shared_ptr<value> code_label::to_value() const {
+value_ref code_label::to_value() const {
     return make_symbol(_label);
 }
 
@@ -104,7 +104,7 @@ code_assign_call::code_assign_call(const value_pair* statement) : code(code_t::a
         auto third = statement->pcdr()->pcdr()->car();
         auto rest = statement->pcdr()->pcdr()->pcdr();
 
-        if (second->type() == value_t::symbol) {
+        if (second.type() == value_t::symbol) {
             // the second item is a symbol
             _reg = to_ptr<value_symbol>(second)->symbol();  // register
             token op_token{third};
@@ -141,7 +141,7 @@ code_assign_call::code_assign_call(const value_pair* statement) : code(code_t::a
     }
 }
 
-shared_ptr<value> code_assign_call::to_value() const {
+value_ref code_assign_call::to_value() const {
     auto result = make_list(
         "assign",                            // header
         make_symbol(_reg),                   // register
@@ -165,7 +165,7 @@ code_assign_copy::code_assign_copy(const value_pair* statement) : code(code_t::a
         auto second = statement->pcdr()->car();
         auto third = statement->pcdr()->pcdr()->car();
 
-        if (second->type() == value_t::symbol) {
+        if (second.type() == value_t::symbol) {
             // the second item is a symbol
             _reg = to_ptr<value_symbol>(second)->symbol();  // register
             token src_token{third};
@@ -189,7 +189,7 @@ code_assign_copy::code_assign_copy(const value_pair* statement) : code(code_t::a
     }
 }
 
-shared_ptr<value> code_assign_copy::to_value() const {
+value_ref code_assign_copy::to_value() const {
     return make_list(
         "assign",           // header
         make_symbol(_reg),  // register
@@ -233,7 +233,7 @@ code_perform::code_perform(const value_pair* statement) : code(code_t::perform)
     }
 }
 
-shared_ptr<value> code_perform::to_value() const {
+value_ref code_perform::to_value() const {
     auto result = make_list(
         "perform",                           // header
         make_list("op", make_symbol(_op)));  // op
@@ -295,7 +295,7 @@ code_branch::code_branch(const value_pair* statement) : code(code_t::branch) {
     }
 }
 
-shared_ptr<value> code_branch::to_value() const {
+value_ref code_branch::to_value() const {
     auto result = make_list(
         "branch",                                 // header
         make_list("label", make_symbol(_label)),  // label
@@ -325,7 +325,7 @@ code_goto::code_goto(const value_pair* statement) : code(code_t::goto_) {
     }
 }
 
-shared_ptr<value> code_goto::to_value() const {
+value_ref code_goto::to_value() const {
     return make_list(
         "goto",               // header
         _target.to_value());  // target
@@ -338,7 +338,7 @@ code_save::code_save(const value_pair* statement) : code(code_t::save) {
         // exactly two items
         auto second = statement->pcdr()->car();
 
-        if (second->type() == value_t::symbol) {
+        if (second.type() == value_t::symbol) {
             // the second item is a symbol
             _reg = to_ptr<value_symbol>(second)->symbol();
         } else {
@@ -353,7 +353,7 @@ code_save::code_save(const value_pair* statement) : code(code_t::save) {
     }
 }
 
-shared_ptr<value> code_save::to_value() const {
+value_ref code_save::to_value() const {
     return make_list(
         "save",              // header
         make_symbol(_reg));  // register
@@ -366,7 +366,7 @@ code_restore::code_restore(const value_pair* statement) : code(code_t::restore)
         // exactly two items
         auto second = statement->pcdr()->car();
 
-        if (second->type() == value_t::symbol) {
+        if (second.type() == value_t::symbol) {
             // the second item is a symbol
             _reg = to_ptr<value_symbol>(second)->symbol();
         } else {
@@ -381,7 +381,7 @@ code_restore::code_restore(const value_pair* statement) : code(code_t::restore)
     }
 }
 
-shared_ptr<value> code_restore::to_value() const {
+value_ref code_restore::to_value() const {
     return make_list(
         "restore",           // header
         make_symbol(_reg));  // register
@@ -405,23 +405,23 @@ bool is_assign_call(const value_pair* statement) {
 
 }  // namespace
 
-vector<shared_ptr<code>> translate_to_code(const shared_ptr<value>& source) {
+vector<shared_ptr<code>> translate_to_code(const value_ref& source) {
     vector<shared_ptr<code>> result;
 
     if (source != nil) {
-        if (source->type() == value_t::pair) {
+        if (source.type() == value_t::pair) {
             // source is a list
             auto lines = to_ptr<value_pair>(source);
             for (const auto& line : *lines) {
                 // there is another statement
                 if (line.type() == value_t::symbol) {
                     // the statement is a symbol
-                    auto label = reinterpret_cast<const value_symbol*>(&line);
+                    auto label = to_ptr<value_symbol>(line);
                     result.push_back(make_shared<code_label>(label));
                 } else if (line.type() == value_t::pair) {
                     // the statement is a list
-                    auto statement = reinterpret_cast<const value_pair*>(&line);
-                    if (statement->car()->type() == value_t::symbol) {
+                    auto statement = to_ptr<value_pair>(line);
+                    if (statement->car().type() == value_t::symbol) {
                         // the statement header is a symbol
                         string header = to_ptr<value_symbol>(statement->car())->symbol();
                         if (header == "assign") {
@@ -448,7 +448,7 @@ vector<shared_ptr<code>> translate_to_code(const shared_ptr<value>& source) {
                     } else {
                         throw code_error(
                             "statement header must be a symbol: %s",
-                            statement->car()->str().c_str());
+                            statement->car().str().c_str());
                     }
                 } else {
                     throw code_error(
@@ -459,7 +459,7 @@ vector<shared_ptr<code>> translate_to_code(const shared_ptr<value>& source) {
         } else {
             throw code_error(
                 "source must be a list of statements: %s",
-                source->str().c_str());
+                source.str().c_str());
         }
     }
 
@@ -44,10 +44,10 @@ class token {
     token(token_t type, const string& name) : _type(type), _content(name), _str(to_value()->str()) {
         assert(type == token_t::op || type == token_t::reg || type == token_t::label);
     }
-    token(token_t type, const shared_ptr<value>& val) : _type(type), _content(val), _str(to_value()->str()) {
+    token(token_t type, const value_ref& val) : _type(type), _content(val), _str(to_value()->str()) {
         assert(type == token_t::const_);
     }
-    token(const shared_ptr<value>& v);
+    token(const value_ref& v);
 
     token_t type() const { return _type; }
 
@@ -56,12 +56,12 @@ class token {
         return get<string>(_content);
     }
 
-    const shared_ptr<value>& val() const {
+    const value_ref& val() const {
         assert(_type == token_t::const_);
-        return get<shared_ptr<value>>(_content);
+        return get<value_ref>(_content);
     }
 
-    shared_ptr<value> to_value() const;
+    value_ref to_value() const;
 
     ostream& write(ostream& os) const {
         return (os << _str);
@@ -83,7 +83,7 @@ class token {
     token() {}
 
     token_t _type;
-    variant<string, shared_ptr<value>> _content;
+    variant<string, value_ref> _content;
     string _str;  // string representation
 };
 
@@ -106,7 +106,7 @@ class code {
 
     code_t type() const { return _type; }
 
-    virtual shared_ptr<value> to_value() const = 0;
+    virtual value_ref to_value() const = 0;
 
     ostream& write(ostream& os) const {
         return (os << *to_value());
@@ -133,7 +133,7 @@ class code_label : public code {
 
     const string& label() const { return _label; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _label;
@@ -152,7 +152,7 @@ class code_assign_call : public code {
     const string& op() const { return _op; }
     vector<token>& args() { return _args; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _reg;
@@ -169,7 +169,7 @@ class code_assign_copy : public code {
     const string& reg() const { return _reg; }
     const token& src() const { return _src; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _reg;
@@ -181,13 +181,13 @@ class code_perform : public code {
     code_perform(
         const string& op,
         const vector<token>& args)
-        : code(code_t::assign_call), _op{op}, _args{args} {}
+        : code(code_t::perform), _op{op}, _args{args} {}
     code_perform(const value_pair* v);
 
     const string& op() const { return _op; }
     vector<token>& args() { return _args; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _op;
@@ -207,7 +207,7 @@ class code_branch : public code {
     const string& op() const { return _op; }
     vector<token>& args() { return _args; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _label;
@@ -223,7 +223,7 @@ class code_goto : public code {
 
     const token& target() const { return _target; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     token _target;
@@ -237,7 +237,7 @@ class code_save : public code {
 
     const string& reg() const { return _reg; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _reg;
@@ -251,7 +251,7 @@ class code_restore : public code {
 
     const string& reg() const { return _reg; }
 
-    shared_ptr<value> to_value() const override;
+    value_ref to_value() const override;
 
    private:
     string _reg;
@@ -259,7 +259,7 @@ class code_restore : public code {
 
 // helper functions
 
-vector<shared_ptr<code>> translate_to_code(const shared_ptr<value>& source);
+vector<shared_ptr<code>> translate_to_code(const value_ref& source);
 
 inline ostream& operator<<(ostream& os, const token& t) {
     return t.write(os);
@@ -0,0 +1,799 @@
+#include "compiler.hpp"
+
+#include <cassert>
+#include <initializer_list>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "code.hpp"
+#include "syntax.hpp"
+#include "value.hpp"
+
+using std::initializer_list;
+using std::make_shared;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+// instruction sequence: the registers needed (read before
+// written) and modified by the code, the lines of the code
+
+struct sequence {
+    set<string> needed;
+    set<string> modified;
+    vector<shared_ptr<code>> lines;
+};
+
+size_t label_counter = 0;
+
+// helpers
+
+set<string> union_of(const set<string>& set1, const set<string>& set2) {
+    set<string> result{set1};
+    result.insert(set2.begin(), set2.end());
+
+    return result;
+}
+
+set<string> difference_of(const set<string>& set1, const set<string>& set2) {
+    set<string> result;
+    for (const auto& item : set1) {
+        if (set2.count(item) == 0) {
+            result.insert(item);
+        }
+    }
+
+    return result;
+}
+
+vector<shared_ptr<code>> code_append(const vector<shared_ptr<code>>& code1, const vector<shared_ptr<code>>& code2) {
+    vector<shared_ptr<code>> result{code1};
+    result.insert(result.end(), code2.begin(), code2.end());
+
+    return result;
+}
+
+token reg_token(const string& name) {
+    return token(token_t::reg, name);
+}
+
+token label_token(const string& name) {
+    return token(token_t::label, name);
+}
+
+token const_token(const value_ref& val) {
+    return token(token_t::const_, val);
+}
+
+shared_ptr<code> make_assign(const string& reg, const string& op, initializer_list<token> args) {
+    return make_shared<code_assign_call>(reg, op, vector<token>{args});
+}
+
+shared_ptr<code> make_assign(const string& reg, const token& src) {
+    return make_shared<code_assign_copy>(reg, src);
+}
+
+shared_ptr<code> make_perform(const string& op, initializer_list<token> args) {
+    return make_shared<code_perform>(op, vector<token>{args});
+}
+
+shared_ptr<code> make_branch(const string& label, const string& op, initializer_list<token> args) {
+    return make_shared<code_branch>(label, op, vector<token>{args});
+}
+
+shared_ptr<code> make_goto(const token& target) {
+    return make_shared<code_goto>(target);
+}
+
+string make_label(const string& name, bool increment_counter) {
+    if (increment_counter) {
+        label_counter++;
+    }
+
+    return name + "-" + to_string(label_counter);
+}
+
+sequence make_label_sequence(const string& label) {
+    return {{}, {}, {make_shared<code_label>(label)}};
+}
+
+// combining the sequences
+
+sequence append_sequences(const sequence& seq1, const sequence& seq2) {
+    return {
+        // needed = needed by #1 + (needed by #2 - modified by #1)
+        union_of(seq1.needed, difference_of(seq2.needed, seq1.modified)),
+        // modified = modified by #1 + modified by #2
+        union_of(seq1.modified, seq2.modified),
+        // code = code of #1 + code of #2
+        code_append(seq1.lines, seq2.lines),
+    };
+}
+
+sequence preserving(initializer_list<string> regs, const sequence& seq1, const sequence& seq2) {
+    sequence first{seq1};
+    for (const auto& reg : regs) {
+        if (first.modified.count(reg) > 0 && seq2.needed.count(reg) > 0) {
+            // needed = needed by #1 + the register
+            first.needed.insert(reg);
+            // modified = modified by #1 - the register
+            first.modified.erase(reg);
+            // code = save the register + code of #1 + restore the register
+            first.lines.insert(first.lines.begin(), make_shared<code_save>(reg));
+            first.lines.push_back(make_shared<code_restore>(reg));
+        }
+    }
+
+    return append_sequences(first, seq2);
+}
+
+sequence tack_on_sequence(const sequence& seq1, const sequence& seq2) {
+    return {
+        // needed = needed by #1
+        seq1.needed,
+        // modified = modified by #1
+        seq1.modified,
+        // code = code of #1 + code of #2
+        code_append(seq1.lines, seq2.lines),
+    };
+}
+
+sequence parallel_sequences(const sequence& seq1, const sequence& seq2) {
+    return {
+        // needed = needed by #1 + needed by #2
+        union_of(seq1.needed, seq2.needed),
+        // modified = modified by #1 + modified by #2
+        union_of(seq1.modified, seq2.modified),
+        // code = code of #1 + code of #2
+        code_append(seq1.lines, seq2.lines),
+    };
+}
+
+sequence compile_linkage(const string& linkage) {
+    if (linkage == "return") {
+        return {{"continue"}, {}, {make_goto(reg_token("continue"))}};
+    } else if (linkage != "next") {
+        return {{}, {}, {make_goto(label_token(linkage))}};
+    } else {
+        return {};  // empty sequence for the "next" linkage
+    }
+}
+
+sequence end_with_linkage(const string& linkage, const sequence& seq) {
+    return preserving(
+        {"continue"},
+        seq,
+        compile_linkage(linkage));
+}
+
+// compiling the expressions
+
+sequence compile_rec(const value_ref& exp, const string& target, const string& linkage);
+
+sequence compile_self_evaluating(const value_ref& exp, const string& target, const string& linkage) {
+    // return the exp
+    return end_with_linkage(
+        linkage,
+        {{}, {target}, {make_assign(target, const_token(exp))}});
+}
+
+sequence compile_quoted(const value_ref& exp, const string& target, const string& linkage) {
+    // return the quoted exp
+    return end_with_linkage(
+        linkage,
+        {{}, {target}, {make_assign(target, const_token(get_text_of_quotation(exp)))}});
+}
+
+sequence compile_variable(const value_ref& exp, const string& target, const string& linkage) {
+    // lookup the variable
+    // and return its value
+    return end_with_linkage(
+        linkage,
+        {{"env"}, {target}, {make_assign(target, "lookup-variable-value", {const_token(exp), reg_token("env")})}});
+}
+
+sequence compile_assignment(const value_ref& exp, const string& target, const string& linkage) {
+    // evaluate the value of the assignment
+    auto value_seq = compile_rec(get_assignment_value(exp), "val", "next");
+
+    // variable name to assign (a symbol)
+    auto name = get_assignment_variable(exp);
+
+    // assignment sequence
+    sequence assign_seq{
+        {"env", "val"},
+        {target},
+        {make_assign(target, "set-variable-value!", {const_token(name), reg_token("val"), reg_token("env")})},
+    };
+
+    return end_with_linkage(
+        linkage,
+        preserving(
+            {"env"},
+            value_seq,     // value evaluation
+            assign_seq));  // assignment
+}
+
+sequence compile_definition(const value_ref& exp, const string& target, const string& linkage) {
+    // evaluate the value of the definition
+    auto value_seq = compile_rec(get_definition_value(exp), "val", "next");
+
+    // variable name to define (a symbol)
+    auto name = get_definition_variable(exp);
+
+    // definition sequence
+    sequence define_seq{
+        {"env", "val"},
+        {target},
+        {make_assign(target, "define-variable!", {const_token(name), reg_token("val"), reg_token("env")})},
+    };
+
+    return end_with_linkage(
+        linkage,
+        preserving(
+            {"env"},
+            value_seq,     // value evaluation
+            define_seq));  // definition
+}
+
+sequence compile_if(const value_ref& exp, const string& target, const string& linkage) {
+    // labels for different sections of the if
+    auto true_branch = make_label("true-branch", true);
+    auto false_branch = make_label("false-branch", false);
+    auto after_if = make_label("after-if", false);
+
+    // to circumvent the alternative if linkage is next
+    auto cons_linkage = (linkage == "next" ? after_if : linkage);
+
+    // compiled predicate, consequent, and alternative of the if
+    auto pred_seq = compile_rec(get_if_predicate(exp), "val", "next");
+    auto cons_seq = compile_rec(get_if_consequent(exp), target, cons_linkage);
+    auto alt_seq = compile_rec(get_if_alternative(exp), target, linkage);
+
+    // test sequence
+    sequence test_seq{
+        {"val"},
+        {},
+        {make_branch(false_branch, "false?", {reg_token("val")})},
+    };
+
+    return preserving(
+        {"env", "continue"},
+        pred_seq,  // predicate
+        append_sequences(
+            append_sequences(
+                test_seq,  // test
+                parallel_sequences(
+                    append_sequences(
+                        make_label_sequence(true_branch),  // true label
+                        cons_seq),                         // consequent
+                    append_sequences(
+                        make_label_sequence(false_branch),  // false label
+                        alt_seq))),                         // alternative
+            make_label_sequence(after_if)));                // after label
+}
+
+sequence compile_sequence(const value_ref& exp, const string& target, const string& linkage) {
+    if (is_last_exp(exp)) {
+        // compile the last expression with target and linkage
+        return compile_rec(get_first_exp(exp), target, linkage);
+    } else {
+        return preserving(
+            {"env", "continue"},
+            compile_rec(get_first_exp(exp), target, "next"),           // compile with next
+            compile_sequence(get_rest_exps(exp), target, linkage));  // compile the rest
+    }
+}
+
+sequence compile_lambda_body(const value_ref& exp, const string& entry, const value_ref& params) {
+    // proc entry + extend the env by bounding
+    // the lambda params to the arglist args
+    sequence pre_body_seq{
+        {"env", "proc", "argl"},
+        {"env"},
+        {
+            make_shared<code_label>(entry),
+            make_assign("env", "compiled-environment", {reg_token("proc")}),
+            make_assign("env", "extend-environment", {const_token(params), reg_token("argl"), reg_token("env")}),
+        },
+    };
+
+    return append_sequences(
+        pre_body_seq,                                                 // before the body
+        compile_sequence(get_lambda_body(exp), "val", "return"));  // the body
+}
+
+sequence compile_lambda(const value_ref& exp, const string& target, const string& linkage) {
+    auto params = get_lambda_parameters(exp);
+
+    // labels to separate the body from the rest
+    auto proc_entry = make_label("proc-entry", true);      // before the body
+    auto after_lambda = make_label("after-lambda", false);  // after the body
+
+    // to circumvent the body if linkage is next
+    auto lambda_linkage = (linkage == "next" ? after_lambda : linkage);
+
+    // make the compiled procedure
+    // from the env and the proc entry
+    sequence assign_seq{
+        {"env"},
+        {target},
+        {make_assign(target, "make-compiled-procedure", {const_token(params), label_token(proc_entry), reg_token("env")})},
+    };
+
+    return append_sequences(
+        tack_on_sequence(  // ignore the body's needs and modifies
+            end_with_linkage(lambda_linkage, assign_seq),     // assign the compiled lambda
+            compile_lambda_body(exp, proc_entry, params)),  // proc entry, extend the env, body
+        make_label_sequence(after_lambda));                   // after label
+}
+
+sequence compile_and_or(
+    const value_ref& exps,
+    const string& target,
+    const string& linkage,
+    const string& label_name,
+    const string& jump_op) {
+    // collect the exps in the reversed order
+    vector<sequence> rev_exp_seqs;
+    for (auto rest = exps; !has_no_exps(rest); rest = get_rest_exps(rest)) {
+        rev_exp_seqs.insert(rev_exp_seqs.begin(), compile_rec(get_first_exp(rest), "val", "next"));
+    }
+
+    // a new label to jump to the end
+    auto after_label = make_label(label_name, true);
+
+    // immediately jump to the end if the
+    // preceeding expression decides the result
+    sequence jump_seq{
+        {"val"},
+        {},
+        {make_branch(after_label, jump_op, {reg_token("val")})},
+    };
+
+    // the last expression evaluation:
+    // without a conditional jump
+    auto eval_seq = rev_exp_seqs[0];
+    for (size_t i = 1; i < rev_exp_seqs.size(); i++) {
+        // the next expression evaluation:
+        // with a conditional jump
+        eval_seq = preserving(
+            {"env"},
+            rev_exp_seqs[i],
+            append_sequences(
+                jump_seq,
+                eval_seq));
+    }
+
+    // final sequence with the label
+    sequence final_seq{{}, {}, {make_shared<code_label>(after_label)}};
+
+    if (target != "val") {
+        // return into the target if required
+        final_seq.needed.insert("val");
+        final_seq.modified.insert(target);
+        final_seq.lines.push_back(make_assign(target, reg_token("val")));
+    }
+
+    return end_with_linkage(
+        linkage,
+        append_sequences(
+            eval_seq,     // chain of evaluations
+            final_seq));  // the label + return if required
+}
+
+sequence compile_and(const value_ref& exp, const string& target, const string& linkage) {
+    auto exps = get_and_expressions(exp);
+    if (has_no_exps(exps)) {
+        // no exps: return true
+        return compile_self_evaluating(true_, target, linkage);
+    } else if (is_last_exp(exps)) {
+        // single exp: compile as a singleton exp
+        return compile_rec(get_first_exp(exps), target, linkage);
+    } else {
+        // jump to the end on the first false
+        return compile_and_or(exps, target, linkage, "after-and", "false?");
+    }
+}
+
+sequence compile_or(const value_ref& exp, const string& target, const string& linkage) {
+    auto exps = get_or_expressions(exp);
+    if (has_no_exps(exps)) {
+        // no exps: return false
+        return compile_self_evaluating(false_, target, linkage);
+    } else if (is_last_exp(exps)) {
+        // single exp: compile as a singleton exp
+        return compile_rec(get_first_exp(exps), target, linkage);
+    } else {
+        // jump to the end on the first true
+        return compile_and_or(exps, target, linkage, "after-or", "true?");
+    }
+}
+
+sequence compile_eval(const value_ref& eval, const string& target, const string& linkage) {
+    auto exp = get_eval_expression(eval);
+    if (is_self_evaluating(exp)) {
+        return compile_self_evaluating(exp, target, linkage);
+    } else if (is_quoted(exp)) {
+        return compile_rec(get_text_of_quotation(exp), target, linkage);
+    }
+
+    // can't be target != "val" and linkage == "return" simultaneously
+    assert(target == "val" || linkage != "return");
+
+    // the first (internal / compiled) evaluation sequence
+    auto internal_seq = compile_rec(exp, "exp", "next");
+
+    // the second (external / interpreted) evaluation sequence:
+    // needs the env, anything can happen during evaluation
+    sequence external_seq{
+        {"env", "continue"},
+        {"env", "proc", "val", "argl", "continue"},
+        {},
+    };
+
+    auto& lines = external_seq.lines;
+    if (linkage == "return") {
+        // just goto eval-dispatch which will then
+        // set to the val and return to the continue
+        lines.push_back(make_goto(label_token("eval-dispatch")));
+    } else if (linkage == "next") {
+        // a new label to return to after the evaluation
+        auto after_eval = make_label("after-eval", true);
+
+        // assign new label to the continue and goto eval-dispatch
+        lines.push_back(make_assign("continue", label_token(after_eval)));
+        lines.push_back(make_goto(label_token("eval-dispatch")));
+        lines.push_back(make_shared<code_label>(after_eval));
+
+        if (target != "val") {
+            // assign val to the target if required
+            lines.push_back(make_assign(target, reg_token("val")));
+        }
+    } else if (target == "val") {
+        // set the continue to the linkage and goto eval-dispatch
+        lines.push_back(make_assign("continue", label_token(linkage)));
+        lines.push_back(make_goto(label_token("eval-dispatch")));
+    } else {
+        // a new label to return to after the evaluation
+        auto after_eval = make_label("after-eval", true);
+
+        // set the continue to the after-eval label and goto eval-dispatch
+        // on return, set the val to the target and goto the linkage
+        lines.push_back(make_assign("continue", label_token(after_eval)));
+        lines.push_back(make_goto(label_token("eval-dispatch")));
+        lines.push_back(make_shared<code_label>(after_eval));
+        lines.push_back(make_assign(target, reg_token("val")));
+        lines.push_back(make_goto(label_token(linkage)));
+    }
+
+    return preserving(
+        {"env", "continue"},
+        internal_seq,
+        external_seq);
+}
+
+sequence compile_rest_args(const vector<sequence>& rev_operand_seqs, size_t next) {
+    // add next arg to the the arglist
+    sequence after_next_seq{
+        {"val", "argl"},
+        {"argl"},
+        {make_assign("argl", "cons", {reg_token("val"), reg_token("argl")})},
+    };
+
+    // do the next arg and prepend it to arglist
+    auto next_arg_seq = preserving(
+        {"argl"},  // keep the argl
+        rev_operand_seqs[next],
+        after_next_seq);
+
+    if (next + 1 == rev_operand_seqs.size()) {
+        // the next is the first arg
+        return next_arg_seq;
+    } else {
+        return preserving(
+            {"env"},                                        // keep the env
+            next_arg_seq,                                   // do the next arg
+            compile_rest_args(rev_operand_seqs, next + 1));  // then do the rest
+    }
+}
+
+sequence compile_arglist(const vector<sequence>& rev_operand_seqs) {
+    if (rev_operand_seqs.empty()) {
+        // empty arglist
+        return {{}, {"argl"}, {make_assign("argl", const_token(nil))}};
+    }
+
+    // the arglist with the last arg
+    sequence after_last_seq{
+        {"val"},
+        {"argl"},
+        {make_assign("argl", "cons", {reg_token("val"), const_token(nil)})},
+    };
+
+    // do the last arg and make arglist from it
+    auto last_arg_seq = append_sequences(
+        rev_operand_seqs[0],
+        after_last_seq);
+
+    if (rev_operand_seqs.size() == 1) {
+        // the last arg is the only arg
+        return last_arg_seq;
+    } else {
+        return preserving(
+            {"env"},                                   // keep the env
+            last_arg_seq,                              // do the last arg
+            compile_rest_args(rev_operand_seqs, 1));  // then do the rest
+    }
+}
+
+sequence compile_procedure_call(
+    const string& target,
+    const string& linkage,
+    const vector<shared_ptr<code>>& call) {
+    // can't be target != "val" and linkage == "return" simultaneously
+    assert(target == "val" || linkage != "return");
+
+    // need the proc to call, anyting can happen in the call
+    sequence call_seq{
+        {"proc"},
+        {"env", "proc", "val", "argl", "continue"},
+        {},
+    };
+
+    auto& lines = call_seq.lines;
+    if (linkage == "return") {
+        // need the continue for the call to return to
+        call_seq.needed.insert("continue");
+        lines.insert(lines.end(), call.begin(), call.end());
+    } else if (target == "val") {
+        // set the continue to the linkage and call
+        lines.push_back(make_assign("continue", label_token(linkage)));
+        lines.insert(lines.end(), call.begin(), call.end());
+    } else {
+        // a new label to return to after the call
+        auto proc_return = make_label("proc-return", true);
+
+        // set the continue to the proc-return label and call
+        // on return, set the val to the target and goto the linkage
+        lines.push_back(make_assign("continue", label_token(proc_return)));
+        lines.insert(lines.end(), call.begin(), call.end());
+        lines.push_back(make_shared<code_label>(proc_return));
+        lines.push_back(make_assign(target, reg_token("val")));
+        lines.push_back(make_goto(label_token(linkage)));
+    }
+
+    return call_seq;
+}
+
+sequence compile_compiled_call(const string& target, const string& linkage) {
+    // goto the proc's entry: it returns to the continue
+    return compile_procedure_call(
+        target, linkage,
+        {
+            make_assign("val", "compiled-entry", {reg_token("proc")}),
+            make_goto(reg_token("val")),
+        });
+}
+
+sequence compile_compound_call(const string& target, const string& linkage) {
+    // save the continue and goto compound-apply
+    // of the evaluator: it returns to the continue
+    return compile_procedure_call(
+        target, linkage,
+        {
+            make_shared<code_save>("continue"),
+            make_goto(label_token("compound-apply")),
+        });
+}
+
+sequence compile_primitive_call(const string& target, const string& linkage) {
+    // call the primitive proc
+    return end_with_linkage(
+        linkage,
+        {{"proc", "argl"}, {target}, {make_assign(target, "apply-primitive-procedure", {reg_token("proc"), reg_token("argl")})}});
+}
+
+sequence compile_general_call(const string& target, const string& linkage) {
+    // labels for the procedure type selection
+    auto primitive_branch = make_label("primitive-branch", true);
+    auto compiled_branch = make_label("compiled-branch", false);
+    auto compound_branch = make_label("compound-branch", false);
+    auto after_call = make_label("after-call", false);
+
+    // to circumvent the primitive part after the compiled if linkage is next
+    auto non_primitive_linkage = (linkage == "next" ? after_call : linkage);
+
+    // test for the proc type
+    sequence test_seq{
+        {"proc"},
+        {},
+        {
+            make_branch(primitive_branch, "primitive-procedure?", {reg_token("proc")}),
+            make_branch(compiled_branch, "compiled-procedure?", {reg_token("proc")}),
+            make_branch(compound_branch, "compound-procedure?", {reg_token("proc")}),
+            make_perform("signal-error", {const_token(make_string("can't apply %s")), reg_token("proc")}),
+        },
+    };
+
+    return append_sequences(
+        append_sequences(
+            test_seq,            // test for the proc type
+            parallel_sequences(  // 3 parallel sequences
+                parallel_sequences(
+                    append_sequences(
+                        make_label_sequence(compiled_branch),                   // compiled label
+                        compile_compiled_call(target, non_primitive_linkage)),  // call the compiled
+                    append_sequences(
+                        make_label_sequence(compound_branch),                   // compound label
+                        compile_compound_call(target, non_primitive_linkage))),  // call the compound
+                append_sequences(
+                    make_label_sequence(primitive_branch),          // primitive label
+                    compile_primitive_call(target, linkage)))),  // call the primitive
+        make_label_sequence(after_call));                            // after call label
+}
+
+sequence make_application_sequence(
+    const value_ref& op_exp,
+    const sequence& arg_seq,
+    const string& target,
+    const string& linkage) {
+    auto op_seq = compile_rec(op_exp, "proc", "next");
+
+    // the type of proc is tested at run time: the name of
+    // a primitive can be rebound or shadowed by a parameter
+    auto call_seq = compile_general_call(target, linkage);
+
+    return preserving(
+        {"env", "continue"},
+        op_seq,  // first get the operator into proc
+        preserving(
+            {"proc", "continue"},
+            arg_seq,     // then get the operands into argl
+            call_seq));  // then call the proc: primitive or non-primitive
+}
+
+sequence compile_apply(const value_ref& exp, const string& target, const string& linkage) {
+    // put the arguments into argl with the next linkage
+    auto get_args_seq = compile_rec(get_apply_arguments(exp), "argl", "next");
+
+    // check the arguments of apply after evaluation
+    sequence check_args_seq{
+        {"argl"},
+        {},
+        {make_perform("check-apply-args", {reg_token("argl")})},
+    };
+
+    // put the argument list into argl and check the list
+    auto arg_seq = append_sequences(get_args_seq, check_args_seq);
+
+    return make_application_sequence(get_apply_operator(exp), arg_seq, target, linkage);
+}
+
+sequence compile_application(const value_ref& exp, const string& target, const string& linkage) {
+    // collect the code snippets to put each operand
+    // into val with next linkage, in the reversed order
+    vector<sequence> rev_operand_seqs;
+    for (auto rest = get_operands(exp); !has_no_operands(rest); rest = get_rest_operands(rest)) {
+        rev_operand_seqs.insert(rev_operand_seqs.begin(), compile_rec(get_first_operand(rest), "val", "next"));
+    }
+
+    // compile and collect the arguments into the argl list
+    auto arg_seq = compile_arglist(rev_operand_seqs);
+
+    return make_application_sequence(get_operator(exp), arg_seq, target, linkage);
+}
+
+sequence compile_rec(const value_ref& exp, const string& target, const string& linkage) {
+    if (is_self_evaluating(exp)) {
+        return compile_self_evaluating(exp, target, linkage);
+    } else if (is_variable(exp)) {
+        return compile_variable(exp, target, linkage);
+    } else if (is_quoted(exp)) {
+        return compile_quoted(exp, target, linkage);
+    } else if (is_assignment(exp)) {
+        return compile_assignment(exp, target, linkage);
+    } else if (is_definition(exp)) {
+        return compile_definition(exp, target, linkage);
+    } else if (is_if(exp)) {
+        return compile_if(exp, target, linkage);
+    } else if (is_lambda(exp)) {
+        return compile_lambda(exp, target, linkage);
+    } else if (is_let(exp)) {
+        return compile_rec(transform_let(exp), target, linkage);
+    } else if (is_begin(exp)) {
+        return compile_sequence(get_begin_actions(exp), target, linkage);
+    } else if (is_cond(exp)) {
+        return compile_rec(transform_cond(exp), target, linkage);
+    } else if (is_and(exp)) {
+        return compile_and(exp, target, linkage);
+    } else if (is_or(exp)) {
+        return compile_or(exp, target, linkage);
+    } else if (is_eval(exp)) {
+        return compile_eval(exp, target, linkage);
+    } else if (is_apply(exp)) {
+        return compile_apply(exp, target, linkage);
+    } else {
+        // default: application
+        return compile_application(exp, target, linkage);
+    }
+}
+
+void check_syntax(const value_ref& exp);
+
+void check_exps(value_ref exps) {
+    // recursively check the expressions
+    for (; !has_no_exps(exps); exps = get_rest_exps(exps)) {
+        check_syntax(get_first_exp(exps));
+    }
+}
+
+void check_syntax(const value_ref& exp) {
+    // throws on the first error
+    if (is_self_evaluating(exp) || is_variable(exp)) {
+        return;  // always ok
+    } else if (is_quoted(exp)) {
+        check_quoted(exp);
+    } else if (is_assignment(exp)) {
+        check_assignment(exp);
+        check_syntax(get_assignment_value(exp));
+    } else if (is_definition(exp)) {
+        check_definition(exp);
+        check_syntax(get_definition_value(exp));
+    } else if (is_if(exp)) {
+        check_if(exp);
+        check_syntax(get_if_predicate(exp));
+        check_syntax(get_if_consequent(exp));
+        check_syntax(get_if_alternative(exp));
+    } else if (is_lambda(exp)) {
+        check_lambda(exp);
+        check_exps(get_lambda_body(exp));
+    } else if (is_let(exp)) {
+        check_let(exp);
+        check_syntax(transform_let(exp));
+    } else if (is_begin(exp)) {
+        check_begin(exp);
+        check_exps(get_begin_actions(exp));
+    } else if (is_cond(exp)) {
+        check_cond(exp);
+        check_syntax(transform_cond(exp));
+    } else if (is_and(exp)) {
+        check_and(exp);
+        check_exps(get_and_expressions(exp));
+    } else if (is_or(exp)) {
+        check_or(exp);
+        check_exps(get_or_expressions(exp));
+    } else if (is_eval(exp)) {
+        check_eval(exp);
+        check_syntax(get_eval_expression(exp));
+    } else if (is_apply(exp)) {
+        check_apply(exp);
+        check_syntax(get_apply_operator(exp));
+        check_syntax(get_apply_arguments(exp));
+    } else {
+        // default: application
+        check_application(exp);
+        check_syntax(get_operator(exp));
+        for (auto rest = get_operands(exp); !has_no_operands(rest); rest = get_rest_operands(rest)) {
+            check_syntax(get_first_operand(rest));
+        }
+    }
+}
+
+}  // namespace
+
+// helper functions
+
+vector<shared_ptr<code>> compile(const value_ref& exp, const string& target, const string& linkage) {
+    // check the syntax of the exp first
+    check_syntax(exp);
+
+    // compile the sequence
+    return compile_rec(exp, target, linkage).lines;
+}
@@ -0,0 +1,27 @@
+#ifndef COMPILER_HPP_
+#define COMPILER_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "code.hpp"
+#include "value.hpp"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+// helper functions
+
+// compile the expression into the code for the explicit-control
+// evaluator's machine (its registers, labels, and ops): the result
+// goes to the target register, then the code continues by the
+// linkage: "next" (falls through), "return" (goes to the continue
+// register), or a label. the syntax is checked up front
+vector<shared_ptr<code>> compile(
+    const value_ref& exp,
+    const string& target = "val",
+    const string& linkage = "return");
+
+#endif  // COMPILER_HPP_
@@ -1,5 +1,6 @@
 #include "evaluator.hpp"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
@@ -14,8 +15,6 @@
 #include "syntax.hpp"
 #include "value.hpp"
 
-using std::make_shared;
-using std::shared_ptr;
 using std::snprintf;
 using std::strcpy;
 using std::string;
@@ -23,247 +22,265 @@ using std::unordered_map;
 using std::vector;
 using std::filesystem::path;
 
-shared_ptr<value> evaluator::op_check_quoted(const vector<value_pair*>& args) {
+thread_local evaluator::syntax_cache* evaluator::syntax_cache::_current = nullptr;
+
+value_ref evaluator::op_check_quoted(const vector<value_pair*>& args) {
     check_quoted(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_text_of_quotation(const vector<value_pair*>& args) {
+value_ref evaluator::op_text_of_quotation(const vector<value_pair*>& args) {
     return get_text_of_quotation(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_assignment(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_assignment(const vector<value_pair*>& args) {
     check_assignment(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_assignment_variable(const vector<value_pair*>& args) {
+value_ref evaluator::op_assignment_variable(const vector<value_pair*>& args) {
     return get_assignment_variable(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_assignment_value(const vector<value_pair*>& args) {
+value_ref evaluator::op_assignment_value(const vector<value_pair*>& args) {
     return get_assignment_value(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_definition(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_definition(const vector<value_pair*>& args) {
     check_definition(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_definition_variable(const vector<value_pair*>& args) {
+value_ref evaluator::op_definition_variable(const vector<value_pair*>& args) {
     return get_definition_variable(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_definition_value(const vector<value_pair*>& args) {
+value_ref evaluator::op_definition_value(const vector<value_pair*>& args) {
     return get_definition_value(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_if(const vector<value_pair*>& args) {
-    check_if(args[0]->car());
+value_ref evaluator::op_check_if(const vector<value_pair*>& args) {
+    syntax_cache::check(args[0]->car(), check_if);
     return nil;
 }
 
-shared_ptr<value> evaluator::op_if_predicate(const vector<value_pair*>& args) {
+value_ref evaluator::op_if_predicate(const vector<value_pair*>& args) {
     return get_if_predicate(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_if_consequent(const vector<value_pair*>& args) {
+value_ref evaluator::op_if_consequent(const vector<value_pair*>& args) {
     return get_if_consequent(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_if_alternative(const vector<value_pair*>& args) {
+value_ref evaluator::op_if_alternative(const vector<value_pair*>& args) {
     return get_if_alternative(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_lambda(const vector<value_pair*>& args) {
-    check_lambda(args[0]->car());
+value_ref evaluator::op_check_lambda(const vector<value_pair*>& args) {
+    syntax_cache::check(args[0]->car(), check_lambda);
     return nil;
 }
 
-shared_ptr<value> evaluator::op_lambda_parameters(const vector<value_pair*>& args) {
+value_ref evaluator::op_lambda_parameters(const vector<value_pair*>& args) {
     return get_lambda_parameters(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_lambda_body(const vector<value_pair*>& args) {
+value_ref evaluator::op_lambda_body(const vector<value_pair*>& args) {
     return get_lambda_body(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_let(const vector<value_pair*>& args) {
-    check_let(args[0]->car());
+value_ref evaluator::op_check_let(const vector<value_pair*>& args) {
+    syntax_cache::check(args[0]->car(), check_let);
     return nil;
 }
 
-shared_ptr<value> evaluator::op_transform_let(const vector<value_pair*>& args) {
-    return transform_let(args[0]->car());
+value_ref evaluator::op_transform_let(const vector<value_pair*>& args) {
+    return syntax_cache::transform(args[0]->car(), transform_let);
 }
 
-shared_ptr<value> evaluator::op_check_begin(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_begin(const vector<value_pair*>& args) {
     check_begin(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_begin_actions(const vector<value_pair*>& args) {
+value_ref evaluator::op_begin_actions(const vector<value_pair*>& args) {
     return get_begin_actions(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_cond(const vector<value_pair*>& args) {
-    check_cond(args[0]->car());
+value_ref evaluator::op_check_cond(const vector<value_pair*>& args) {
+    syntax_cache::check(args[0]->car(), check_cond);
     return nil;
 }
 
-shared_ptr<value> evaluator::op_transform_cond(const vector<value_pair*>& args) {
-    return transform_cond(args[0]->car());
+value_ref evaluator::op_transform_cond(const vector<value_pair*>& args) {
+    return syntax_cache::transform(args[0]->car(), transform_cond);
 }
 
-shared_ptr<value> evaluator::op_check_and(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_and(const vector<value_pair*>& args) {
     check_and(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_and_expressions(const vector<value_pair*>& args) {
+value_ref evaluator::op_and_expressions(const vector<value_pair*>& args) {
     return get_and_expressions(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_or(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_or(const vector<value_pair*>& args) {
     check_or(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_or_expressions(const vector<value_pair*>& args) {
+value_ref evaluator::op_or_expressions(const vector<value_pair*>& args) {
     return get_or_expressions(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_eval(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_eval(const vector<value_pair*>& args) {
     check_eval(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_eval_expression(const vector<value_pair*>& args) {
+value_ref evaluator::op_eval_expression(const vector<value_pair*>& args) {
     return get_eval_expression(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_apply(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_apply(const vector<value_pair*>& args) {
     check_apply(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_apply_operator(const vector<value_pair*>& args) {
+value_ref evaluator::op_apply_operator(const vector<value_pair*>& args) {
     return get_apply_operator(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_apply_arguments(const vector<value_pair*>& args) {
+value_ref evaluator::op_apply_arguments(const vector<value_pair*>& args) {
     return get_apply_arguments(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_check_apply_args(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_apply_args(const vector<value_pair*>& args) {
     check_apply_arguments(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_check_application(const vector<value_pair*>& args) {
+value_ref evaluator::op_check_application(const vector<value_pair*>& args) {
     check_application(args[0]->car());
     return nil;
 }
 
-shared_ptr<value> evaluator::op_no_exps_q(const vector<value_pair*>& args) {
+value_ref evaluator::op_no_exps_q(const vector<value_pair*>& args) {
     return has_no_exps(args[0]->car()) ? true_ : false_;
 }
 
-shared_ptr<value> evaluator::op_last_exp_q(const vector<value_pair*>& args) {
+value_ref evaluator::op_last_exp_q(const vector<value_pair*>& args) {
     return is_last_exp(args[0]->car()) ? true_ : false_;
 }
 
-shared_ptr<value> evaluator::op_first_exp(const vector<value_pair*>& args) {
+value_ref evaluator::op_first_exp(const vector<value_pair*>& args) {
     return get_first_exp(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_rest_exps(const vector<value_pair*>& args) {
+value_ref evaluator::op_rest_exps(const vector<value_pair*>& args) {
     return get_rest_exps(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_operator(const vector<value_pair*>& args) {
+value_ref evaluator::op_operator(const vector<value_pair*>& args) {
     return get_operator(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_operands(const vector<value_pair*>& args) {
+value_ref evaluator::op_operands(const vector<value_pair*>& args) {
     return get_operands(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_no_operands_q(const vector<value_pair*>& args) {
+value_ref evaluator::op_no_operands_q(const vector<value_pair*>& args) {
     return has_no_operands(args[0]->car()) ? true_ : false_;
 }
 
-shared_ptr<value> evaluator::op_last_operand_q(const vector<value_pair*>& args) {
+value_ref evaluator::op_last_operand_q(const vector<value_pair*>& args) {
     return is_last_operand(args[0]->car()) ? true_ : false_;
 }
 
-shared_ptr<value> evaluator::op_first_operand(const vector<value_pair*>& args) {
+value_ref evaluator::op_first_operand(const vector<value_pair*>& args) {
     return get_first_operand(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_rest_operands(const vector<value_pair*>& args) {
+value_ref evaluator::op_rest_operands(const vector<value_pair*>& args) {
     return get_rest_operands(args[0]->car());
 }
 
-shared_ptr<value> evaluator::op_make_empty_arglist(const vector<value_pair*>& args) {
+value_ref evaluator::op_make_empty_arglist(const vector<value_pair*>& args) {
     return make_empty_arglist();
 }
 
-shared_ptr<value> evaluator::op_adjoin_arg(const vector<value_pair*>& args) {
+value_ref evaluator::op_adjoin_arg(const vector<value_pair*>& args) {
     auto arg = args[0]->car();
     auto arg_list = args[1]->car();
     return adjoin_arg(arg, arg_list);
 }
 
-shared_ptr<value> evaluator::op_true_q(const vector<value_pair*>& args) {
-    return (*args[0]->car() ? true_ : false_);
+value_ref evaluator::op_true_q(const vector<value_pair*>& args) {
+    return (args[0]->car().truth() ? true_ : false_);
 }
 
-shared_ptr<value> evaluator::op_false_q(const vector<value_pair*>& args) {
-    return (*args[0]->car() ? false_ : true_);
+value_ref evaluator::op_false_q(const vector<value_pair*>& args) {
+    return (args[0]->car().truth() ? false_ : true_);
 }
 
-shared_ptr<value> evaluator::op_make_true(const vector<value_pair*>& args) {
+value_ref evaluator::op_make_true(const vector<value_pair*>& args) {
     return true_;
 }
 
-shared_ptr<value> evaluator::op_make_false(const vector<value_pair*>& args) {
+value_ref evaluator::op_make_false(const vector<value_pair*>& args) {
     return false_;
 }
 
-shared_ptr<value> evaluator::op_primitive_procedure_q(const vector<value_pair*>& args) {
-    return (args[0]->car()->type() == value_t::primitive_op ? true_ : false_);
+value_ref evaluator::op_primitive_procedure_q(const vector<value_pair*>& args) {
+    return (args[0]->car().type() == value_t::primitive_op ? true_ : false_);
 }
 
-shared_ptr<value> evaluator::op_compound_procedure_q(const vector<value_pair*>& args) {
-    return (args[0]->car()->type() == value_t::compound_op ? true_ : false_);
+value_ref evaluator::op_compound_procedure_q(const vector<value_pair*>& args) {
+    return (args[0]->car().type() == value_t::compound_op ? true_ : false_);
 }
 
-shared_ptr<value> evaluator::op_compiled_procedure_q(const vector<value_pair*>& args) {
-    return (args[0]->car()->type() == value_t::compiled_op ? true_ : false_);
+value_ref evaluator::op_compiled_procedure_q(const vector<value_pair*>& args) {
+    return (args[0]->car().type() == value_t::compiled_op ? true_ : false_);
 }
 
-shared_ptr<value> evaluator::op_compound_parameters(const vector<value_pair*>& args) {
+value_ref evaluator::op_compound_parameters(const vector<value_pair*>& args) {
     return to_ptr<value_compound_op>(args[0]->car())->params();
 }
 
-shared_ptr<value> evaluator::op_compound_body(const vector<value_pair*>& args) {
+value_ref evaluator::op_compound_body(const vector<value_pair*>& args) {
     return to_ptr<value_compound_op>(args[0]->car())->body();
 }
 
-shared_ptr<value> evaluator::op_compound_environment(const vector<value_pair*>& args) {
+value_ref evaluator::op_compound_environment(const vector<value_pair*>& args) {
     return to_ptr<value_compound_op>(args[0]->car())->env();
 }
 
-shared_ptr<value> evaluator::op_make_compound_procedure(const vector<value_pair*>& args) {
+value_ref evaluator::op_make_compound_procedure(const vector<value_pair*>& args) {
     auto params = args[0]->car();
     auto body = args[1]->car();
     auto env = to_sptr<value_environment>(args[2]->car());
 
-    return make_shared<value_compound_op>(params, body, env);
+    return make_ref<value_compound_op>(params, body, env);
+}
+
+value_ref evaluator::op_compiled_entry(const vector<value_pair*>& args) {
+    return to_ptr<value_compiled_op>(args[0]->car())->entry();
+}
+
+value_ref evaluator::op_compiled_environment(const vector<value_pair*>& args) {
+    return to_ptr<value_compiled_op>(args[0]->car())->env();
+}
+
+value_ref evaluator::op_make_compiled_procedure(const vector<value_pair*>& args) {
+    auto params = args[0]->car();
+    auto entry = args[1]->car();
+    auto env = to_sptr<value_environment>(args[2]->car());
+
+    return make_ref<value_compiled_op>(params, entry, env);
 }
 
-shared_ptr<value> evaluator::op_signal_error(const vector<value_pair*>& args) {
+value_ref evaluator::op_signal_error(const vector<value_pair*>& args) {
     static char buffer[65536];
 
     string format_str = to_ptr<value_string>(args[0]->car())->string_();
@@ -271,18 +288,18 @@ shared_ptr<value> evaluator::op_signal_error(const vector<value_pair*>& args) {
 
     if (args.size() == 2) {
         // 1 parameter
-        string v1 = args[1]->car()->str();
+        string v1 = args[1]->car().str();
         snprintf(buffer, sizeof(buffer), format, v1.c_str());
     } else if (args.size() == 3) {
         // 2 parameters
-        string v1 = args[1]->car()->str();
-        string v2 = args[2]->car()->str();
+        string v1 = args[1]->car().str();
+        string v2 = args[2]->car().str();
         snprintf(buffer, sizeof(buffer), format, v1.c_str(), v2.c_str());
     } else if (args.size() == 4) {
         // 3 parameters
-        string v1 = args[1]->car()->str();
-        string v2 = args[2]->car()->str();
-        string v3 = args[3]->car()->str();
+        string v1 = args[1]->car().str();
+        string v2 = args[2]->car().str();
+        string v3 = args[3]->car().str();
         snprintf(buffer, sizeof(buffer), format, v1.c_str(), v2.c_str(), v3.c_str());
     } else {
         // 0 or 3+ parameters: use the format only
@@ -292,149 +309,401 @@ shared_ptr<value> evaluator::op_signal_error(const vector<value_pair*>& args) {
     return make_error(buffer);
 }
 
-shared_ptr<value> evaluator::op_apply_primitive_procedure(const vector<value_pair*>& args) {
+value_ref evaluator::op_apply_primitive_procedure(const vector<value_pair*>& args) {
+    if (args[0]->car().type() != value_t::primitive_op) {
+        return make_error("can't apply %s", args[0]->car().str().c_str());
+    }
+
     auto procedure = to_ptr<value_primitive_op>(args[0]->car());
     auto arguments = to_ptr<const value_pair>(args[1]->car());
 
     auto result = procedure->op()(arguments);
-    if (result->type() == value_t::error) {
+    if (result.type() == value_t::error) {
         auto error = to_ptr<value_error>(result);
         error->topic("error applying " + procedure->name());
     }
     return result;
 }
 
-shared_ptr<value> evaluator::op_lookup_variable_value(const vector<value_pair*>& args) {
-    auto name = to_ptr<value_symbol>(args[0]->car());
+value_ref evaluator::op_lookup_variable_value(const vector<value_pair*>& args) {
+    auto variable = args[0]->car();
     auto env = to_ptr<value_environment>(args[1]->car());
 
-    if (auto val = env->lookup(name->symbol())) {
+    if (variable.type() == value_t::address) {
+        auto address = to_ptr<value_address>(variable);
+        if (auto val = env->lookup(*address)) {
+            return val;
+        } else {
+            return make_error("%s is unbound", address->name()->symbol().c_str());
+        }
+    }
+
+    auto name = to_ptr<value_symbol>(variable);
+    if (auto val = env->lookup(name)) {
         return val;
     } else {
         return make_error("%s is unbound", name->symbol().c_str());
     }
 }
 
-shared_ptr<value> evaluator::op_set_variable_value(const vector<value_pair*>& args) {
+value_ref evaluator::op_set_variable_value(const vector<value_pair*>& args) {
     auto name = to_ptr<value_symbol>(args[0]->car());
     auto val = args[1]->car();
     auto env = to_ptr<value_environment>(args[2]->car());
 
-    if (env->update(name->symbol(), val)) {
+    if (env->update(name, val)) {
         return nil;
     } else {
         return make_error("%s is unbound", name->symbol().c_str());
     }
 }
 
-shared_ptr<value> evaluator::op_define_variable(const vector<value_pair*>& args) {
+value_ref evaluator::op_define_variable(const vector<value_pair*>& args) {
     auto name = to_ptr<value_symbol>(args[0]->car());
     auto val = args[1]->car();
     auto env = to_ptr<value_environment>(args[2]->car());
 
-    if (env->update(name->symbol(), val, false)) {
+    if (env->update(name, val, false)) {
         return make_info("%s is updated", name->symbol().c_str());
     } else {
-        env->add(name->symbol(), val);
+        env->add(name, val);
         return make_info("%s is defined", name->symbol().c_str());
     }
 }
 
-shared_ptr<value> evaluator::op_extend_environment(const vector<value_pair*>& args) {
+value_ref evaluator::op_extend_environment(const vector<value_pair*>& args) {
     auto parameters = args[0]->car();
     auto arguments = args[1]->car();
     auto base_env = to_sptr<value_environment>(args[2]->car());
 
-    auto param = parameters;
-    auto arg = arguments;
-    while (param != nil) {
-        if (param->type() == value_t::symbol) {
-            // params are terminated by a symbol cdr:
-            // it should bind the remaining args
-            param = nil;
-            arg = nil;
-            break;
-        } else if (arg == nil) {
-            // no more args
-            break;
-        } else {
-            param = to_ptr<value_pair>(param)->cdr();
-            arg = to_ptr<value_pair>(arg)->cdr();
-        }
+    // the slots are filled in the order of the params
+    vector<value_ref> slots;
+
+    const value_ref* param = &parameters;
+    const value_ref* arg = &arguments;
+    while (param->type() == value_t::pair && arg->type() == value_t::pair) {
+        // bind the next param to the next arg
+        slots.push_back(to_ptr<value_pair>(*arg)->car());
+        param = &to_ptr<value_pair>(*param)->cdr();
+        arg = &to_ptr<value_pair>(*arg)->cdr();
     }
 
-    if (param != nil || arg != nil) {
+    if (param->type() == value_t::symbol) {
+        // the rest of the args are bound to z in (x y . z)
+        slots.push_back(*arg);
+    } else if (*param != nil || *arg != nil) {
         return make_error(
             "the arguments %s don't match the parameters %s",
-            arguments->str().c_str(), parameters->str().c_str());
-    }
-
-    shared_ptr<value_environment> env = make_shared<value_environment>(base_env);
-
-    while (parameters != nil) {
-        if (parameters->type() == value_t::symbol) {
-            // the rest of the args are bound to z in (x y . z)
-            auto name = to_ptr<value_symbol>(parameters)->symbol();
-            env->add(name, arguments);
-            break;
-        } else {
-            // bind the param name to the next arg
-            auto next_name = to_ptr<value_pair>(parameters)->car();
-            auto next_val = to_ptr<value_pair>(arguments)->car();
-            auto name = to_ptr<value_symbol>(next_name)->symbol();
-            env->add(name, next_val);
-        }
-        parameters = to_ptr<value_pair>(parameters)->cdr();
-        arguments = to_ptr<value_pair>(arguments)->cdr();
+            arguments.str().c_str(), parameters.str().c_str());
     }
 
-    return env;
+    return make_ref<value_environment>(base_env, parameters, std::move(slots));
 }
 
-shared_ptr<value> evaluator::op_dispatch_table_ready_q(const vector<value_pair*>& args) {
-    return (args[0]->car()->type() == value_t::environment ? true_ : false_);
+value_ref evaluator::op_dispatch_table_ready_q(const vector<value_pair*>& args) {
+    return (args[0]->car().type() == value_t::dispatch_table ? true_ : false_);
 }
 
-shared_ptr<value> evaluator::op_make_dispatch_table(const vector<value_pair*>& args) {
-    return make_shared<value_environment>();
+value_ref evaluator::op_make_dispatch_table(const vector<value_pair*>& args) {
+    return make_ref<value_dispatch_table>();
 }
 
-shared_ptr<value> evaluator::op_add_dispatch_record(const vector<value_pair*>& args) {
-    auto dispatch = to_ptr<value_environment>(args[0]->car());
+value_ref evaluator::op_add_dispatch_record(const vector<value_pair*>& args) {
+    auto dispatch = to_ptr<value_dispatch_table>(args[0]->car());
     auto name = to_ptr<value_string>(args[1]->car())->string_();
     auto code = args[2]->car();  // position of the label
 
-    dispatch->add(name, code);
+    dispatch->add(make_symbol(name).get(), code);
 
     return args[0]->car();  // dispatch
 }
 
-shared_ptr<value> evaluator::op_dispatch_on_type(const vector<value_pair*>& args) {
-    auto exp = args[0]->car();
-    auto dispatch = to_ptr<value_environment>(args[1]->car());
-
-    shared_ptr<value> code = nullptr;
-    if (is_self_evaluating(exp)) {
-        // self-evaluating expression
-        code = dispatch->lookup("self", false);
-    } else if (is_variable(exp)) {
-        // named variable
-        code = dispatch->lookup("var", false);
-    } else if (exp->type() == value_t::pair &&
-               to_ptr<value_pair>(exp)->car()->type() == value_t::symbol) {
-        // maybe special form (list starting with a symbol)
-        auto symbol = to_ptr<value_symbol>(to_ptr<value_pair>(exp)->car())->symbol();
-        code = dispatch->lookup(symbol, false);
+value_ref evaluator::op_dispatch_on_type(const vector<value_pair*>& args) {
+    static const value_symbol* self = make_symbol("self").get();
+    static const value_symbol* var = make_symbol("var").get();
+    static const value_symbol* default_ = make_symbol("default").get();
+
+    const value_ref& exp = args[0]->car();
+    auto dispatch = static_cast<const value_dispatch_table*>(args[1]->car().get());
+
+    const value_symbol* name = default_;
+    switch (exp.type()) {
+        case value_t::nil:
+        case value_t::number:
+        case value_t::string:
+        case value_t::bool_:
+        case value_t::primitive_op:
+            // self-evaluating expression
+            name = self;
+            break;
+        case value_t::symbol:
+        case value_t::address:
+            // named or addressed variable
+            name = var;
+            break;
+        case value_t::pair: {
+            // maybe special form (list starting with a symbol)
+            const value_ref& first = to_ptr<value_pair>(exp)->car();
+            if (first.type() == value_t::symbol) {
+                name = to_ptr<value_symbol>(first);
+            }
+            break;
+        }
+        default:
+            break;
     }
 
+    const value_ref& code = dispatch->lookup(name);
     if (!code) {
         // default dispatch (application)
-        code = dispatch->lookup("default", 0);
+        return dispatch->lookup(default_);
     }
 
     return code;
 }
 
+value_ref evaluator::op_cons(const vector<value_pair*>& args) {
+    return make_vpair(args[0]->car(), args[1]->car());
+}
+
+// lexical addressing
+
+namespace {
+
+bool has_eval(const value_ref& exp) {
+    // conservatively: an eval anywhere, even quoted
+    if (is_eval(exp)) {
+        return true;
+    }
+    for (const value_ref* v = &exp; v->type() == value_t::pair;) {
+        auto pair = to_ptr<value_pair>(*v);
+        if (has_eval(pair->car())) {
+            return true;
+        }
+        v = &pair->cdr();
+    }
+
+    return false;
+}
+
+bool is_else(const value_ref& exp) {
+    return (exp.type() == value_t::symbol &&
+            to_ptr<value_symbol>(exp)->symbol() == "else");
+}
+
+template <typename F>
+value_ref map_list(const value_ref& list, F fn) {
+    // (fn(e1) fn(e2) ...) from (e1 e2 ...)
+    ref_ptr<value_pair> head;
+    ref_ptr<value_pair> tail;
+    for (const value_pair* p = to_ptr<value_pair>(list); p != nilptr; p = p->pcdr()) {
+        auto next = make_vpair(fn(p->car()), nil);
+        if (!tail) {
+            head = next;
+        } else {
+            tail->cdr(next, false);
+        }
+        tail = next;
+    }
+
+    return (head ? value_ref(head) : value_ref(nil));
+}
+
+}  // namespace
+
+value_ref evaluator::_address(const value_ref& exp, vector<lexical_scope>& scopes) {
+    if (exp.type() == value_t::symbol) {
+        // top-level variables stay named
+        return (scopes.empty() ? exp : _resolve(exp, scopes));
+    } else if (exp.type() != value_t::pair) {
+        return exp;
+    }
+
+    // malformed forms are left as they are:
+    // their evaluation reports the syntax error
+    try {
+        auto head = to_ptr<value_pair>(exp)->car();
+        auto rest = to_ptr<value_pair>(exp)->cdr();
+
+        if (is_quoted(exp)) {
+            return exp;
+        } else if (is_assignment(exp)) {
+            // (set! x v): x stays named
+            check_assignment(exp);
+            return make_list(
+                head,
+                get_assignment_variable(exp),
+                _address(get_assignment_value(exp), scopes));
+        } else if (is_definition(exp)) {
+            check_definition(exp);
+            auto target = to_ptr<value_pair>(rest)->car();
+            if (target.type() == value_t::symbol) {
+                // (define x v): x stays named
+                return make_list(
+                    head,
+                    target,
+                    _address(get_definition_value(exp), scopes));
+            } else {
+                // (define (f . params) body ...)
+                auto params = to_ptr<value_pair>(target)->cdr();
+                auto body = to_ptr<value_pair>(rest)->cdr();
+                return make_vpair(head, make_vpair(target, _address_body(params, body, scopes)));
+            }
+        } else if (is_lambda(exp)) {
+            check_lambda(exp);
+            auto params = get_lambda_parameters(exp);
+            auto body = get_lambda_body(exp);
+            return make_vpair(head, make_vpair(params, _address_body(params, body, scopes)));
+        } else if (is_let(exp)) {
+            check_let(exp);
+            auto variables = to_ptr<value_pair>(rest)->car();
+            auto body = to_ptr<value_pair>(rest)->cdr();
+            if (variables == nil) {
+                // no variables, no frame: a sequence
+                return make_vpair(head, make_vpair(variables, _address_list(body, scopes)));
+            }
+            // the values are evaluated outside the let's frame
+            auto params = map_list(variables, [](const value_ref& variable) {
+                return to_ptr<value_pair>(variable)->car();
+            });
+            auto bindings = map_list(variables, [&scopes](const value_ref& variable) {
+                auto pair = to_ptr<value_pair>(variable);
+                return make_list(pair->car(), _address(pair->pcdr()->car(), scopes));
+            });
+            return make_vpair(head, make_vpair(bindings, _address_body(params, body, scopes)));
+        } else if (is_cond(exp)) {
+            check_cond(exp);
+            return make_vpair(head, map_list(rest, [&scopes](const value_ref& clause) -> value_ref {
+                auto clause_list = to_ptr<value_pair>(clause);
+                if (is_else(clause_list->car())) {
+                    return make_vpair(clause_list->car(), _address_list(clause_list->cdr(), scopes));
+                } else {
+                    return _address_list(clause, scopes);
+                }
+            }));
+        } else if (is_if(exp) || is_begin(exp) || is_and(exp) || is_or(exp) || is_apply(exp)) {
+            return make_vpair(head, _address_list(rest, scopes));
+        } else {
+            // application
+            return _address_list(exp, scopes);
+        }
+    } catch (syntax_error&) {
+        return exp;
+    }
+}
+
+value_ref evaluator::_address_list(const value_ref& list, vector<lexical_scope>& scopes) {
+    if (list.type() != value_t::pair || !to_ptr<value_pair>(list)->is_list()) {
+        return list;
+    }
+
+    return map_list(list, [&scopes](const value_ref& exp) {
+        return _address(exp, scopes);
+    });
+}
+
+value_ref evaluator::_address_body(const value_ref& params, const value_ref& body, vector<lexical_scope>& scopes) {
+    // the frame's slots: params, then the defines
+    lexical_scope scope;
+    const value_ref* param = &params;
+    while (param->type() == value_t::pair) {
+        // a non-symbol (malformed) param keeps its
+        // slot, but no name resolves to it
+        const value_ref& name = to_ptr<value_pair>(*param)->car();
+        scope.params.push_back(name.type() == value_t::symbol ? to_ptr<value_symbol>(name) : nullptr);
+        param = &to_ptr<value_pair>(*param)->cdr();
+    }
+    if (param->type() == value_t::symbol) {
+        // (x y . z)
+        scope.params.push_back(to_ptr<value_symbol>(*param));
+    }
+    _scan_defines(body, scope.defines);
+
+    scopes.push_back(std::move(scope));
+    auto result = _address_list(body, scopes);
+    scopes.pop_back();
+
+    return result;
+}
+
+value_ref evaluator::_resolve(const value_ref& symbol, const vector<lexical_scope>& scopes) {
+    auto name = to_ptr<value_symbol>(symbol);
+    auto handle = to_sptr<value_symbol>(symbol);
+
+    for (size_t depth = 0; depth < scopes.size(); ++depth) {
+        const auto& scope = scopes[scopes.size() - 1 - depth];
+        for (size_t index = 0; index < scope.params.size(); ++index) {
+            if (scope.params[index] == name) {
+                return make_ref<value_address>(handle, depth, index);
+            }
+        }
+        for (const auto& define : scope.defines) {
+            if (define == name) {
+                return make_ref<value_address>(handle, depth, value_address::no_index);
+            }
+        }
+    }
+
+    // free in all scopes
+    return make_ref<value_address>(handle, value_address::global, value_address::no_index);
+}
+
+void evaluator::_scan_defines(const value_ref& exp, vector<const value_symbol*>& defines) {
+    // the names that a (body) expression defines in its own frame
+    if (exp.type() != value_t::pair || is_quoted(exp) || is_lambda(exp)) {
+        return;
+    }
+
+    try {
+        if (is_definition(exp)) {
+            check_definition(exp);
+            auto name = to_ptr<value_symbol>(get_definition_variable(exp));
+            if (std::find(defines.begin(), defines.end(), name) == defines.end()) {
+                defines.push_back(name);
+            }
+            if (to_ptr<value_pair>(exp)->pcdr()->car().type() == value_t::symbol) {
+                _scan_defines(get_definition_value(exp), defines);
+            }
+            return;
+        } else if (is_let(exp)) {
+            check_let(exp);
+            auto variables = to_ptr<value_pair>(exp)->pcdr()->car();
+            for (const value_pair* p = to_ptr<value_pair>(variables); p != nilptr; p = p->pcdr()) {
+                _scan_defines(p->pcar()->pcdr()->car(), defines);
+            }
+            if (variables == nil) {
+                // no frame: defines in this one
+                _scan_defines(to_ptr<value_pair>(exp)->pcdr()->cdr(), defines);
+            }
+            return;
+        }
+    } catch (syntax_error&) {
+        return;
+    }
+
+    // any other form or a list of expressions
+    for (const value_ref* v = &exp; v->type() == value_t::pair;) {
+        auto pair = to_ptr<value_pair>(*v);
+        _scan_defines(pair->car(), defines);
+        v = &pair->cdr();
+    }
+}
+
+value_ref evaluator::evaluate(const value_ref& expression) {
+    allocator_scope scope{*_allocator};
+    syntax_cache::scope syntax_scope{_syntax};
+
+    // the code evaluated by eval may add frame
+    // variables that the addressing can't see
+    value_ref exp = expression;
+    if (!has_eval(expression)) {
+        vector<lexical_scope> scopes;
+        exp = _address(expression, scopes);
+    }
+
+    return _machine.run({{"exp", exp}, {"env", _global}}, "val");
+}
+
 // evaluator
 
 void evaluator::_bind_machine_ops(machine& m) {
@@ -512,6 +781,10 @@ void evaluator::_bind_machine_ops(machine& m) {
     m.bind_op("compound-environment", evaluator::op_compound_environment);
     m.bind_op("make-compound-procedure", evaluator::op_make_compound_procedure);
 
+    m.bind_op("compiled-entry", evaluator::op_compiled_entry);
+    m.bind_op("compiled-environment", evaluator::op_compiled_environment);
+    m.bind_op("make-compiled-procedure", evaluator::op_make_compiled_procedure);
+
     m.bind_op("signal-error", evaluator::op_signal_error);
 
     m.bind_op("apply-primitive-procedure", evaluator::op_apply_primitive_procedure);
@@ -525,24 +798,30 @@ void evaluator::_bind_machine_ops(machine& m) {
     m.bind_op("make-dispatch-table", evaluator::op_make_dispatch_table);
     m.bind_op("add-dispatch-record", evaluator::op_add_dispatch_record);
     m.bind_op("dispatch-on-type", evaluator::op_dispatch_on_type);
+
+    m.bind_op("cons", evaluator::op_cons);
 }
 
-machine evaluator::_make_machine(path path_to_code) {
+machine evaluator::_make_machine(path path_to_code, machine_engine engine) {
+    allocator_scope scope{*_allocator};
+
     auto source = parse_values_from(path_to_code);
     auto code = translate_to_code(source);
-    machine m{code};
+    machine m{code, engine};
 
     _bind_machine_ops(m);
 
     return m;
 }
 
-shared_ptr<evaluator::value_environment> evaluator::_make_global() {
-    shared_ptr<value_environment> env = make_shared<value_environment>();
+ref_ptr<evaluator::value_environment> evaluator::_make_global() {
+    allocator_scope scope{*_allocator};
+
+    ref_ptr<value_environment> env = make_ref<value_environment>();
 
     for (const auto& prim : get_primitives()) {
-        auto val = make_shared<value_primitive_op>(prim.first, prim.second);
-        env->add(prim.first, val);
+        auto val = make_ref<value_primitive_op>(prim.first, prim.second);
+        env->add(make_symbol(prim.first).get(), val);
     }
 
     return env;
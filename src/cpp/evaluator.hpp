@@ -1,43 +1,56 @@
 #ifndef EVALUATOR_H_
 #define EVALUATOR_H_
 
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "allocator.hpp"
+#include "gc.hpp"
 #include "machine.hpp"
 #include "primitives.hpp"
 #include "value.hpp"
 
-using std::shared_ptr;
+using std::make_unique;
 using std::string;
+using std::unique_ptr;
 using std::unordered_map;
+using std::vector;
 using std::filesystem::path;
 
+#define SYNTAX_CACHE_SIZE 4096  // special forms memoized at most
+
 class evaluator {
    public:
-    evaluator(path path_to_code)
-        : _global(_make_global()),
-          _machine(_make_machine(path_to_code)) {
+    evaluator(
+        path path_to_code,
+        machine_engine engine = machine_engine::threaded,
+        size_t spare_slabs = SLAB_SPARE_SLABS,
+        size_t gc_threshold = GC_THRESHOLD)
+        : _allocator(make_unique<slab_allocator>(spare_slabs)),
+          _collector(make_unique<garbage_collector>(*_allocator, gc_threshold)),
+          _global(_make_global()),
+          _machine(_make_machine(path_to_code, engine)) {
         _machine.write_to("env", _global);
+        _machine.collector(_collector.get());
+        _collector->roots([this](value_tracer& tracer) {
+            tracer(_global);
+            _machine.trace_roots(tracer);
+        });
     }
 
-    ~evaluator() {
-        _global->clear();
-    }
-
-    // can't copy, can move
+    // can't copy or move: the roots are traced in place
     evaluator(const evaluator&) = delete;
     void operator=(evaluator const&) = delete;
-    evaluator(evaluator&&) = default;
-    evaluator& operator=(evaluator&&) = default;
+    evaluator(evaluator&&) = delete;
+    evaluator& operator=(evaluator&&) = delete;
 
-    shared_ptr<value> evaluate(const shared_ptr<value>& expression) {
-        return _machine.run({{"exp", expression}, {"env", _global}}, "val");
-    }
+    value_ref evaluate(const value_ref& expression);
 
-    const unordered_map<string, shared_ptr<value>>& global() const {
+    const unordered_map<string, value_ref>& global() const {
         return _global->values();
     }
 
@@ -49,64 +62,201 @@ class evaluator {
         _machine.trace(trace);
     }
 
+    // the values made by the evaluator
+    const slab_allocator& allocator() const {
+        return *_allocator;
+    }
+
+    void collect() {
+        allocator_scope scope{*_allocator};
+        _collector->collect();
+    }
+
+    const gc_stats& collector_stats() const {
+        return _collector->stats();
+    }
+
    private:
+    // a variable reference resolved by the lexical addressing:
+    // the frame depth and the slot index within the frame (no
+    // index if defined in the body); global if free everywhere
+    class value_address : public value {
+       public:
+        static constexpr size_t global = SIZE_MAX;
+        static constexpr size_t no_index = SIZE_MAX;
+
+        value_address(const ref_ptr<value_symbol>& name, size_t depth, size_t index)
+            : value(value_t::address), _name(name), _depth(depth), _index(index) {}
+
+        ostream& write(ostream& os) const override {
+            return (os << *_name);
+        }
+
+        const value_symbol* name() const { return _name.get(); }
+        size_t depth() const { return _depth; }
+        size_t index() const { return _index; }
+
+       private:
+        ref_ptr<value_symbol> _name;
+        size_t _depth;
+        size_t _index;
+    };
+
+    // the global environment is a hash map by name; the
+    // frames hold a flat array of slots: the arguments in
+    // the order of the parameters, then the values defined
+    // in the body in the order of definition
+
     class value_environment : public value {
        public:
-        value_environment() : value(value_t::environment) {}
-        value_environment(shared_ptr<value_environment> base)
-            : value(value_t::environment), _base(base) {}
+        value_environment()
+            : value(value_t::environment),
+              _values(make_unique<unordered_map<string, value_ref>>()) {}
+        value_environment(
+            const ref_ptr<value_environment>& base,
+            const value_ref& params,
+            vector<value_ref>&& slots)
+            : value(value_t::environment), _base(base), _params(params), _slots(std::move(slots)) {}
 
         ostream& write(ostream& os) const override {
             if (!_base) {
                 return (os << "<global>");
             } else {
                 os << "<env";
-                for (const auto& [name, val] : _values) {
-                    os << " " << name << "=" << *val;
+                size_t i = 0;
+                const value* param = _params.get();
+                for (; param->type() == value_t::pair; ++i) {
+                    auto pair = static_cast<const value_pair*>(param);
+                    os << " " << pair->car() << "=" << _slots[i];
+                    param = pair->cdr().get();
+                }
+                if (param->type() == value_t::symbol) {
+                    os << " " << *param << "=" << _slots[i++];
+                }
+                for (const auto& name : _names) {
+                    os << " " << *name << "=" << _slots[i++];
                 }
                 os << ">";
                 return os;
             }
         }
 
-        shared_ptr<value> lookup(const string& name, bool recursive = true) const {
-            auto iter = _values.find(name);
-            if (iter != _values.end()) {
-                return iter->second;
-            } else if (recursive && _base) {
-                return _base->lookup(name, recursive);  // TCO
+        value_ref lookup(const value_symbol* name, bool recursive = true) const {
+            const value_environment* env = this;
+            do {
+                if (const value_ref* slot = env->_find(name)) {
+                    return *slot;
+                }
+                env = env->_base.get();
+            } while (recursive && env != nullptr);
+
+            return nullptr;
+        }
+
+        value_ref lookup(const value_address& address) const {
+            const value_environment* env = this;
+            if (address.depth() == value_address::global) {
+                while (env->_base) {
+                    env = env->_base.get();
+                }
+                return env->lookup(address.name(), false);
+            }
+            for (size_t depth = address.depth(); depth > 0; --depth) {
+                env = env->_base.get();
+            }
+            if (address.index() != value_address::no_index) {
+                return env->_slots[address.index()];
             } else {
-                return nullptr;
+                // defined in the body: maybe not yet
+                return env->lookup(address.name());
             }
         }
 
-        bool update(const string& name, const shared_ptr<value>& val, bool recursive = true) {
-            auto iter = _values.find(name);
-            if (iter != _values.end()) {
-                _values[name] = val;
-                return true;
-            } else if (recursive && _base) {
-                return _base->update(name, val, recursive);  // TCO
+        bool update(const value_symbol* name, const value_ref& val, bool recursive = true) {
+            value_environment* env = this;
+            do {
+                if (value_ref* slot = env->_find(name)) {
+                    *slot = val;
+                    return true;
+                }
+                env = env->_base.get();
+            } while (recursive && env != nullptr);
+
+            return false;
+        }
+
+        void add(const value_symbol* name, const value_ref& val) {
+            if (_values) {
+                (*_values)[name->symbol()] = val;
             } else {
-                return false;
+                _names.push_back(name);
+                _slots.push_back(val);
             }
         }
 
-        void add(const string& name, const shared_ptr<value>& val) {
-            _values[name] = val;
+        const unordered_map<string, value_ref>& values() {
+            return *_values;
         }
 
-        const unordered_map<string, shared_ptr<value>>& values() {
-            return _values;
+       protected:
+        void _trace(value_tracer& tracer) const override {
+            if (_values) {
+                for (const auto& [_, val] : *_values) tracer(val);
+            }
+            for (const auto& val : _slots) tracer(val);
+            tracer(_params);
+            tracer(_base);
         }
 
-        void clear() {
-            _values.clear();
+        void _clear() override {
+            if (_values) {
+                _values->clear();
+            }
+            _slots.clear();
+            _params.reset();
+            _base.reset();
         }
 
        private:
-        unordered_map<string, shared_ptr<value>> _values;
-        shared_ptr<value_environment> _base{nullptr};
+        const value_ref* _find(const value_symbol* name) const {
+            if (_values) {
+                auto iter = _values->find(name->symbol());
+                return (iter != _values->end() ? &iter->second : nullptr);
+            }
+
+            // the symbols are interned: compare the pointers
+            size_t i = 0;
+            const value* param = _params.get();
+            for (; param->type() == value_t::pair; ++i) {
+                auto pair = static_cast<const value_pair*>(param);
+                if (pair->car().get() == name) {
+                    return &_slots[i];
+                }
+                param = pair->cdr().get();
+            }
+            if (param == name) {
+                return &_slots[i];  // (x y . z)
+            } else if (param->type() == value_t::symbol) {
+                ++i;
+            }
+            for (size_t j = 0; j < _names.size(); ++j) {
+                if (_names[j] == name) {
+                    return &_slots[i + j];
+                }
+            }
+
+            return nullptr;
+        }
+
+        value_ref* _find(const value_symbol* name) {
+            return const_cast<value_ref*>(static_cast<const value_environment*>(this)->_find(name));
+        }
+
+        ref_ptr<value_environment> _base{nullptr};
+        value_ref _params{nil};
+        vector<value_ref> _slots;
+        vector<const value_symbol*> _names;                     // defined in the frame
+        unique_ptr<unordered_map<string, value_ref>> _values;  // global only
     };
 
     class value_primitive_op : public value {
@@ -129,9 +279,9 @@ class evaluator {
     class value_compound_op : public value {
        public:
         value_compound_op(
-            const shared_ptr<value>& params,
-            const shared_ptr<value>& body,
-            const shared_ptr<value_environment>& env)
+            const value_ref& params,
+            const value_ref& body,
+            const ref_ptr<value_environment>& env)
             : value(value_t::compound_op), _params(params), _body(body), _env(env) {}
 
         ostream& write(ostream& os) const override {
@@ -140,88 +290,289 @@ class evaluator {
             return (os << "(lambda " << *_params << " " << body << ")");
         };
 
-        const shared_ptr<value>& params() const { return _params; }
-        const shared_ptr<value>& body() const { return _body; }
-        const shared_ptr<value_environment>& env() const { return _env; }
+        const value_ref& params() const { return _params; }
+        const value_ref& body() const { return _body; }
+        const ref_ptr<value_environment>& env() const { return _env; }
+
+       protected:
+        void _trace(value_tracer& tracer) const override {
+            tracer(_params);
+            tracer(_body);
+            tracer(_env);
+        }
+
+        void _clear() override {
+            _params.reset();
+            _body.reset();
+            _env.reset();
+        }
+
+       private:
+        value_ref _params;
+        value_ref _body;
+        ref_ptr<value_environment> _env;
+    };
+
+    class value_compiled_op : public value {
+       public:
+        value_compiled_op(
+            const value_ref& params,
+            const value_ref& entry,
+            const ref_ptr<value_environment>& env)
+            : value(value_t::compiled_op), _params(params), _entry(entry), _env(env) {}
+
+        ostream& write(ostream& os) const override {
+            return (os << "<compiled " << *_params << ">");
+        };
+
+        const value_ref& params() const { return _params; }
+        const value_ref& entry() const { return _entry; }
+        const ref_ptr<value_environment>& env() const { return _env; }
+
+       protected:
+        void _trace(value_tracer& tracer) const override {
+            tracer(_params);
+            tracer(_entry);
+            tracer(_env);
+        }
+
+        void _clear() override {
+            _params.reset();
+            _entry.reset();
+            _env.reset();
+        }
+
+       private:
+        value_ref _params;
+        value_ref _entry;  // position of the code
+        ref_ptr<value_environment> _env;
+    };
+
+    // the labels of the special forms indexed by the
+    // id of the form's symbol: a missing entry means
+    // the default dispatch (application)
+
+    class value_dispatch_table : public value {
+       public:
+        value_dispatch_table() : value(value_t::dispatch_table) {}
+
+        ostream& write(ostream& os) const override {
+            return (os << "<dispatch table>");
+        }
+
+        const value_ref& lookup(const value_symbol* name) const {
+            static const value_ref missing;
+            return (name->id() < _codes.size() ? _codes[name->id()] : missing);
+        }
+
+        void add(const value_symbol* name, const value_ref& code) {
+            if (name->id() >= _codes.size()) {
+                _codes.resize(name->id() + 1);
+            }
+            _codes[name->id()] = code;
+        }
+
+       protected:
+        void _trace(value_tracer& tracer) const override {
+            for (const auto& code : _codes) tracer(code);
+        }
+
+        void _clear() override {
+            _codes.clear();
+        }
+
+       private:
+        vector<value_ref> _codes;
+    };
+
+    // the collector only sees the values in the slabs
+    static_assert(sizeof(value_address) <= SLAB_MAX_CELL_SIZE, "address is too large");
+    static_assert(sizeof(value_environment) <= SLAB_MAX_CELL_SIZE, "environment is too large");
+    static_assert(sizeof(value_compound_op) <= SLAB_MAX_CELL_SIZE, "compound op is too large");
+    static_assert(sizeof(value_compiled_op) <= SLAB_MAX_CELL_SIZE, "compiled op is too large");
+    static_assert(sizeof(value_dispatch_table) <= SLAB_MAX_CELL_SIZE, "dispatch table is too large");
+
+    // the special forms checked and transformed so far, by the
+    // identity of the source pair. an entry holds its source, so
+    // the address can't be reused by another pair. the pairs read
+    // by the checks and transformations are marked: all entries
+    // are dropped once any of them is mutated (or too many)
+
+    class syntax_cache {
+       public:
+        // installs a cache for the ops run by the current
+        // thread for the lifetime of the scope
+        class scope {
+           public:
+            scope(syntax_cache& cache) : _previous(_current) { _current = &cache; }
+            ~scope() { _current = _previous; }
+
+            scope(const scope&) = delete;
+            void operator=(scope const&) = delete;
+
+           private:
+            syntax_cache* _previous;
+        };
+
+        // check(exp) unless checked before
+        template <typename F>
+        static void check(const value_ref& exp, F check) {
+            if (_current == nullptr) {
+                check(exp);
+            } else if (entry& e = _current->_get(exp); !e.checked) {
+                check(exp);
+                e.checked = true;
+            }
+        }
+
+        // transform(exp) unless transformed before
+        template <typename F>
+        static value_ref transform(const value_ref& exp, F transform) {
+            if (_current == nullptr) {
+                return transform(exp);
+            } else if (entry& e = _current->_get(exp); !e.transformed) {
+                e.transformed = transform(exp);
+                return e.transformed;
+            } else {
+                return e.transformed;
+            }
+        }
 
        private:
-        shared_ptr<value> _params;
-        shared_ptr<value> _body;
-        shared_ptr<value_environment> _env;
+        struct entry {
+            value_ref source;
+            value_ref transformed;
+            bool checked{false};
+        };
+
+        entry& _get(const value_ref& exp) {
+            if (_mutations != value_pair::mutations() || _entries.size() >= SYNTAX_CACHE_SIZE) {
+                _entries.clear();
+                _mutations = value_pair::mutations();
+            }
+
+            entry& e = _entries[exp.get()];
+            if (!e.source) {
+                e.source = exp;
+                _mark(exp, 3);
+            }
+
+            return e;
+        }
+
+        // the spines of the form, its parts, and their
+        // parts (e.g., a let's bindings) up to the depth
+        static void _mark(const value_ref& exp, size_t depth) {
+            for (const value_ref* v = &exp; v->type() == value_t::pair;) {
+                auto pair = to_ptr<value_pair>(*v);
+                pair->mark_syntax();
+                if (depth > 1) {
+                    _mark(pair->car(), depth - 1);
+                }
+                v = &pair->cdr();
+            }
+        }
+
+        unordered_map<const value*, entry> _entries;
+        size_t _mutations{value_pair::mutations()};
+
+        static thread_local syntax_cache* _current;
+    };
+
+    static value_ref op_check_quoted(const vector<value_pair*>& args);
+    static value_ref op_text_of_quotation(const vector<value_pair*>& args);
+    static value_ref op_check_assignment(const vector<value_pair*>& args);
+    static value_ref op_assignment_variable(const vector<value_pair*>& args);
+    static value_ref op_assignment_value(const vector<value_pair*>& args);
+    static value_ref op_check_definition(const vector<value_pair*>& args);
+    static value_ref op_definition_variable(const vector<value_pair*>& args);
+    static value_ref op_definition_value(const vector<value_pair*>& args);
+    static value_ref op_check_if(const vector<value_pair*>& args);
+    static value_ref op_if_predicate(const vector<value_pair*>& args);
+    static value_ref op_if_consequent(const vector<value_pair*>& args);
+    static value_ref op_if_alternative(const vector<value_pair*>& args);
+    static value_ref op_check_lambda(const vector<value_pair*>& args);
+    static value_ref op_lambda_parameters(const vector<value_pair*>& args);
+    static value_ref op_lambda_body(const vector<value_pair*>& args);
+    static value_ref op_check_let(const vector<value_pair*>& args);
+    static value_ref op_transform_let(const vector<value_pair*>& args);
+    static value_ref op_check_begin(const vector<value_pair*>& args);
+    static value_ref op_begin_actions(const vector<value_pair*>& args);
+    static value_ref op_check_cond(const vector<value_pair*>& args);
+    static value_ref op_transform_cond(const vector<value_pair*>& args);
+    static value_ref op_check_and(const vector<value_pair*>& args);
+    static value_ref op_and_expressions(const vector<value_pair*>& args);
+    static value_ref op_check_or(const vector<value_pair*>& args);
+    static value_ref op_or_expressions(const vector<value_pair*>& args);
+    static value_ref op_check_eval(const vector<value_pair*>& args);
+    static value_ref op_eval_expression(const vector<value_pair*>& args);
+    static value_ref op_check_apply(const vector<value_pair*>& args);
+    static value_ref op_apply_operator(const vector<value_pair*>& args);
+    static value_ref op_apply_arguments(const vector<value_pair*>& args);
+    static value_ref op_check_apply_args(const vector<value_pair*>& args);
+    static value_ref op_check_application(const vector<value_pair*>& args);
+    static value_ref op_no_exps_q(const vector<value_pair*>& args);
+    static value_ref op_last_exp_q(const vector<value_pair*>& args);
+    static value_ref op_first_exp(const vector<value_pair*>& args);
+    static value_ref op_rest_exps(const vector<value_pair*>& args);
+    static value_ref op_operator(const vector<value_pair*>& args);
+    static value_ref op_operands(const vector<value_pair*>& args);
+    static value_ref op_no_operands_q(const vector<value_pair*>& args);
+    static value_ref op_last_operand_q(const vector<value_pair*>& args);
+    static value_ref op_first_operand(const vector<value_pair*>& args);
+    static value_ref op_rest_operands(const vector<value_pair*>& args);
+    static value_ref op_make_empty_arglist(const vector<value_pair*>& args);
+    static value_ref op_adjoin_arg(const vector<value_pair*>& args);
+    static value_ref op_true_q(const vector<value_pair*>& args);
+    static value_ref op_false_q(const vector<value_pair*>& args);
+    static value_ref op_make_true(const vector<value_pair*>& args);
+    static value_ref op_make_false(const vector<value_pair*>& args);
+    static value_ref op_primitive_procedure_q(const vector<value_pair*>& args);
+    static value_ref op_compound_procedure_q(const vector<value_pair*>& args);
+    static value_ref op_compiled_procedure_q(const vector<value_pair*>& args);
+    static value_ref op_compound_parameters(const vector<value_pair*>& args);
+    static value_ref op_compound_body(const vector<value_pair*>& args);
+    static value_ref op_compound_environment(const vector<value_pair*>& args);
+    static value_ref op_make_compound_procedure(const vector<value_pair*>& args);
+    static value_ref op_compiled_entry(const vector<value_pair*>& args);
+    static value_ref op_compiled_environment(const vector<value_pair*>& args);
+    static value_ref op_make_compiled_procedure(const vector<value_pair*>& args);
+    static value_ref op_signal_error(const vector<value_pair*>& args);
+    static value_ref op_apply_primitive_procedure(const vector<value_pair*>& args);
+    static value_ref op_lookup_variable_value(const vector<value_pair*>& args);
+    static value_ref op_set_variable_value(const vector<value_pair*>& args);
+    static value_ref op_define_variable(const vector<value_pair*>& args);
+    static value_ref op_extend_environment(const vector<value_pair*>& args);
+    static value_ref op_dispatch_table_ready_q(const vector<value_pair*>& args);
+    static value_ref op_make_dispatch_table(const vector<value_pair*>& args);
+    static value_ref op_add_dispatch_record(const vector<value_pair*>& args);
+    static value_ref op_dispatch_on_type(const vector<value_pair*>& args);
+    static value_ref op_cons(const vector<value_pair*>& args);
+
+    // lexical addressing of the variable references in the
+    // lambda bodies: a scope per frame created at runtime
+    struct lexical_scope {
+        vector<const value_symbol*> params;
+        vector<const value_symbol*> defines;
     };
 
-    static shared_ptr<value> op_check_quoted(const vector<value_pair*>& args);
-    static shared_ptr<value> op_text_of_quotation(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_assignment(const vector<value_pair*>& args);
-    static shared_ptr<value> op_assignment_variable(const vector<value_pair*>& args);
-    static shared_ptr<value> op_assignment_value(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_definition(const vector<value_pair*>& args);
-    static shared_ptr<value> op_definition_variable(const vector<value_pair*>& args);
-    static shared_ptr<value> op_definition_value(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_if(const vector<value_pair*>& args);
-    static shared_ptr<value> op_if_predicate(const vector<value_pair*>& args);
-    static shared_ptr<value> op_if_consequent(const vector<value_pair*>& args);
-    static shared_ptr<value> op_if_alternative(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_lambda(const vector<value_pair*>& args);
-    static shared_ptr<value> op_lambda_parameters(const vector<value_pair*>& args);
-    static shared_ptr<value> op_lambda_body(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_let(const vector<value_pair*>& args);
-    static shared_ptr<value> op_transform_let(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_begin(const vector<value_pair*>& args);
-    static shared_ptr<value> op_begin_actions(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_cond(const vector<value_pair*>& args);
-    static shared_ptr<value> op_transform_cond(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_and(const vector<value_pair*>& args);
-    static shared_ptr<value> op_and_expressions(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_or(const vector<value_pair*>& args);
-    static shared_ptr<value> op_or_expressions(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_eval(const vector<value_pair*>& args);
-    static shared_ptr<value> op_eval_expression(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_apply(const vector<value_pair*>& args);
-    static shared_ptr<value> op_apply_operator(const vector<value_pair*>& args);
-    static shared_ptr<value> op_apply_arguments(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_apply_args(const vector<value_pair*>& args);
-    static shared_ptr<value> op_check_application(const vector<value_pair*>& args);
-    static shared_ptr<value> op_no_exps_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_last_exp_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_first_exp(const vector<value_pair*>& args);
-    static shared_ptr<value> op_rest_exps(const vector<value_pair*>& args);
-    static shared_ptr<value> op_operator(const vector<value_pair*>& args);
-    static shared_ptr<value> op_operands(const vector<value_pair*>& args);
-    static shared_ptr<value> op_no_operands_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_last_operand_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_first_operand(const vector<value_pair*>& args);
-    static shared_ptr<value> op_rest_operands(const vector<value_pair*>& args);
-    static shared_ptr<value> op_make_empty_arglist(const vector<value_pair*>& args);
-    static shared_ptr<value> op_adjoin_arg(const vector<value_pair*>& args);
-    static shared_ptr<value> op_true_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_false_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_make_true(const vector<value_pair*>& args);
-    static shared_ptr<value> op_make_false(const vector<value_pair*>& args);
-    static shared_ptr<value> op_primitive_procedure_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_compound_procedure_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_compiled_procedure_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_compound_parameters(const vector<value_pair*>& args);
-    static shared_ptr<value> op_compound_body(const vector<value_pair*>& args);
-    static shared_ptr<value> op_compound_environment(const vector<value_pair*>& args);
-    static shared_ptr<value> op_make_compound_procedure(const vector<value_pair*>& args);
-    static shared_ptr<value> op_signal_error(const vector<value_pair*>& args);
-    static shared_ptr<value> op_apply_primitive_procedure(const vector<value_pair*>& args);
-    static shared_ptr<value> op_lookup_variable_value(const vector<value_pair*>& args);
-    static shared_ptr<value> op_set_variable_value(const vector<value_pair*>& args);
-    static shared_ptr<value> op_define_variable(const vector<value_pair*>& args);
-    static shared_ptr<value> op_extend_environment(const vector<value_pair*>& args);
-    static shared_ptr<value> op_dispatch_table_ready_q(const vector<value_pair*>& args);
-    static shared_ptr<value> op_make_dispatch_table(const vector<value_pair*>& args);
-    static shared_ptr<value> op_add_dispatch_record(const vector<value_pair*>& args);
-    static shared_ptr<value> op_dispatch_on_type(const vector<value_pair*>& args);
+    static value_ref _address(const value_ref& exp, vector<lexical_scope>& scopes);
+    static value_ref _address_list(const value_ref& list, vector<lexical_scope>& scopes);
+    static value_ref _address_body(const value_ref& params, const value_ref& body, vector<lexical_scope>& scopes);
+    static value_ref _resolve(const value_ref& symbol, const vector<lexical_scope>& scopes);
+    static void _scan_defines(const value_ref& exp, vector<const value_symbol*>& defines);
 
     void _bind_machine_ops(machine& m);
-    machine _make_machine(path path_to_code);
-    shared_ptr<value_environment> _make_global();
+    machine _make_machine(path path_to_code, machine_engine engine);
+    ref_ptr<value_environment> _make_global();
 
-    shared_ptr<value_environment> _global;
+    // destroyed last: the values below live in the
+    // allocator, the collector frees their cycles
+    unique_ptr<slab_allocator> _allocator;
+    unique_ptr<garbage_collector> _collector;
+    ref_ptr<value_environment> _global;
     machine _machine;
+    syntax_cache _syntax;
 };
 
 #endif  // EVALUATOR_H_
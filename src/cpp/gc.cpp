@@ -0,0 +1,125 @@
+#include "gc.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include "allocator.hpp"
+#include "value.hpp"
+
+using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+namespace {
+
+template <typename F>
+class function_tracer : public value_tracer {
+   public:
+    function_tracer(F fn) : _fn(fn) {}
+
+   protected:
+    void _visit(value* v) override { _fn(v); }
+
+   private:
+    F _fn;
+};
+
+template <typename F>
+function_tracer<F> make_tracer(F fn) {
+    return function_tracer<F>(fn);
+}
+
+}  // namespace
+
+void garbage_collector::collect() {
+    auto start_time = steady_clock::now();
+
+    vector<value*> values;
+    _heap.for_each_cell([&values](void* cell) {
+        values.push_back(static_cast<value*>(cell));
+    });
+
+    // subtract the references from inside the heap:
+    // what remains are the references from outside
+    auto decrement = make_tracer([](value* v) { --v->_refs; });
+    for (auto v : values) {
+        v->_trace(decrement);
+    }
+
+    // mark from the registered roots and
+    // the values referenced from outside
+    if (_roots) {
+        auto mark = make_tracer([this](value* v) { _mark(v); });
+        _roots(mark);
+    }
+    for (auto v : values) {
+        if (v->_refs > 0) {
+            _mark(v);
+        }
+    }
+
+    // restore the counts
+    auto increment = make_tracer([](value* v) { ++v->_refs; });
+    for (auto v : values) {
+        v->_trace(increment);
+    }
+
+    // the unmarked values are garbage
+    vector<value*> garbage;
+    for (auto v : values) {
+        if (!v->_marked) {
+            garbage.push_back(v);
+        }
+    }
+    for (auto v : _marked) {
+        v->_marked = false;
+    }
+    _marked.clear();
+
+    // hold the garbage while breaking the
+    // cycles, then release the last count
+    for (auto v : garbage) {
+        ++v->_refs;
+    }
+    for (auto v : garbage) {
+        v->_clear();
+    }
+    for (auto v : garbage) {
+        if (--v->_refs == 0) {
+            delete v;
+        }
+    }
+
+    _stats.before = values.size();
+    _stats.after = values.size() - garbage.size();
+    _stats.collected_times += 1;
+    _stats.collected_values += garbage.size();
+    _stats.collection_time += duration<double>(steady_clock::now() - start_time).count();
+
+    _last_allocated = _heap.allocated_bytes();
+}
+
+void garbage_collector::_mark(value* root) {
+    if (root->_marked) {
+        return;
+    }
+
+    vector<value*> stack;
+    auto visit = make_tracer([this, &stack](value* v) {
+        if (!v->_marked) {
+            v->_marked = true;
+            _marked.push_back(v);
+            stack.push_back(v);
+        }
+    });
+
+    root->_marked = true;
+    _marked.push_back(root);
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        value* v = stack.back();
+        stack.pop_back();
+        v->_trace(visit);
+    }
+}
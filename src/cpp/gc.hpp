@@ -0,0 +1,81 @@
+#ifndef GC_HPP_
+#define GC_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "allocator.hpp"
+#include "value.hpp"
+
+using std::function;
+using std::size_t;
+using std::vector;
+
+// tracing collector over the values of a slab heap: the reference
+// counts free the acyclic garbage as soon as it appears, the
+// collector frees the cycles (e.g., an environment holding a
+// closure over itself) that the counts can't. the roots are the
+// registered ones and every value referenced from outside the
+// heap (found by subtracting the in-heap references from the
+// counts), so the values held by C++ code are never collected
+
+#define GC_THRESHOLD (16 * 1024 * 1024)  // bytes allocated between collections
+
+struct gc_stats {
+    size_t before;               // values in the heap before the last collection
+    size_t after;                // values in the heap after the last collection
+    size_t collected_times;      // collections so far
+    size_t collected_values;     // values freed by the collections
+    double collection_time{0};   // seconds spent collecting
+};
+
+using gc_roots = function<void(value_tracer&)>;
+
+class garbage_collector {
+   public:
+    garbage_collector(slab_allocator& heap, size_t threshold = GC_THRESHOLD)
+        : _heap(heap), _threshold(threshold), _last_allocated(heap.allocated_bytes()) {}
+
+    // the last collection: what's left is
+    // either held from outside or garbage
+    ~garbage_collector() {
+        _roots = nullptr;
+        collect();
+    }
+
+    // can't copy or move
+    garbage_collector(const garbage_collector&) = delete;
+    void operator=(garbage_collector const&) = delete;
+    garbage_collector(garbage_collector&&) = delete;
+    garbage_collector& operator=(garbage_collector&&) = delete;
+
+    // set the function tracing the registered roots
+    void roots(const gc_roots& roots) {
+        _roots = roots;
+    }
+
+    // allocated enough since the last collection?
+    bool due() const {
+        return _threshold != 0 && _heap.allocated_bytes() - _last_allocated >= _threshold;
+    }
+
+    void collect();
+
+    const gc_stats& stats() const {
+        return _stats;
+    }
+
+   private:
+    void _mark(value* v);
+
+    slab_allocator& _heap;
+    size_t _threshold;
+    size_t _last_allocated;
+    gc_roots _roots;
+    gc_stats _stats{};
+
+    vector<value*> _marked;  // to unmark after the collection
+};
+
+#endif  // GC_HPP_
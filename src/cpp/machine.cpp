@@ -12,25 +12,25 @@
 
 using std::cout;
 using std::ios_base;
-using std::make_shared;
 using std::move;
 using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::vector;
 
+thread_local machine* machine::_current = nullptr;
+
 // instruction hierarchy
 
 namespace {
 
 void annotate_register(ostream& os, const value_pair* reg) {
     os << BLUE("[");
-    if (reg->car()->type() == value_t::pair &&
-        reg->pcar()->car()->type() == value_t::instruction) {
+    if (reg->car().type() == value_t::code) {
         // the register points to code
         os << "<code>";
     } else {
-        os << *reg->car();
+        os << reg->car();
     }
     os << BLUE("]");
 }
@@ -39,26 +39,8 @@ void annotate_register(ostream& os, const value_pair* reg) {
 
 class machine::instruction_assign_call : public value_instruction {
    public:
-    instruction_assign_call(machine& machine, const shared_ptr<code_assign_call>& code)
-        : value_instruction(machine),
-          _reg(machine._get_register(code->reg())),
-          _op(machine._get_op(code->op())),
-          _args(machine._tokens_to_args(code->args())),
-          _code(code) {}
-
-    void execute() const override {
-        auto result = _machine._call_op(_op, _args);
-
-        if (result->type() == value_t::error) {
-            // halt the program
-            _machine._output->car(result, false);
-            _machine._move_pc_to_end();
-        } else {
-            // assign the result
-            _reg->car(result, false);
-            _machine._advance_pc();
-        }
-    }
+    instruction_assign_call(machine& machine, const instruction& record, const shared_ptr<code_assign_call>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("assign");
@@ -66,10 +48,11 @@ class machine::instruction_assign_call : public value_instruction {
         os << " (op " << _code->op() << ")";  // op
 
         size_t i = 0;
+        const auto& args = _machine._arg_lists[_record.args];
         for (auto& t : _code->args()) {
             os << " " << t;
             if (t.type() == token_t::reg) {
-                annotate_register(os, _args[i]);  // argument
+                annotate_register(os, args[i]);  // argument
             }
             ++i;
         }
@@ -79,40 +62,26 @@ class machine::instruction_assign_call : public value_instruction {
 
     void trace_after(ostream& os) const override {
         os << BLUE(" == ");
-        if (_machine._output->car()->type() == value_t::error) {
+        const auto& reg = _machine._cells[_record.dst];
+        if (_machine._output->car().type() == value_t::error) {
             // error occured
-            os << *_machine._output->car();
-        } else if (_reg) {
-            if (_reg->car()->type() == value_t::pair &&
-                _reg->pcar()->car()->type() == value_t::instruction) {
-                // code returned
-                os << "<code>";
-            } else {
-                os << *_reg->car();
-            }
+            os << _machine._output->car();
+        } else if (reg->car().type() == value_t::code) {
+            // code returned
+            os << "<code>";
+        } else {
+            os << reg->car();
         }
     }
 
    private:
-    value_pair* _reg;
-    const value_machine_op* _op;
-    const vector<value_pair*> _args;
     const shared_ptr<code_assign_call> _code;
 };
 
 class machine::instruction_assign_copy : public value_instruction {
    public:
-    instruction_assign_copy(machine& machine, const shared_ptr<code_assign_copy>& code)
-        : value_instruction(machine),
-          _reg(machine._get_register(code->reg())),
-          _src(machine._token_to_arg(code->src())),
-          _code(code) {}
-
-    void execute() const override {
-        // assign from source
-        _reg->car(_src->car(), false);
-        _machine._advance_pc();
-    }
+    instruction_assign_copy(machine& machine, const instruction& record, const shared_ptr<code_assign_copy>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("assign");
@@ -120,7 +89,7 @@ class machine::instruction_assign_copy : public value_instruction {
 
         os << " " << _code->src();
         if (_code->src().type() == token_t::reg) {
-            annotate_register(os, _src);  // source
+            annotate_register(os, _machine._cells[_record.src].get());  // source
         }
 
         os << ")";
@@ -130,41 +99,24 @@ class machine::instruction_assign_copy : public value_instruction {
     }
 
    private:
-    value_pair* _reg;
-    const value_pair* _src;
     const shared_ptr<code_assign_copy> _code;
 };
 
 class machine::instruction_perform : public value_instruction {
    public:
-    instruction_perform(machine& machine, const shared_ptr<code_perform>& code)
-        : value_instruction(machine),
-          _op(machine._get_op(code->op())),
-          _args(machine._tokens_to_args(code->args())),
-          _code(code) {}
-
-    void execute() const override {
-        auto result = _machine._call_op(_op, _args);
-
-        if (result->type() == value_t::error) {
-            // halt the program
-            _machine._output->car(result, false);
-            _machine._move_pc_to_end();
-        } else {
-            // just move the pc
-            _machine._advance_pc();
-        }
-    }
+    instruction_perform(machine& machine, const instruction& record, const shared_ptr<code_perform>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("perform");
         os << " (op " << _code->op() << ")";  // op
 
         size_t i = 0;
+        const auto& args = _machine._arg_lists[_record.args];
         for (auto& t : _code->args()) {
             os << " " << t;
             if (t.type() == token_t::reg) {
-                annotate_register(os, _args[i]);  // argument
+                annotate_register(os, args[i]);  // argument
             }
             ++i;
         }
@@ -173,42 +125,20 @@ class machine::instruction_perform : public value_instruction {
     }
 
     void trace_after(ostream& os) const override {
-        if (_machine._output->car()->type() == value_t::error) {
+        if (_machine._output->car().type() == value_t::error) {
             // error occured
-            os << BLUE(" == ") << *_machine._output->car();
+            os << BLUE(" == ") << _machine._output->car();
         }
     }
 
    private:
-    const value_machine_op* _op;
-    const vector<value_pair*> _args;
     const shared_ptr<code_perform> _code;
 };
 
 class machine::instruction_branch : public value_instruction {
    public:
-    instruction_branch(machine& machine, const shared_ptr<code_branch>& code)
-        : value_instruction(machine),
-          _label(machine._get_label(code->label())),
-          _op(machine._get_op(code->op())),
-          _args(machine._tokens_to_args(code->args())),
-          _code(code) {}
-
-    void execute() const override {
-        auto result = _machine._call_op(_op, _args);
-
-        if (result->type() == value_t::error) {
-            // halt the program
-            _machine._output->car(result, false);
-            _machine._move_pc_to_end();
-        } else if (*result) {
-            // jump to the label
-            _machine._move_pc(_label->car());
-        } else {
-            // move the pc to the next
-            _machine._advance_pc();
-        }
-    }
+    instruction_branch(machine& machine, const instruction& record, const shared_ptr<code_branch>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("branch");
@@ -216,10 +146,11 @@ class machine::instruction_branch : public value_instruction {
         os << " (op " << _code->op() << ")";        // op
 
         size_t i = 0;
+        const auto& args = _machine._arg_lists[_record.args];
         for (auto& t : _code->args()) {
             os << " " << t;
             if (t.type() == token_t::reg) {
-                annotate_register(os, _args[i]);  // argument
+                annotate_register(os, args[i]);  // argument
             }
             ++i;
         }
@@ -229,10 +160,12 @@ class machine::instruction_branch : public value_instruction {
 
     void trace_after(ostream& os) const override {
         os << BLUE(" -> ");
-        if (_machine._output->car()->type() == value_t::error) {
+        const auto& label = _machine._cells[_record.dst];
+        if (_machine._output->car().type() == value_t::error) {
             // error ocurred
-            os << *_machine._output->car();
-        } else if (_machine._pc == _label->car().get()) {
+            os << _machine._output->car();
+        } else if (label->car().type() == value_t::code &&
+                   _machine._pc == to_ptr<value_code>(label->car())->offset()) {
             // test has passed
             os << GREEN("yes");
         } else {
@@ -242,23 +175,13 @@ class machine::instruction_branch : public value_instruction {
     }
 
    private:
-    const value_pair* _label;
-    const value_machine_op* _op;
-    const vector<value_pair*> _args;
     const shared_ptr<code_branch> _code;
 };
 
 class machine::instruction_goto : public value_instruction {
    public:
-    instruction_goto(machine& machine, const shared_ptr<code_goto>& code)
-        : value_instruction(machine),
-          _target(machine._token_to_arg(code->target())),
-          _code(code) {}
-
-    void execute() const override {
-        // jump to the target: label or register
-        _machine._move_pc(_target->car());
-    }
+    instruction_goto(machine& machine, const instruction& record, const shared_ptr<code_goto>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("goto") " ";
@@ -270,22 +193,13 @@ class machine::instruction_goto : public value_instruction {
     }
 
    private:
-    const value_pair* _target;
     const shared_ptr<code_goto> _code;
 };
 
 class machine::instruction_save : public value_instruction {
    public:
-    instruction_save(machine& machine, const shared_ptr<code_save>& code)
-        : value_instruction(machine),
-          _reg(machine._get_register(code->reg())),
-          _code(code) {}
-
-    void execute() const override {
-        // save the register's content
-        _machine._push_to_stack(_reg->car());
-        _machine._advance_pc();
-    }
+    instruction_save(machine& machine, const instruction& record, const shared_ptr<code_save>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("save") " ";
@@ -295,32 +209,23 @@ class machine::instruction_save : public value_instruction {
 
     void trace_after(ostream& os) const override {
         os << BLUE(" >> ");
-        if (_reg->car()->type() == value_t::pair &&
-            _reg->pcar()->car()->type() == value_t::instruction) {
+        const auto& reg = _machine._cells[_record.src];
+        if (reg->car().type() == value_t::code) {
             // code saved
             os << "<code>";
         } else {
-            os << *_reg->car();
+            os << reg->car();
         }
     }
 
    private:
-    const value_pair* _reg;
     const shared_ptr<code_save> _code;
 };
 
 class machine::instruction_restore : public value_instruction {
    public:
-    instruction_restore(machine& machine, const shared_ptr<code_restore>& code)
-        : value_instruction(machine),
-          _reg(machine._get_register(code->reg())),
-          _code(code) {}
-
-    void execute() const override {
-        // restore the register's content
-        _reg->car(_machine._pop_from_stack(), false);
-        _machine._advance_pc();
-    }
+    instruction_restore(machine& machine, const instruction& record, const shared_ptr<code_restore>& code)
+        : value_instruction(machine, record), _code(code) {}
 
     void trace_before(ostream& os) const override {
         os << "(" << BLUE("restore") " ";
@@ -330,69 +235,67 @@ class machine::instruction_restore : public value_instruction {
 
     void trace_after(ostream& os) const override {
         os << BLUE(" << ");
-        if (_reg->car()->type() == value_t::pair &&
-            _reg->pcar()->car()->type() == value_t::instruction) {
+        const auto& reg = _machine._cells[_record.dst];
+        if (reg->car().type() == value_t::code) {
             // code restored
             os << "<code>";
         } else {
-            os << *_reg->car();
+            os << reg->car();
         }
     }
 
    private:
-    value_pair* _reg;
     const shared_ptr<code_restore> _code;
 };
 
 // machine
 
-value_pair* machine::_get_constant(const shared_ptr<value>& val) {
+uint32_t machine::_make_cell(const value_ref& val) {
+    // create a new cell holding val
+    _cells.push_back(make_vpair(val, nil));
+    return static_cast<uint32_t>(_cells.size() - 1);
+}
+
+uint32_t machine::_get_constant(const value_ref& val) {
     // create and return a new constant
-    _constants = make_vpair(val, _constants);
-    return _constants.get();
+    return _make_cell(val);
 }
 
-value_pair* machine::_get_register(const string& name) {
+uint32_t machine::_get_register(const string& name) {
     auto iter = _register_map.find(name);
     if (iter != _register_map.end()) {
         // return existing register
         return iter->second;
     } else {
         // create a new register with a nil
-        _registers = make_vpair(nil, _registers);
-        _register_map[name] = _registers.get();
-        return _registers.get();
+        return (_register_map[name] = _make_cell(nil));
     }
 }
 
-value_pair* machine::_get_label(const string& name) {
+uint32_t machine::_get_label(const string& name) {
     auto iter = _label_map.find(name);
     if (iter != _label_map.end()) {
         // return existing label
         return iter->second;
     } else {
         // create a new label pointing to nil
-        _labels = make_vpair(nil, _labels);
-        _label_map[name] = _labels.get();
-        return _labels.get();
+        return (_label_map[name] = _make_cell(nil));
     }
 }
 
-machine::value_machine_op* machine::_get_op(const string& name) {
+uint32_t machine::_get_op(const string& name) {
     auto iter = _op_map.find(name);
     if (iter != _op_map.end()) {
         // return existing op
         return iter->second;
     } else {
         // create a new unbound op
-        auto op = make_shared<value_machine_op>(name);
-        _ops = make_vpair(op, _ops);
-        _op_map[name] = op.get();
-        return op.get();
+        _op_table.push_back(make_ref<value_machine_op>(name));
+        return (_op_map[name] = static_cast<uint32_t>(_op_table.size() - 1));
     }
 }
 
-value_pair* machine::_token_to_arg(const token& t) {
+uint32_t machine::_token_to_arg(const token& t) {
     // convert code token to a machine arg
     switch (t.type()) {
         case token_t::reg:
@@ -406,33 +309,71 @@ value_pair* machine::_token_to_arg(const token& t) {
     }
 }
 
-const vector<value_pair*> machine::_tokens_to_args(const vector<token>& tokens) {
+uint32_t machine::_tokens_to_args(const vector<token>& tokens) {
     vector<value_pair*> result;
 
     for (auto& t : tokens) {
         // create an arg for every token
-        result.push_back(_token_to_arg(t));
+        result.push_back(_cells[_token_to_arg(t)].get());
     }
 
-    return result;
+    _arg_lists.push_back(move(result));
+    return static_cast<uint32_t>(_arg_lists.size() - 1);
+}
+
+machine::instruction machine::_make_record(const shared_ptr<code>& line) {
+    switch (line->type()) {
+        case code_t::assign_call: {
+            auto c = to_sptr<code_assign_call>(line);
+            return {code_t::assign_call, _get_register(c->reg()), 0, _get_op(c->op()), _tokens_to_args(c->args())};
+        }
+        case code_t::assign_copy: {
+            auto c = to_sptr<code_assign_copy>(line);
+            return {code_t::assign_copy, _get_register(c->reg()), _token_to_arg(c->src()), 0, 0};
+        }
+        case code_t::perform: {
+            auto c = to_sptr<code_perform>(line);
+            return {code_t::perform, 0, 0, _get_op(c->op()), _tokens_to_args(c->args())};
+        }
+        case code_t::branch: {
+            auto c = to_sptr<code_branch>(line);
+            return {code_t::branch, _get_label(c->label()), 0, _get_op(c->op()), _tokens_to_args(c->args())};
+        }
+        case code_t::goto_: {
+            auto c = to_sptr<code_goto>(line);
+            return {code_t::goto_, 0, _token_to_arg(c->target()), 0, 0};
+        }
+        case code_t::save: {
+            auto c = to_sptr<code_save>(line);
+            return {code_t::save, 0, _get_register(c->reg()), 0, 0};
+        }
+        case code_t::restore: {
+            auto c = to_sptr<code_restore>(line);
+            return {code_t::restore, _get_register(c->reg()), 0, 0, 0};
+        }
+        default:
+            throw machine_error(
+                "can't create an instruction from '%s'",
+                line->str().c_str());
+    }
 }
 
-shared_ptr<machine::value_instruction> machine::_make_instruction(const shared_ptr<code>& line) {
+ref_ptr<machine::value_instruction> machine::_make_instruction(const shared_ptr<code>& line, const instruction& record) {
     switch (line->type()) {
         case code_t::assign_call:
-            return make_shared<instruction_assign_call>(*this, to_sptr<code_assign_call>(line));
+            return make_ref<instruction_assign_call>(*this, record, to_sptr<code_assign_call>(line));
         case code_t::assign_copy:
-            return make_shared<instruction_assign_copy>(*this, to_sptr<code_assign_copy>(line));
+            return make_ref<instruction_assign_copy>(*this, record, to_sptr<code_assign_copy>(line));
         case code_t::perform:
-            return make_shared<instruction_perform>(*this, to_sptr<code_perform>(line));
+            return make_ref<instruction_perform>(*this, record, to_sptr<code_perform>(line));
         case code_t::branch:
-            return make_shared<instruction_branch>(*this, to_sptr<code_branch>(line));
+            return make_ref<instruction_branch>(*this, record, to_sptr<code_branch>(line));
         case code_t::goto_:
-            return make_shared<instruction_goto>(*this, to_sptr<code_goto>(line));
+            return make_ref<instruction_goto>(*this, record, to_sptr<code_goto>(line));
         case code_t::save:
-            return make_shared<instruction_save>(*this, to_sptr<code_save>(line));
+            return make_ref<instruction_save>(*this, record, to_sptr<code_save>(line));
         case code_t::restore:
-            return make_shared<instruction_restore>(*this, to_sptr<code_restore>(line));
+            return make_ref<instruction_restore>(*this, record, to_sptr<code_restore>(line));
         default:
             throw machine_error(
                 "can't create an instruction from '%s'",
@@ -440,9 +381,8 @@ shared_ptr<machine::value_instruction> machine::_make_instruction(const shared_p
     }
 }
 
-value_pair* machine::_append_code(const vector<shared_ptr<code>>& code) {
-    shared_ptr<value_pair> head{nullptr};
-    shared_ptr<value_pair> tail{nullptr};
+size_t machine::_append_code(const vector<shared_ptr<code>>& code) {
+    const size_t head = _code.size();
 
     vector<string> label_queue;
     for (const auto& line : code) {
@@ -452,64 +392,130 @@ value_pair* machine::_append_code(const vector<shared_ptr<code>>& code) {
             continue;
         }
 
-        // make an instruction and add it to a new pair (to be appended to the code)
-        shared_ptr<value_pair> new_pair = make_vpair(_make_instruction(line), nil);
-
-        if (!head) {
-            head = new_pair;  // first (non-label) line of the code
-        } else {
-            tail->cdr(new_pair);  // append to the tail
-        }
-        tail = new_pair;  // set the new tail
-
         if (!label_queue.empty()) {
-            // point the labels in the queued to
-            // the following instruction (new_pair)
+            // point the labels in the queue to
+            // the following instruction's offset
             // and clear the queue
+            auto position = make_ref<value_code>(_code.size());
             for (const auto& label_str : label_queue) {
-                _get_label(label_str)->car(new_pair);
+                _cells[_get_label(label_str)]->car(position);
             }
             label_queue.clear();
         }
+
+        // make an instruction record (and its tracing
+        // counterpart) and append it to the code
+        auto record = _make_record(line);
+        _instructions.push_back(_make_instruction(line, record));
+        _code.push_back(record);
     }
 
-    if (!head) {
-        // there was no (non-label) code to init the head
+    if (_code.size() == head) {
+        // there was no (non-label) code
         throw machine_error("can't append empty code");
     }
 
     if (!label_queue.empty()) {
         // if there are still queued labels,
-        // point them to nil (end of the program)
+        // point them to the end of the program
+        auto position = make_ref<value_code>(_code_end);
         for (const auto& label_str : label_queue) {
-            _get_label(label_str)->car(nil);
+            _cells[_get_label(label_str)]->car(position);
         }
     }
 
-    if (_code_head == nil) {
-        _code_head = head;  // first code of the machine
-    } else {
-        _code_tail->cdr(head);  // append to the code tail
-    }
-    _code_tail = tail;  // set the new code tail
-
-    return head.get();
+    return head;
 }
 
-machine::~machine() {
-    // cleanup registers, labels, etc. before implicit destruction
-    for (auto p = _registers; p != nil; p = to_sptr<value_pair>(p->cdr())) p->car(nil);
-    for (auto p = _labels; p != nil; p = to_sptr<value_pair>(p->cdr())) p->car(nil);
-    for (auto p = _constants; p != nil; p = to_sptr<value_pair>(p->cdr())) p->car(nil);
-    for (auto p = _ops; p != nil; p = to_sptr<value_pair>(p->cdr())) p->car(nil);
-    for (auto p = _code_head; p != nil; p = to_sptr<value_pair>(p->cdr())) p->car(nil);
+void machine::_run_switch() {
+    while (_pc < _code.size()) {
+        // execution of the instruction moves the pc
+        _execute(_code[_pc]);
+        _collect_if_due();
+    }
+}
 
-    _stack.clear();
+void machine::_run_threaded() {
+#ifdef MACHINE_THREADED_DISPATCH
+    // handler addresses indexed by code_t
+    static const void* const kinds[] = {
+        &&halt,  // label (never in the code)
+        &&assign_call,
+        &&assign_copy,
+        &&perform,
+        &&branch,
+        &&goto_,
+        &&save,
+        &&restore,
+    };
+
+// thread the records appended since the last run
+// (or by an op during this one) to their handlers
+#define THREAD_CODE()                                     \
+    for (size_t i = _handlers.size(); i < _code.size(); ++i) \
+        _handlers.push_back(kinds[static_cast<size_t>(_code[i].kind)]);
+
+// jump directly to the handler of the next record
+#define DISPATCH()                      \
+    if (_pc >= _handlers.size()) {      \
+        goto halt;                      \
+    } else {                            \
+        goto* _handlers[_pc];           \
+    }
+
+// only ops can append code or allocate
+#define DISPATCH_AFTER_OP()                  \
+    if (_handlers.size() != _code.size()) { \
+        THREAD_CODE();                       \
+    }                                        \
+    _collect_if_due();                       \
+    DISPATCH();
+
+    THREAD_CODE();
+    DISPATCH();
+
+assign_call:
+    _execute_assign_call(_code[_pc]);
+    DISPATCH_AFTER_OP();
+assign_copy:
+    _execute_assign_copy(_code[_pc]);
+    DISPATCH();
+perform:
+    _execute_perform(_code[_pc]);
+    DISPATCH_AFTER_OP();
+branch:
+    _execute_branch(_code[_pc]);
+    DISPATCH_AFTER_OP();
+goto_:
+    _execute_goto(_code[_pc]);
+    DISPATCH();
+save:
+    _execute_save(_code[_pc]);
+    DISPATCH();
+restore:
+    _execute_restore(_code[_pc]);
+    DISPATCH();
+halt:
+    return;
+
+#undef DISPATCH_AFTER_OP
+#undef DISPATCH
+#undef THREAD_CODE
+#else
+    _run_switch();
+#endif
 }
 
-shared_ptr<value> machine::run(const vector<pair<string, shared_ptr<value>>>& inputs, const string& output_register) {
+value_ref machine::run(const vector<pair<string, value_ref>>& inputs, const string& output_register) {
+    // the current machine until the run ends
+    struct current_scope {
+        current_scope(machine* m) : previous(_current) { _current = m; }
+        ~current_scope() { _current = previous; }
+        machine* previous;
+    } scope{this};
+
     // define and reset the output register
-    _output = _get_register(output_register);
+    _output = _cells[_get_register(output_register)].get();
     _output->car(nil);
 
     // write the inputs one by one
@@ -524,19 +530,21 @@ shared_ptr<value> machine::run(const vector<pair<string, shared_ptr<value>>>& in
 
     if (_trace != machine_trace::code) {
         // without code tracing
-        while (_pc != nilptr) {
-            // execution of the instruction moves the pc
-            (to_ptr<const value_instruction>(_pc->car()))->execute();
+        if (_engine == machine_engine::threaded) {
+            _run_threaded();
+        } else {
+            _run_switch();
         }
     } else {
         // with code tracing
         ios_base::sync_with_stdio(false);
-        while (_pc != nilptr) {
-            auto instruction = to_ptr<const value_instruction>(_pc->car());
+        while (_pc < _code.size()) {
+            auto instruction = _instructions[_pc].get();
 
             _trace_before(cout, instruction);
-            instruction->execute();
+            _execute(_code[_pc]);
             _trace_after(cout, instruction);
+            _collect_if_due();
         }
         ios_base::sync_with_stdio(true);
     }
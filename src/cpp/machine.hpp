@@ -1,6 +1,8 @@
 #ifndef MACHINE_HPP_
 #define MACHINE_HPP_
 
+#include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -13,8 +15,10 @@
 #include "code.hpp"
 #include "constants.hpp"
 #include "error.hpp"
+#include "gc.hpp"
 #include "value.hpp"
 
+using std::deque;
 using std::pair;
 using std::setfill;
 using std::setw;
@@ -25,7 +29,7 @@ using std::vector;
 
 // types
 
-using machine_op = shared_ptr<value> (*)(const vector<value_pair*>&);
+using machine_op = value_ref (*)(const vector<value_pair*>&);
 
 // exceptions
 
@@ -43,14 +47,29 @@ enum class machine_trace {
     code,
 };
 
+// untraced execution engine: direct threading
+// (labels as values) needs GCC or Clang, the
+// switch-based dispatch is always available
+
+#if defined(__GNUC__)
+#define MACHINE_THREADED_DISPATCH 1
+#endif
+
+enum class machine_engine {
+    switch_,
+    threaded,
+};
+
 class machine {
    public:
-    machine(const vector<shared_ptr<code>>& code) {
+    machine(const vector<shared_ptr<code>>& code, machine_engine engine = machine_engine::threaded)
+        : _engine(engine) {
+#ifndef MACHINE_THREADED_DISPATCH
+        _engine = machine_engine::switch_;  // fallback
+#endif
         _append_code(code);
     }
 
-    ~machine();
-
     // can't copy, can move
     machine(const machine&) = delete;
     void operator=(machine const&) = delete;
@@ -58,15 +77,15 @@ class machine {
     machine& operator=(machine&&) = default;
 
     void bind_op(const string& name, const machine_op& op) {
-        _get_op(name)->op(op);
+        _op_table[_get_op(name)]->op(op);
     }
 
-    shared_ptr<value> read_from(const string& register_name) {
-        return _get_register(register_name)->car();
+    value_ref read_from(const string& register_name) {
+        return _cells[_get_register(register_name)]->car();
     }
 
-    void write_to(const string& register_name, const shared_ptr<value>& v) {
-        _get_register(register_name)->car(v);
+    void write_to(const string& register_name, const value_ref& v) {
+        _cells[_get_register(register_name)]->car(v);
     }
 
     void append_and_jump(const vector<shared_ptr<code>>& code) {
@@ -77,10 +96,32 @@ class machine {
         _trace = trace;
     }
 
-    shared_ptr<value> run(
-        const vector<pair<string, shared_ptr<value>>>& inputs,
+    machine_engine engine() const {
+        return _engine;
+    }
+
+    // collect the garbage between instructions when due
+    void collector(garbage_collector* collector) {
+        _collector = collector;
+    }
+
+    // the values held by the registers,
+    // labels, constants, and the stack
+    void trace_roots(value_tracer& tracer) const {
+        for (const auto& cell : _cells) tracer(cell);
+        for (const auto& val : _stack) tracer(val);
+    }
+
+    value_ref run(
+        const vector<pair<string, value_ref>>& inputs,
         const string& output_register);
 
+    // the machine running on the current thread (e.g.,
+    // for a primitive to append code), if there is one
+    static machine* current() {
+        return _current;
+    }
+
    private:
     // value wrapper for machine_ops
     class value_machine_op : public value {
@@ -102,26 +143,50 @@ class machine {
         machine_op _op{nullptr};
     };
 
-    // abstact base class for the instructions
+    // value wrapper for code positions
+    class value_code : public value {
+       public:
+        value_code(size_t offset)
+            : value(value_t::code), _offset{offset} {}
+
+        ostream& write(ostream& os) const override {
+            return (os << "<code " << _offset << ">");
+        };
+
+        size_t offset() const { return _offset; }
+
+       private:
+        const size_t _offset;
+    };
+
+    // compact instruction record: operands are
+    // indices in the cell, op, and arg list tables
+    struct instruction {
+        code_t kind;    // one of the seven instruction kinds
+        uint32_t dst;   // target register / branch label cell
+        uint32_t src;   // source register / label / constant cell
+        uint32_t op;    // op index
+        uint32_t args;  // arg list index
+    };
+
+    // abstact base class for the instructions (for tracing)
     class value_instruction : public value {
        public:
-        value_instruction(machine& machine)
-            : value(value_t::instruction), _machine(machine) {}
+        value_instruction(machine& machine, const instruction& record)
+            : value(value_t::instruction), _machine(machine), _record(record) {}
 
         ostream& write(ostream& os) const override {
             trace_before(os);
             return os;
         }
 
-        // execute the instruction
-        virtual void execute() const = 0;
-
         // for tracing before and after execution
         virtual void trace_before(ostream& os) const = 0;
         virtual void trace_after(ostream& os) const = 0;
 
        protected:
         machine& _machine;
+        const instruction _record;
     };
 
     // concrete instruction classes
@@ -133,44 +198,47 @@ class machine {
     class instruction_save;
     class instruction_restore;
 
-    void _advance_pc() {
-        // move the pc forward
-        _pc = _pc->pcdr();
-    }
+    // position past any code
+    static constexpr size_t _code_end = SIZE_MAX;
 
-    void _move_pc(const shared_ptr<value>& position) {
-        // set the pc to a given position
-        _pc = to_ptr<value_pair>(position);
+    void _move_pc(const value_ref& position) {
+        // set the pc to a given position:
+        // anything but code halts the program
+        if (position.type() == value_t::code) {
+            _pc = to_ptr<value_code>(position)->offset();
+        } else {
+            _pc = _code_end;
+        }
     }
 
     void _move_pc_to_beginning() {
-        // move the pc to the end of the program
-        _pc = _code_head.get();
+        // move the pc to the beginning of the program
+        _pc = 0;
     }
 
     void _move_pc_to_end() {
         // move the pc to the end of the program
-        _pc = nilptr;
+        _pc = _code_end;
     }
 
-    void _set_output(const shared_ptr<value>& v) {
+    void _set_output(const value_ref& v) {
         // write v to the current output register
-        _output->car(v);
+        _output->car(v, false);
     }
 
-    shared_ptr<value> _call_op(const value_machine_op* v, const vector<value_pair*>& _args) {
-        if (auto op = v->op()) {
-            return op(_args);  // call the op
+    value_ref _call_op(uint32_t op, uint32_t args) {
+        if (auto fn = _op_table[op]->op()) {
+            return fn(_arg_lists[args]);  // call the op
         } else {
-            throw machine_error("%s is unbound", v->str().c_str());
+            throw machine_error("%s is unbound", _op_table[op]->str().c_str());
         }
     }
 
-    void _push_to_stack(const shared_ptr<value>& v) {
+    void _push_to_stack(const value_ref& v) {
         _stack.push_back(v);
     }
 
-    shared_ptr<value> _pop_from_stack() {
+    value_ref _pop_from_stack() {
         if (_stack.empty()) {
             throw machine_error("can't pop from empty stack");
         } else {
@@ -180,6 +248,103 @@ class machine {
         }
     }
 
+    void _halt_on_error(const value_ref& result) {
+        // write the error to the output and halt the program
+        _set_output(result);
+        _move_pc_to_end();
+    }
+
+    // the records are taken by value and the pc is advanced
+    // before an op call, so that the op is free to append
+    // code and move the pc (e.g., to the appended code)
+
+    void _execute_assign_call(const instruction in) {
+        ++_pc;
+        auto result = _call_op(in.op, in.args);
+        if (result.type() == value_t::error) {
+            _halt_on_error(result);
+        } else {
+            // assign the result
+            _cells[in.dst]->car(result, false);
+        }
+    }
+
+    void _execute_assign_copy(const instruction in) {
+        // assign from source
+        _cells[in.dst]->car(_cells[in.src]->car(), false);
+        ++_pc;
+    }
+
+    void _execute_perform(const instruction in) {
+        ++_pc;
+        auto result = _call_op(in.op, in.args);
+        if (result.type() == value_t::error) {
+            _halt_on_error(result);
+        }
+    }
+
+    void _execute_branch(const instruction in) {
+        ++_pc;
+        auto result = _call_op(in.op, in.args);
+        if (result.type() == value_t::error) {
+            _halt_on_error(result);
+        } else if (result.truth()) {
+            // jump to the label
+            _move_pc(_cells[in.dst]->car());
+        }
+    }
+
+    void _execute_goto(const instruction in) {
+        // jump to the target: label or register
+        _move_pc(_cells[in.src]->car());
+    }
+
+    void _execute_save(const instruction in) {
+        // save the register's content
+        _push_to_stack(_cells[in.src]->car());
+        ++_pc;
+    }
+
+    void _execute_restore(const instruction in) {
+        // restore the register's content
+        _cells[in.dst]->car(_pop_from_stack(), false);
+        ++_pc;
+    }
+
+    void _execute(const instruction in) {
+        switch (in.kind) {
+            case code_t::assign_call:
+                _execute_assign_call(in);
+                break;
+            case code_t::assign_copy:
+                _execute_assign_copy(in);
+                break;
+            case code_t::perform:
+                _execute_perform(in);
+                break;
+            case code_t::branch:
+                _execute_branch(in);
+                break;
+            case code_t::goto_:
+                _execute_goto(in);
+                break;
+            case code_t::save:
+                _execute_save(in);
+                break;
+            case code_t::restore:
+                _execute_restore(in);
+                break;
+            default:
+                throw machine_error("illegal instruction at %zu", _pc);
+        }
+    }
+
+    void _collect_if_due() {
+        if (_collector != nullptr && _collector->due()) {
+            _collector->collect();
+        }
+    }
+
     void _trace_before(ostream& os, const value_instruction* instruction) {
         os << BLUE(<< setfill('0') << setw(5) << ++_counter <<) " ";
         instruction->trace_before(os);
@@ -191,36 +356,47 @@ class machine {
         os << '\n';
     }
 
-    value_pair* _get_constant(const shared_ptr<value>& val);
-    value_pair* _get_register(const string& name);
-    value_pair* _get_label(const string& name);
-    value_machine_op* _get_op(const string& name);
+    uint32_t _make_cell(const value_ref& val);
+    uint32_t _get_constant(const value_ref& val);
+    uint32_t _get_register(const string& name);
+    uint32_t _get_label(const string& name);
+    uint32_t _get_op(const string& name);
+
+    uint32_t _token_to_arg(const token& t);
+    uint32_t _tokens_to_args(const vector<token>& tokens);
 
-    value_pair* _token_to_arg(const token& t);
-    const vector<value_pair*> _tokens_to_args(const vector<token>& tokens);
+    void _run_switch();
+    void _run_threaded();
 
-    shared_ptr<value_instruction> _make_instruction(const shared_ptr<code>& line);
-    value_pair* _append_code(const vector<shared_ptr<code>>& code);
+    instruction _make_record(const shared_ptr<code>& line);
+    ref_ptr<value_instruction> _make_instruction(const shared_ptr<code>& line, const instruction& record);
+    size_t _append_code(const vector<shared_ptr<code>>& code);
 
-    shared_ptr<value_pair> _constants{nil};  // chain of constants
-    shared_ptr<value_pair> _registers{nil};  // chain of registers
-    shared_ptr<value_pair> _labels{nil};     // chain of labels
-    shared_ptr<value_pair> _ops{nil};        // chain of ops
+    vector<ref_ptr<value_pair>> _cells;           // registers, labels, constants
+    vector<ref_ptr<value_machine_op>> _op_table;  // ops
+    deque<vector<value_pair*>> _arg_lists;        // op args (stable addresses)
 
-    unordered_map<string, value_pair*> _register_map;  // name to register
-    unordered_map<string, value_pair*> _label_map;     // name to label
-    unordered_map<string, value_machine_op*> _op_map;  // name to op
+    unordered_map<string, uint32_t> _register_map;  // name to register cell
+    unordered_map<string, uint32_t> _label_map;     // name to label cell
+    unordered_map<string, uint32_t> _op_map;        // name to op index
 
-    shared_ptr<value_pair> _code_head{nil};  // head pair of the code
-    shared_ptr<value_pair> _code_tail{nil};  // tail pair of the code
+    vector<instruction> _code;                         // flat program
+    vector<ref_ptr<value_instruction>> _instructions;  // for tracing
 
-    vector<shared_ptr<value>> _stack;  // stack of values
+    vector<value_ref> _stack;  // stack of values
 
-    const value_pair* _pc;  // curent code position
-    value_pair* _output;    // output register
+    size_t _pc{_code_end};         // curent code position
+    value_pair* _output{nullptr};  // output register
 
+    vector<const void*> _handlers;  // threaded code: handler per record
+
+    machine_engine _engine;                    // untraced execution engine
     machine_trace _trace{machine_trace::off};  // machine tracing flag
     size_t _counter{0};                        // instruction counter
+
+    garbage_collector* _collector{nullptr};  // polled after the ops
+
+    static thread_local machine* _current;
 };
 
 #endif  // MACHINE_HPP_
@@ -15,7 +15,6 @@ using std::ifstream;
 using std::invalid_argument;
 using std::istream;
 using std::istringstream;
-using std::shared_ptr;
 using std::string;
 using std::unordered_map;
 using std::unordered_set;
@@ -40,7 +39,7 @@ const unordered_set<char> non_alnum_symbol_chars{
     '_', '!', '?', '.', '#', '+', '-', '*', '/',
     '%', '^', '=', '<', '>', '&', '|', '\\'};
 
-const unordered_map<string, shared_ptr<value>> special_symbols{
+const unordered_map<string, value_ref> special_symbols{
     {"#f", false_},
     {"false", false_},
     {"#t", true_},
@@ -58,7 +57,7 @@ inline bool is_special_symbol(string& symbol) {
     return special_symbols.count(symbol);
 }
 
-shared_ptr<value_number> convert_to_number(string& symbol) {
+ref_ptr<value_number> convert_to_number(string& symbol) {
     size_t pos;
 
     try {
@@ -74,7 +73,7 @@ shared_ptr<value_number> convert_to_number(string& symbol) {
     }
 }
 
-shared_ptr<value> parse_symbol(istream& is) {
+value_ref parse_symbol(istream& is) {
     string symbol;
 
     char c;
@@ -98,7 +97,7 @@ shared_ptr<value> parse_symbol(istream& is) {
     }
 }
 
-shared_ptr<value_string> parse_string(istream& is) {
+ref_ptr<value_string> parse_string(istream& is) {
     string string;
 
     char c;
@@ -114,7 +113,7 @@ shared_ptr<value_string> parse_string(istream& is) {
     return make_string(string);
 }
 
-void quote_item(shared_ptr<value>& item) {
+void quote_item(value_ref& item) {
     // transform an item x to the list (quote x)
     item = make_vpair(
         make_symbol(quote_symbol),
@@ -122,9 +121,9 @@ void quote_item(shared_ptr<value>& item) {
 }
 
 void add_to_list(
-    shared_ptr<value_pair>& head,
-    shared_ptr<value_pair>& tail,
-    shared_ptr<value>& item) {
+    ref_ptr<value_pair>& head,
+    ref_ptr<value_pair>& tail,
+    value_ref& item) {
     // make a new pair with the item as car
     auto pair = make_vpair(item, nil);
     if (!head) {
@@ -135,14 +134,14 @@ void add_to_list(
     tail = pair;  // move the tail
 }
 
-shared_ptr<value> replace_dots_in_list(shared_ptr<value> v) {
-    shared_ptr<value> running = v;
-    shared_ptr<value_pair> previous = nullptr;
+value_ref replace_dots_in_list(value_ref v) {
+    value_ref running = v;
+    ref_ptr<value_pair> previous = nullptr;
 
     while (running != nil) {
         // iterate over the items of the list v
         auto pair = to_sptr<value_pair>(running);
-        if (pair->car()->type() == value_t::symbol &&
+        if (pair->car().type() == value_t::symbol &&
             to_sptr<value_symbol>(pair->car())->symbol() == dot_symbol) {
             // current item is a dot symbol
             if (pair->cdr() == nil) {
@@ -158,7 +157,7 @@ shared_ptr<value> replace_dots_in_list(shared_ptr<value> v) {
                     "2+ items after %s in %s",
                     dot_symbol.c_str(), v->str().c_str());
             }
-            if (cdr->car()->type() == value_t::symbol &&
+            if (cdr->car().type() == value_t::symbol &&
                 to_sptr<value_symbol>(cdr->car())->symbol() == dot_symbol) {
                 // next item is a dot symbol: (x . .)
                 throw parsing_error(
@@ -185,12 +184,12 @@ shared_ptr<value> replace_dots_in_list(shared_ptr<value> v) {
     return v;
 }
 
-shared_ptr<value> parse_list(istream& is) {
-    shared_ptr<value_pair> head = nullptr;
-    shared_ptr<value_pair> tail = nullptr;
+value_ref parse_list(istream& is) {
+    ref_ptr<value_pair> head = nullptr;
+    ref_ptr<value_pair> tail = nullptr;
 
     size_t number_of_quotes = 0;
-    shared_ptr<value> item = nullptr;
+    value_ref item = nullptr;
 
     char c;
     bool done = false;
@@ -266,9 +265,9 @@ shared_ptr<value> parse_list(istream& is) {
 
 }  // namespace
 
-shared_ptr<value_pair> parse_values_from(istream& is) {
+ref_ptr<value_pair> parse_values_from(istream& is) {
     // parse the whole string content as a list
-    shared_ptr<value> result = parse_list(is);
+    value_ref result = parse_list(is);
 
     if (is) {
         // there are chars left in the stream
@@ -278,16 +277,16 @@ shared_ptr<value_pair> parse_values_from(istream& is) {
     return to_sptr<value_pair>(result);
 }
 
-shared_ptr<value_pair> parse_values_from(const string& str) {
+ref_ptr<value_pair> parse_values_from(const string& str) {
     istringstream s{str};
     return parse_values_from(s);
 }
 
-shared_ptr<value_pair> parse_values_from(const char* str) {
+ref_ptr<value_pair> parse_values_from(const char* str) {
     return parse_values_from(string(str));
 }
 
-shared_ptr<value_pair> parse_values_from(const path& p) {
+ref_ptr<value_pair> parse_values_from(const path& p) {
     if (!exists(p)) {
         throw parsing_error("the path does not exist: '%s'", p.c_str());
     } else if (!is_regular_file(p)) {
@@ -10,7 +10,6 @@
 #include "value.hpp"
 
 using std::istream;
-using std::shared_ptr;
 using std::string;
 using std::filesystem::path;
 
@@ -25,9 +24,9 @@ class parsing_error : public scheme_error {
 
 // parsing functions
 
-shared_ptr<value_pair> parse_values_from(istream& is);
-shared_ptr<value_pair> parse_values_from(const string& s);
-shared_ptr<value_pair> parse_values_from(const char* s);
-shared_ptr<value_pair> parse_values_from(const path& p);
+ref_ptr<value_pair> parse_values_from(istream& is);
+ref_ptr<value_pair> parse_values_from(const string& s);
+ref_ptr<value_pair> parse_values_from(const char* s);
+ref_ptr<value_pair> parse_values_from(const path& p);
 
 #endif  // PARSE_H_
@@ -4,7 +4,9 @@
 #include <string>
 #include <unordered_map>
 
-using std::shared_ptr;
+#include "compiler.hpp"
+#include "machine.hpp"
+
 using std::string;
 using std::unordered_map;
 
@@ -12,17 +14,17 @@ namespace {
 
 // helpers
 
-// shared_ptr<value_error> assert_num_args(const value_pair* args, size_t num_args) {
-//     if (args->length() != num_args) {
-//         return make_error(
-//             "expects %zu arg%s, but got %zu",
-//             num_args, (num_args == 1 ? "" : "s"), args->length());
-//     } else {
-//         return nullptr;
-//     }
-// }
+ref_ptr<value_error> assert_num_args(const value_pair* args, size_t num_args) {
+    if (args->length() != num_args) {
+        return make_error(
+            "expects %zu arg%s, but got %zu",
+            num_args, (num_args == 1 ? "" : "s"), args->length());
+    } else {
+        return nullptr;
+    }
+}
 
-shared_ptr<value_error> assert_min_args(const value_pair* args, size_t min_args) {
+ref_ptr<value_error> assert_min_args(const value_pair* args, size_t min_args) {
     if (args->length() < min_args) {
         return make_error(
             "expects at least %zu arg%s, but got %zu",
@@ -32,7 +34,7 @@ shared_ptr<value_error> assert_min_args(const value_pair* args, size_t min_args)
     }
 }
 
-// shared_ptr<value_error> assert_max_args(const value_pair* args, size_t max_args) {
+// ref_ptr<value_error> assert_max_args(const value_pair* args, size_t max_args) {
 //     if (args->length() > max_args) {
 //         return make_error(
 //             "expects at most %zu arg%s, but got %zu",
@@ -42,7 +44,7 @@ shared_ptr<value_error> assert_min_args(const value_pair* args, size_t min_args)
 //     }
 // }
 
-// shared_ptr<value_error> assert_arg_type(const value_pair* args, size_t ordinal, value_t type) {
+// ref_ptr<value_error> assert_arg_type(const value_pair* args, size_t ordinal, value_t type) {
 //     size_t running = ordinal;
 //     for (const auto& arg : *args) {
 //         if (running == 0) {
@@ -61,7 +63,7 @@ shared_ptr<value_error> assert_min_args(const value_pair* args, size_t min_args)
 //         ordinal, get_type_name(type));
 // }
 
-shared_ptr<value_error> assert_all_args_type(const value_pair* args, size_t offset, value_t type) {
+ref_ptr<value_error> assert_all_args_type(const value_pair* args, size_t offset, value_t type) {
     size_t ordinal = 0;
     for (const auto& arg : *args) {
         if (ordinal >= offset && arg.type() != type) {
@@ -74,7 +76,7 @@ shared_ptr<value_error> assert_all_args_type(const value_pair* args, size_t offs
     return nullptr;
 }
 
-// shared_ptr<value> get_optional_arg(const value_pair* args, size_t ordinal, const shared_ptr<value>& default_) {
+// value_ref get_optional_arg(const value_pair* args, size_t ordinal, const value_ref& default_) {
 //     while (args != nilptr) {
 //         if (ordinal == 0) {
 //             return args->car();
@@ -87,22 +89,22 @@ shared_ptr<value_error> assert_all_args_type(const value_pair* args, size_t offs
 
 // primitives
 
-shared_ptr<value> add(const value_pair* args) {
+value_ref add(const value_pair* args) {
     if (auto error = assert_min_args(args, 1)) {
         return error;
     } else if (auto error = assert_all_args_type(args, 0, value_t::number)) {
         return error;
     }
 
-    double result = *to_ptr<value_number>(args->car());
+    double result = args->car().number();
     for (const auto& arg : *args->pcdr()) {
-        result += reinterpret_cast<const value_number&>(arg);
+        result += arg.number();
     }
 
     return make_number(result);
 }
 
-shared_ptr<value> subtract(const value_pair* args) {
+value_ref subtract(const value_pair* args) {
     if (auto error = assert_min_args(args, 1)) {
         return error;
     } else if (auto error = assert_all_args_type(args, 0, value_t::number)) {
@@ -111,43 +113,43 @@ shared_ptr<value> subtract(const value_pair* args) {
 
     if (args->cdr() == nil) {
         // single argument: negate
-        double value = *to_ptr<value_number>(args->car());
+        double value = args->car().number();
         return make_number(-value);
     }
 
-    double result = *to_ptr<value_number>(args->car());
+    double result = args->car().number();
     for (const auto& arg : *args->pcdr()) {
-        result -= reinterpret_cast<const value_number&>(arg);
+        result -= arg.number();
     }
 
     return make_number(result);
 }
 
-shared_ptr<value> multiply(const value_pair* args) {
+value_ref multiply(const value_pair* args) {
     if (auto error = assert_min_args(args, 1)) {
         return error;
     } else if (auto error = assert_all_args_type(args, 0, value_t::number)) {
         return error;
     }
 
-    double result = *to_ptr<value_number>(args->car());
+    double result = args->car().number();
     for (const auto& arg : *args->pcdr()) {
-        result *= reinterpret_cast<const value_number&>(arg);
+        result *= arg.number();
     }
 
     return make_number(result);
 }
 
-shared_ptr<value> divide(const value_pair* args) {
+value_ref divide(const value_pair* args) {
     if (auto error = assert_min_args(args, 1)) {
         return error;
     } else if (auto error = assert_all_args_type(args, 0, value_t::number)) {
         return error;
     }
 
-    double result = *to_ptr<value_number>(args->car());
+    double result = args->car().number();
     for (const auto& arg : *args->pcdr()) {
-        double value = reinterpret_cast<const value_number&>(arg);
+        double value = arg.number();
         if (value == 0.0) {
             return make_error("division by zero");
         }
@@ -157,11 +159,36 @@ shared_ptr<value> divide(const value_pair* args) {
     return make_number(result);
 }
 
+value_ref compile_(const value_pair* args) {
+    if (auto error = assert_num_args(args, 1)) {
+        return error;
+    }
+
+    machine* m = machine::current();
+    if (m == nullptr) {
+        return make_error("no running machine");
+    }
+
+    // compile the expression into machine code
+    // target: place the result in the val register
+    // linkage: (goto (reg continue)) in the end
+    auto code = compile(args->car(), "val", "return");
+
+    // add the compiled code to the machine
+    // and continue from the code's start
+    m->append_and_jump(code);
+
+    // the return value here doesn't matter
+    // as the machine continues from the code
+    return nil;
+}
+
 const unordered_map<string, primitive_op> primitives{
     {"+", add},
     {"-", subtract},
     {"*", multiply},
     {"/", divide},
+    {"compile", compile_},
 };
 
 }  // namespace
@@ -7,13 +7,12 @@
 
 #include "value.hpp"
 
-using std::shared_ptr;
 using std::string;
 using std::unordered_map;
 
 // types
 
-using primitive_op = shared_ptr<value> (*)(const value_pair*);
+using primitive_op = value_ref (*)(const value_pair*);
 
 // exceptions
 
@@ -21,7 +21,6 @@ using std::cerr;
 using std::cout;
 using std::exception;
 using std::ref;
-using std::shared_ptr;
 using std::sort;
 using std::string;
 using std::vector;
@@ -39,7 +38,7 @@ void print_env(evaluator& e) {
     std::sort(names.begin(), names.end());
 
     for (const auto& name : names) {
-        cout << name << " = " << *env[name] << '\n';
+        cout << name << " = " << env[name] << '\n';
     }
 }
 
@@ -59,7 +58,7 @@ void set_trace(evaluator& e, const smatch& match) {
 void handle_repl_input(evaluator& e, const string& input, string& history) {
     try {
         // parse the input
-        shared_ptr<value_pair> list = parse_values_from(input);
+        ref_ptr<value_pair> list = parse_values_from(input);
         const value_pair* expressions = to_ptr<value_pair>(list);
 
         // save the clean history line
@@ -72,7 +71,7 @@ void handle_repl_input(evaluator& e, const string& input, string& history) {
                 // evaluate one exp at a time
                 auto exp = expressions->car();
                 auto result = e.evaluate(exp);
-                cout << *result << '\n';
+                cout << result << '\n';
             } catch (exception& e) {
                 auto error = make_error(e.what());
                 if (auto se = dynamic_cast<scheme_error*>(&e)) {
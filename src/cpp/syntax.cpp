@@ -9,8 +9,8 @@ using std::unordered_set;
 
 namespace {
 
-const value_pair* to_list(const shared_ptr<value>& v) {
-    if (v == nil || v->type() == value_t::pair) {
+const value_pair* to_list(const value_ref& v) {
+    if (v == nil || v.type() == value_t::pair) {
         auto pair = to_ptr<value_pair>(v);
         return (pair->is_list() ? pair : nullptr);
     } else {
@@ -18,19 +18,14 @@ const value_pair* to_list(const shared_ptr<value>& v) {
     }
 }
 
-const value_pair* to_list(const value& v) {
-    if (v.type() == value_t::pair) {
-        auto pair = reinterpret_cast<const value_pair*>(&v);
-        return (pair->is_list() ? pair : nullptr);
-    } else {
-        return nullptr;
-    }
+const value_pair* to_nonempty_list(const value_ref& v) {
+    return (v.type() == value_t::pair ? to_list(v) : nullptr);
 }
 
-bool is_tagged_pair(const shared_ptr<value>& v, const string& tag) {
-    if (v->type() == value_t::pair) {
+bool is_tagged_pair(const value_ref& v, const string& tag) {
+    if (v.type() == value_t::pair) {
         auto car = to_ptr<value_pair>(v)->car();
-        return (car->type() == value_t::symbol &&
+        return (car.type() == value_t::symbol &&
                 to_ptr<value_symbol>(car)->symbol() == tag);
     } else {
         return false;
@@ -38,11 +33,11 @@ bool is_tagged_pair(const shared_ptr<value>& v, const string& tag) {
 }
 
 bool is_else_clause(const value_pair* clause) {
-    return (clause->car()->type() == value_t::symbol &&
+    return (clause->car().type() == value_t::symbol &&
             to_ptr<value_symbol>(clause->car())->symbol() == "else");
 }
 
-shared_ptr<value> transform_cond_rec(const value_pair* clauses) {
+value_ref transform_cond_rec(const value_pair* clauses) {
     if (clauses == nilptr) {
         return false_;  // false if no else clause
     }
@@ -60,7 +55,7 @@ shared_ptr<value> transform_cond_rec(const value_pair* clauses) {
 
 }  // namespace
 
-bool is_self_evaluating(const shared_ptr<value>& v) {
+bool is_self_evaluating(const value_ref& v) {
     static unordered_set<value_t> self_evaluating_types = {
         value_t::nil,
         value_t::number,
@@ -69,138 +64,138 @@ bool is_self_evaluating(const shared_ptr<value>& v) {
         value_t::primitive_op,
     };
 
-    return self_evaluating_types.count(v->type());
+    return self_evaluating_types.count(v.type());
 }
 
-bool is_variable(const shared_ptr<value>& v) {
-    return v->type() == value_t::symbol;
+bool is_variable(const value_ref& v) {
+    return v.type() == value_t::symbol;
 }
 
-bool is_quoted(const shared_ptr<value>& v) {
+bool is_quoted(const value_ref& v) {
     return is_tagged_pair(v, "quote");
 }
 
-bool is_assignment(const shared_ptr<value>& v) {
+bool is_assignment(const value_ref& v) {
     return is_tagged_pair(v, "set!");
 }
 
-bool is_definition(const shared_ptr<value>& v) {
+bool is_definition(const value_ref& v) {
     return is_tagged_pair(v, "define");
 }
 
-bool is_if(const shared_ptr<value>& v) {
+bool is_if(const value_ref& v) {
     return is_tagged_pair(v, "if");
 }
 
-bool is_lambda(const shared_ptr<value>& v) {
+bool is_lambda(const value_ref& v) {
     return is_tagged_pair(v, "lambda");
 }
 
-bool is_let(const shared_ptr<value>& v) {
+bool is_let(const value_ref& v) {
     return is_tagged_pair(v, "let");
 }
 
-bool is_begin(const shared_ptr<value>& v) {
+bool is_begin(const value_ref& v) {
     return is_tagged_pair(v, "begin");
 }
 
-bool is_cond(const shared_ptr<value>& v) {
+bool is_cond(const value_ref& v) {
     return is_tagged_pair(v, "cond");
 }
 
-bool is_and(const shared_ptr<value>& v) {
+bool is_and(const value_ref& v) {
     return is_tagged_pair(v, "and");
 }
 
-bool is_or(const shared_ptr<value>& v) {
+bool is_or(const value_ref& v) {
     return is_tagged_pair(v, "or");
 }
 
-bool is_eval(const shared_ptr<value>& v) {
+bool is_eval(const value_ref& v) {
     return is_tagged_pair(v, "eval");
 }
 
-bool is_apply(const shared_ptr<value>& v) {
+bool is_apply(const value_ref& v) {
     return is_tagged_pair(v, "apply");
 }
 
-void check_quoted(const shared_ptr<value>& exp) {
+void check_quoted(const value_ref& exp) {
     // (quote x)
     auto quoted = to_list(exp);
     if (!quoted) {
-        throw syntax_error("quote: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("quote: non-list structure in %s", exp.str().c_str());
     } else if (quoted->cdr() == nil) {
-        throw syntax_error("quote: no expression in %s", exp->str().c_str());
+        throw syntax_error("quote: no expression in %s", exp.str().c_str());
     } else if (quoted->pcdr()->cdr() != nil) {
-        throw syntax_error("quote: more than one item in %s", exp->str().c_str());
+        throw syntax_error("quote: more than one item in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_text_of_quotation(const shared_ptr<value>& quoted) {
+value_ref get_text_of_quotation(const value_ref& quoted) {
     // x from (quote x)
     return to_ptr<value_pair>(quoted)->pcdr()->car();
 }
 
-void check_assignment(const shared_ptr<value>& exp) {
+void check_assignment(const value_ref& exp) {
     // (!set variable value)
     auto assignment = to_list(exp);
     if (!assignment) {
-        throw syntax_error("set!: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("set!: non-list structure in %s", exp.str().c_str());
     } else if (assignment->cdr() == nil) {
-        throw syntax_error("set!: no variable in %s", exp->str().c_str());
-    } else if (assignment->pcdr()->car()->type() != value_t::symbol) {
-        throw syntax_error("set!: variable is not a symbol in %s", exp->str().c_str());
+        throw syntax_error("set!: no variable in %s", exp.str().c_str());
+    } else if (assignment->pcdr()->car().type() != value_t::symbol) {
+        throw syntax_error("set!: variable is not a symbol in %s", exp.str().c_str());
     } else if (assignment->pcdr()->cdr() == nil) {
-        throw syntax_error("set!: no value in %s", exp->str().c_str());
+        throw syntax_error("set!: no value in %s", exp.str().c_str());
     } else if (assignment->pcdr()->pcdr()->cdr() != nil) {
-        throw syntax_error("set!: more than two items in %s", exp->str().c_str());
+        throw syntax_error("set!: more than two items in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_assignment_variable(const shared_ptr<value>& assignment) {
+value_ref get_assignment_variable(const value_ref& assignment) {
     // x from (set! x 10)
     return to_ptr<value_pair>(assignment)->pcdr()->car();
 }
 
-shared_ptr<value> get_assignment_value(const shared_ptr<value>& assignment) {
+value_ref get_assignment_value(const value_ref& assignment) {
     // 10 from (set! x 10)
     return to_ptr<value_pair>(assignment)->pcdr()->pcdr()->car();
 }
 
-void check_definition(const shared_ptr<value>& exp) {
+void check_definition(const value_ref& exp) {
     // (define x 10)
     // (define (f x y) (+ x y) x)
     auto definition = to_list(exp);
     if (!definition) {
-        throw syntax_error("define: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("define: non-list structure in %s", exp.str().c_str());
     } else if (definition->cdr() == nil) {
-        throw syntax_error("define: no variable in %s", exp->str().c_str());
-    } else if (definition->pcdr()->car()->type() == value_t::pair) {
+        throw syntax_error("define: no variable in %s", exp.str().c_str());
+    } else if (definition->pcdr()->car().type() == value_t::pair) {
         if (definition->pcdr()->cdr() == nil) {
-            throw syntax_error("define: no body in %s", exp->str().c_str());
-        } else if (definition->pcdr()->pcar()->car()->type() != value_t::symbol) {
+            throw syntax_error("define: no body in %s", exp.str().c_str());
+        } else if (definition->pcdr()->pcar()->car().type() != value_t::symbol) {
             throw syntax_error(
                 "define: the function name is not a symbol in %s",
-                exp->str().c_str());
+                exp.str().c_str());
         }
-    } else if (definition->pcdr()->car()->type() == value_t::symbol) {
+    } else if (definition->pcdr()->car().type() == value_t::symbol) {
         if (definition->pcdr()->cdr() == nil) {
-            throw syntax_error("define: no value in %s", exp->str().c_str());
+            throw syntax_error("define: no value in %s", exp.str().c_str());
         } else if (definition->pcdr()->pcdr()->cdr() != nil) {
             throw syntax_error(
                 "define: the value can't be more than one item in %s",
-                exp->str().c_str());
+                exp.str().c_str());
         }
     } else {
         throw syntax_error(
             "define: either variable or function must be defined in %s",
-            exp->str().c_str());
+            exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_definition_variable(const shared_ptr<value>& definition) {
+value_ref get_definition_variable(const value_ref& definition) {
     auto def_list = to_ptr<value_pair>(definition);
-    if (def_list->pcdr()->car()->type() == value_t::symbol) {
+    if (def_list->pcdr()->car().type() == value_t::symbol) {
         // x from (define x 10)
         return def_list->pcdr()->car();
     } else {
@@ -209,9 +204,9 @@ shared_ptr<value> get_definition_variable(const shared_ptr<value>& definition) {
     }
 }
 
-shared_ptr<value> get_definition_value(const shared_ptr<value>& definition) {
+value_ref get_definition_value(const value_ref& definition) {
     auto def_list = to_ptr<value_pair>(definition);
-    if (def_list->pcdr()->car()->type() == value_t::symbol) {
+    if (def_list->pcdr()->car().type() == value_t::symbol) {
         // 10 from (define x 10)
         return def_list->pcdr()->pcdr()->car();
     } else {
@@ -222,33 +217,33 @@ shared_ptr<value> get_definition_value(const shared_ptr<value>& definition) {
     }
 }
 
-void check_if(const shared_ptr<value>& exp) {
+void check_if(const value_ref& exp) {
     // (if x 1)
     // (if x 1 2)
     auto if_ = to_list(exp);
     if (!if_) {
-        throw syntax_error("if: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("if: non-list structure in %s", exp.str().c_str());
     } else if (if_->cdr() == nil) {
-        throw syntax_error("if: no predicate in %s", exp->str().c_str());
+        throw syntax_error("if: no predicate in %s", exp.str().c_str());
     } else if (if_->pcdr()->cdr() == nil) {
-        throw syntax_error("if: no consequent in %s", exp->str().c_str());
+        throw syntax_error("if: no consequent in %s", exp.str().c_str());
     } else if (if_->pcdr()->pcdr()->cdr() != nil &&
                if_->pcdr()->pcdr()->pcdr()->cdr() != nil) {
-        throw syntax_error("if: too many items in %s", exp->str().c_str());
+        throw syntax_error("if: too many items in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_if_predicate(const shared_ptr<value>& if_) {
+value_ref get_if_predicate(const value_ref& if_) {
     // x from (if x 1 2) or (if x 1)
     return to_ptr<value_pair>(if_)->pcdr()->car();
 }
 
-shared_ptr<value> get_if_consequent(const shared_ptr<value>& if_) {
+value_ref get_if_consequent(const value_ref& if_) {
     // 1 from (if x 1 2) or (if x 1)
     return to_ptr<value_pair>(if_)->pcdr()->pcdr()->car();
 }
 
-shared_ptr<value> get_if_alternative(const shared_ptr<value>& if_) {
+value_ref get_if_alternative(const value_ref& if_) {
     auto if_list = to_ptr<value_pair>(if_);
     if (if_list->pcdr()->pcdr()->cdr() != nil) {
         // 2 from (if x 1 2)
@@ -260,10 +255,10 @@ shared_ptr<value> get_if_alternative(const shared_ptr<value>& if_) {
     }
 }
 
-shared_ptr<value> make_if(
-    const shared_ptr<value>& predicate,
-    const shared_ptr<value>& consequent,
-    const shared_ptr<value>& alternative) {
+value_ref make_if(
+    const value_ref& predicate,
+    const value_ref& consequent,
+    const value_ref& alternative) {
     // x, 1, 2 -> (if x 1 2)
     return make_list(
         "if",
@@ -272,58 +267,58 @@ shared_ptr<value> make_if(
         alternative);
 }
 
-void check_lambda(const shared_ptr<value>& exp) {
+void check_lambda(const value_ref& exp) {
     // (lambda (p1 p2 ...) e1 e2 ...)
     auto lambda = to_list(exp);
     if (!lambda) {
-        throw syntax_error("lambda: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("lambda: non-list structure in %s", exp.str().c_str());
     } else if (lambda->cdr() == nil) {
-        throw syntax_error("lambda: no parameters in %s", exp->str().c_str());
+        throw syntax_error("lambda: no parameters in %s", exp.str().c_str());
     } else if (lambda->pcdr()->cdr() == nil) {
-        throw syntax_error("lambda: no body in %s", exp->str().c_str());
+        throw syntax_error("lambda: no body in %s", exp.str().c_str());
     } else {
-        value_t params_type = lambda->pcdr()->car()->type();
+        value_t params_type = lambda->pcdr()->car().type();
         if (params_type == value_t::nil || params_type == value_t::symbol) {
             // no parameters or a symbol: stop here
             return;
-        } else if (lambda->pcdr()->car()->type() == value_t::pair) {
+        } else if (lambda->pcdr()->car().type() == value_t::pair) {
             // parameters are a (possibly non-nil-terminated) list
             unordered_set<string> seen;
             for (const auto& param : *lambda->pcdr()->pcar()) {
                 if (param.type() != value_t::symbol) {
                     throw syntax_error(
                         "lambda: some parameters are not symbols in %s",
-                        exp->str().c_str());
+                        exp.str().c_str());
                 }
-                auto name = reinterpret_cast<const value_symbol&>(param).symbol();
+                auto name = to_ptr<value_symbol>(param)->symbol();
                 if (seen.count(name) > 0) {
                     throw syntax_error(
                         "lambda: duplicate parameter names in %s",
-                        exp->str().c_str());
+                        exp.str().c_str());
                 }
                 seen.insert(name);
             }
         } else {
             throw syntax_error(
                 "lambda: some parameters are not symbols in %s",
-                exp->str().c_str());
+                exp.str().c_str());
         }
     }
 }
 
-shared_ptr<value> get_lambda_parameters(const shared_ptr<value>& lambda) {
+value_ref get_lambda_parameters(const value_ref& lambda) {
     // (p1 p2 ...) from (lambda (p1 p2 ...) e1 e2 ...)
     return to_ptr<value_pair>(lambda)->pcdr()->car();
 }
 
-shared_ptr<value> get_lambda_body(const shared_ptr<value>& lambda) {
+value_ref get_lambda_body(const value_ref& lambda) {
     // (e1 e2 ...) from (lambda (p1 p2 ...) e1 e2 ...)
     return to_ptr<value_pair>(lambda)->pcdr()->cdr();
 }
 
-shared_ptr<value> make_lambda(
-    const shared_ptr<value>& params,
-    const shared_ptr<value>& body) {
+value_ref make_lambda(
+    const value_ref& params,
+    const value_ref& body) {
     // (p1 p2 ...), (e1 e2 ...) -> (lambda (p1 p2 ...) e1 e2 ...)
     return make_vpair(
         "lambda",
@@ -332,49 +327,49 @@ shared_ptr<value> make_lambda(
             body));
 }
 
-void check_let(const shared_ptr<value>& exp) {
+void check_let(const value_ref& exp) {
     // (let ((x 1) (y 2)) (+ x y) x)
     auto let = to_list(exp);
     if (!let) {
-        throw syntax_error("let: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("let: non-list structure in %s", exp.str().c_str());
     } else if (let->cdr() == nil) {
-        throw syntax_error("let: no variables in %s", exp->str().c_str());
+        throw syntax_error("let: no variables in %s", exp.str().c_str());
     } else if (let->pcdr()->cdr() == nil) {
-        throw syntax_error("let: no body in %s", exp->str().c_str());
+        throw syntax_error("let: no body in %s", exp.str().c_str());
     }
     auto variables = to_list(let->pcdr()->car());
     if (!variables) {
-        throw syntax_error("let: non-list variables in %s", exp->str().c_str());
+        throw syntax_error("let: non-list variables in %s", exp.str().c_str());
     }
     for (const auto& variable : *variables) {
-        auto pair = to_list(variable);
+        auto pair = to_nonempty_list(variable);
         if (!pair) {
-            throw syntax_error("let: non-list variable pair in %s", exp->str().c_str());
-        } else if (pair->car()->type() != value_t::symbol) {
-            throw syntax_error("let: variable name must be a symbol in %s", exp->str().c_str());
+            throw syntax_error("let: non-list variable pair in %s", exp.str().c_str());
+        } else if (pair->car().type() != value_t::symbol) {
+            throw syntax_error("let: variable name must be a symbol in %s", exp.str().c_str());
         } else if (pair->cdr() == nil) {
-            throw syntax_error("let: no variable value in %s", exp->str().c_str());
+            throw syntax_error("let: no variable value in %s", exp.str().c_str());
         } else if (pair->pcdr()->cdr() != nil) {
-            throw syntax_error("let: too many items in a variable pair in %s", exp->str().c_str());
+            throw syntax_error("let: too many items in a variable pair in %s", exp.str().c_str());
         }
     }
 }
 
-shared_ptr<value> transform_let(const shared_ptr<value>& let) {
+value_ref transform_let(const value_ref& let) {
     // (let ((x 1) (y 2)) (+ x y) x) -> ((lambda (x y) (+ x y) x) 1 2)
-    shared_ptr<value_pair> params;
-    shared_ptr<value_pair> params_tail;
-    shared_ptr<value_pair> args;
-    shared_ptr<value_pair> args_tail;
+    ref_ptr<value_pair> params;
+    ref_ptr<value_pair> params_tail;
+    ref_ptr<value_pair> args;
+    ref_ptr<value_pair> args_tail;
 
     auto let_list = to_ptr<value_pair>(let);
     auto body = let_list->pcdr()->cdr();
 
     for (const auto& variable : *let_list->pcdr()->pcar()) {
-        auto& param_and_arg = reinterpret_cast<const value_pair&>(variable);
+        auto param_and_arg = to_ptr<value_pair>(variable);
 
         // append to params
-        auto next_param = make_vpair(param_and_arg.car(), nil);
+        auto next_param = make_vpair(param_and_arg->car(), nil);
         if (!params_tail) {
             params = next_param;
         } else {
@@ -383,7 +378,7 @@ shared_ptr<value> transform_let(const shared_ptr<value>& let) {
         params_tail = next_param;
 
         // append to args
-        auto next_arg = make_vpair(param_and_arg.pcdr()->car(), nil);
+        auto next_arg = make_vpair(param_and_arg->pcdr()->car(), nil);
         if (!args_tail) {
             args = next_arg;
         } else {
@@ -401,22 +396,22 @@ shared_ptr<value> transform_let(const shared_ptr<value>& let) {
     }
 }
 
-void check_begin(const shared_ptr<value>& exp) {
+void check_begin(const value_ref& exp) {
     // (begin e1 e2 ...)
     auto begin = to_list(exp);
     if (!begin) {
-        throw syntax_error("begin: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("begin: non-list structure in %s", exp.str().c_str());
     } else if (begin->cdr() == nil) {
-        throw syntax_error("begin: no expressions in %s", exp->str().c_str());
+        throw syntax_error("begin: no expressions in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_begin_actions(const shared_ptr<value>& begin) {
+value_ref get_begin_actions(const value_ref& begin) {
     // (e1 e2 ...) from (begin e1 e2 ...)
     return to_ptr<value_pair>(begin)->cdr();
 }
 
-shared_ptr<value> transform_sequence(const shared_ptr<value>& seq) {
+value_ref transform_sequence(const value_ref& seq) {
     if (seq == nil) {
         // () -> ()
         return seq;
@@ -431,178 +426,178 @@ shared_ptr<value> transform_sequence(const shared_ptr<value>& seq) {
     }
 }
 
-void check_cond(const shared_ptr<value>& exp) {
+void check_cond(const value_ref& exp) {
     // (cond (p1 e11 e12 ...) (p2 e21 e22 ...) ...)
     // (cond (p1 e11 e12 ...) (p2 e21 e22 ...) ... (else ee1 ee2 ...))
     auto cond = to_list(exp);
     if (!cond) {
-        throw syntax_error("cond: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("cond: non-list structure in %s", exp.str().c_str());
     } else if (cond->cdr() == nil) {
-        throw syntax_error("cond: no clauses in %s", exp->str().c_str());
+        throw syntax_error("cond: no clauses in %s", exp.str().c_str());
     }
     bool else_clause_seen = false;
     for (const auto& clause : *cond->pcdr()) {
         if (else_clause_seen) {
-            throw syntax_error("cond: else clause must be the last in %s", exp->str().c_str());
+            throw syntax_error("cond: else clause must be the last in %s", exp.str().c_str());
         } else if (clause.type() == value_t::nil) {
-            throw syntax_error("cond: empty clause in %s", exp->str().c_str());
+            throw syntax_error("cond: empty clause in %s", exp.str().c_str());
         }
-        auto clause_list = to_list(clause);
+        auto clause_list = to_nonempty_list(clause);
         if (!clause_list) {
-            throw syntax_error("cond: non-list clause in %s", exp->str().c_str());
+            throw syntax_error("cond: non-list clause in %s", exp.str().c_str());
         } else if (clause_list->cdr() == nil) {
-            throw syntax_error("cond: clause without consequent in %s", exp->str().c_str());
+            throw syntax_error("cond: clause without consequent in %s", exp.str().c_str());
         } else if (is_else_clause(clause_list)) {
             else_clause_seen = true;  // else clause must be in the end
         }
     }
 }
 
-shared_ptr<value> transform_cond(const shared_ptr<value>& cond) {
+value_ref transform_cond(const value_ref& cond) {
     // (cond (p1 e1) (p2 e21 e22) (else ee1) -> (if p1 e1 (if p2 (begin e21 e22) ee1))
     // (cond (p1 e1) (p2 e21 e22) -> (if p1 e1 (if p2 (begin e21 e22) false))
     return transform_cond_rec(to_ptr<value_pair>(cond)->pcdr());
 }
 
-void check_and(const shared_ptr<value>& exp) {
+void check_and(const value_ref& exp) {
     // (and ...)
     if (!to_list(exp)) {
-        throw syntax_error("and: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("and: non-list structure in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_and_expressions(const shared_ptr<value>& and_) {
+value_ref get_and_expressions(const value_ref& and_) {
     // (...) from (and ...)
     return to_ptr<value_pair>(and_)->cdr();
 }
 
-void check_or(const shared_ptr<value>& exp) {
+void check_or(const value_ref& exp) {
     // (or ...)
     if (!to_list(exp)) {
-        throw syntax_error("or: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("or: non-list structure in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_or_expressions(const shared_ptr<value>& or_) {
+value_ref get_or_expressions(const value_ref& or_) {
     // (...) from (or ...)
     return to_ptr<value_pair>(or_)->cdr();
 }
 
-void check_eval(const shared_ptr<value>& exp) {
+void check_eval(const value_ref& exp) {
     // (eval e)
     auto eval = to_list(exp);
     if (!eval) {
-        throw syntax_error("eval: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("eval: non-list structure in %s", exp.str().c_str());
     } else if (eval->cdr() == nil) {
-        throw syntax_error("eval: no expression in %s", exp->str().c_str());
+        throw syntax_error("eval: no expression in %s", exp.str().c_str());
     } else if (eval->pcdr()->cdr() != nil) {
-        throw syntax_error("eval: too many items in %s", exp->str().c_str());
+        throw syntax_error("eval: too many items in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_eval_expression(const shared_ptr<value>& eval) {
+value_ref get_eval_expression(const value_ref& eval) {
     // e from (eval e)
     return to_ptr<value_pair>(eval)->pcdr()->car();
 }
 
-void check_apply(const shared_ptr<value>& exp) {
+void check_apply(const value_ref& exp) {
     // (apply f (a1 a2 ...))
     auto apply = to_list(exp);
     if (!apply) {
-        throw syntax_error("apply: non-list structure in %s", exp->str().c_str());
+        throw syntax_error("apply: non-list structure in %s", exp.str().c_str());
     } else if (apply->cdr() == nil) {
-        throw syntax_error("apply: no operator in %s", exp->str().c_str());
+        throw syntax_error("apply: no operator in %s", exp.str().c_str());
     } else if (apply->pcdr()->cdr() == nil) {
-        throw syntax_error("apply: no arguments in %s", exp->str().c_str());
+        throw syntax_error("apply: no arguments in %s", exp.str().c_str());
     } else if (apply->pcdr()->pcdr()->cdr() != nil) {
-        throw syntax_error("apply: too many items in %s", exp->str().c_str());
+        throw syntax_error("apply: too many items in %s", exp.str().c_str());
     }
 }
 
-shared_ptr<value> get_apply_operator(const shared_ptr<value>& apply) {
+value_ref get_apply_operator(const value_ref& apply) {
     // f from (apply f (a1 a2 ...))
     return to_ptr<value_pair>(apply)->pcdr()->car();
 }
 
-shared_ptr<value> get_apply_arguments(const shared_ptr<value>& apply) {
+value_ref get_apply_arguments(const value_ref& apply) {
     // (a1 a2 ...) from (apply f (a1 a2 ...))
     return to_ptr<value_pair>(apply)->pcdr()->pcdr()->car();
 }
 
-void check_apply_arguments(const shared_ptr<value>& args) {
+void check_apply_arguments(const value_ref& args) {
     // (...)
     if (!to_list(args)) {
-        throw syntax_error("apply: can't apply to %s", args->str().c_str());
+        throw syntax_error("apply: can't apply to %s", args.str().c_str());
     }
 }
 
-void check_application(const shared_ptr<value>& exp) {
+void check_application(const value_ref& exp) {
     // (f ...) with any f
     if (exp == nil) {
-        throw syntax_error("bad application %s", exp->str().c_str());
+        throw syntax_error("bad application %s", exp.str().c_str());
     } else if (!to_list(exp)) {
-        throw syntax_error("can't apply to %s", to_ptr<value_pair>(exp)->cdr()->str().c_str());
+        throw syntax_error("can't apply to %s", to_ptr<value_pair>(exp)->cdr().str().c_str());
     }
 }
 
-bool has_no_exps(const shared_ptr<value>& seq) {
+bool has_no_exps(const value_ref& seq) {
     // ()
     return seq == nil;
 }
 
-bool is_last_exp(const shared_ptr<value>& seq) {
+bool is_last_exp(const value_ref& seq) {
     // (e)
     return to_ptr<value_pair>(seq)->cdr() == nil;
 }
 
-shared_ptr<value> get_first_exp(const shared_ptr<value>& seq) {
+value_ref get_first_exp(const value_ref& seq) {
     // e1 from (e1 e2 ...)
     return to_ptr<value_pair>(seq)->car();
 }
 
-shared_ptr<value> get_rest_exps(const shared_ptr<value>& seq) {
+value_ref get_rest_exps(const value_ref& seq) {
     // (e2 ...) from (e1 e2 ...)
     return to_ptr<value_pair>(seq)->cdr();
 }
 
-shared_ptr<value> get_operator(const shared_ptr<value>& compound) {
+value_ref get_operator(const value_ref& compound) {
     // f from (f p1 p2 ...)
     return to_ptr<value_pair>(compound)->car();
 }
 
-shared_ptr<value> get_operands(const shared_ptr<value>& compound) {
+value_ref get_operands(const value_ref& compound) {
     // (p1 p2 ...) from (f p1 p2 ...)
     return to_ptr<value_pair>(compound)->cdr();
 }
 
-bool has_no_operands(const shared_ptr<value>& operands) {
+bool has_no_operands(const value_ref& operands) {
     // ()
     return operands == nil;
 }
 
-bool is_last_operand(const shared_ptr<value>& operands) {
+bool is_last_operand(const value_ref& operands) {
     // (o)
     return to_ptr<value_pair>(operands)->cdr() == nil;
 }
 
-shared_ptr<value> get_first_operand(const shared_ptr<value>& operands) {
+value_ref get_first_operand(const value_ref& operands) {
     // o1 from (o1 o2 ...)
     return to_ptr<value_pair>(operands)->car();
 }
 
-shared_ptr<value> get_rest_operands(const shared_ptr<value>& operands) {
+value_ref get_rest_operands(const value_ref& operands) {
     // (o2 ...) from (o1 o2 ...)
     return to_ptr<value_pair>(operands)->cdr();
 }
 
-shared_ptr<value> make_empty_arglist() {
+value_ref make_empty_arglist() {
     // ()
     return nil;
 }
 
-shared_ptr<value> adjoin_arg(
-    const shared_ptr<value>& arg,
-    const shared_ptr<value>& arg_list) {
+value_ref adjoin_arg(
+    const value_ref& arg,
+    const value_ref& arg_list) {
     // a, () -> (a)
     // a, (a1 a2 .. an) -> (a1 a2 ... an a)
     auto new_arg = make_vpair(arg, nil);
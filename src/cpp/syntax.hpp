@@ -15,90 +15,90 @@ class syntax_error : public scheme_error {
 
 // helper functions
 
-bool is_self_evaluating(const shared_ptr<value>& exp);
-bool is_variable(const shared_ptr<value>& exp);
-bool is_quoted(const shared_ptr<value>& exp);
-bool is_assignment(const shared_ptr<value>& exp);
-bool is_definition(const shared_ptr<value>& exp);
-bool is_if(const shared_ptr<value>& exp);
-bool is_lambda(const shared_ptr<value>& exp);
-bool is_let(const shared_ptr<value>& exp);
-bool is_begin(const shared_ptr<value>& exp);
-bool is_cond(const shared_ptr<value>& exp);
-bool is_and(const shared_ptr<value>& exp);
-bool is_or(const shared_ptr<value>& exp);
-bool is_eval(const shared_ptr<value>& exp);
-bool is_apply(const shared_ptr<value>& exp);
-
-void check_quoted(const shared_ptr<value>& exp);
-shared_ptr<value> get_text_of_quotation(const shared_ptr<value>& quoted);
-
-void check_assignment(const shared_ptr<value>& exp);
-shared_ptr<value> get_assignment_variable(const shared_ptr<value>& assignment);
-shared_ptr<value> get_assignment_value(const shared_ptr<value>& assignment);
-
-void check_definition(const shared_ptr<value>& exp);
-shared_ptr<value> get_definition_variable(const shared_ptr<value>& definition);
-shared_ptr<value> get_definition_value(const shared_ptr<value>& definition);
-
-void check_if(const shared_ptr<value>& exp);
-shared_ptr<value> get_if_predicate(const shared_ptr<value>& if_);
-shared_ptr<value> get_if_consequent(const shared_ptr<value>& if_);
-shared_ptr<value> get_if_alternative(const shared_ptr<value>& if_);
-shared_ptr<value> make_if(
-    const shared_ptr<value>& predicate,
-    const shared_ptr<value>& consequent,
-    const shared_ptr<value>& alternative);
-
-void check_lambda(const shared_ptr<value>& exp);
-shared_ptr<value> get_lambda_parameters(const shared_ptr<value>& lambda);
-shared_ptr<value> get_lambda_body(const shared_ptr<value>& lambda);
-shared_ptr<value> make_lambda(
-    const shared_ptr<value>& params,
-    const shared_ptr<value>& body);
-
-void check_let(const shared_ptr<value>& exp);
-shared_ptr<value> transform_let(const shared_ptr<value>& let);
-
-void check_begin(const shared_ptr<value>& exp);
-shared_ptr<value> get_begin_actions(const shared_ptr<value>& begin);
-shared_ptr<value> transform_sequence(const shared_ptr<value>& seq);
-
-void check_cond(const shared_ptr<value>& exp);
-shared_ptr<value> transform_cond(const shared_ptr<value>& cond);
-
-void check_and(const shared_ptr<value>& exp);
-shared_ptr<value> get_and_expressions(const shared_ptr<value>& and_);
-
-void check_or(const shared_ptr<value>& exp);
-shared_ptr<value> get_or_expressions(const shared_ptr<value>& or_);
-
-void check_eval(const shared_ptr<value>& exp);
-shared_ptr<value> get_eval_expression(const shared_ptr<value>& eval);
-
-void check_apply(const shared_ptr<value>& exp);
-shared_ptr<value> get_apply_operator(const shared_ptr<value>& apply);
-shared_ptr<value> get_apply_arguments(const shared_ptr<value>& apply);
-void check_apply_arguments(const shared_ptr<value>& args);
-
-void check_application(const shared_ptr<value>& exp);
-
-bool has_no_exps(const shared_ptr<value>& seq);
-bool is_last_exp(const shared_ptr<value>& seq);
-shared_ptr<value> get_first_exp(const shared_ptr<value>& seq);
-shared_ptr<value> get_rest_exps(const shared_ptr<value>& seq);
-
-shared_ptr<value> get_operator(const shared_ptr<value>& compound);
-shared_ptr<value> get_operands(const shared_ptr<value>& compound);
-
-bool has_no_operands(const shared_ptr<value>& operands);
-bool is_last_operand(const shared_ptr<value>& operands);
-shared_ptr<value> get_first_operand(const shared_ptr<value>& operands);
-shared_ptr<value> get_rest_operands(const shared_ptr<value>& operands);
-
-shared_ptr<value> make_empty_arglist();
-shared_ptr<value> adjoin_arg(
-    const shared_ptr<value>& arg,
-    const shared_ptr<value>& arg_list);
+bool is_self_evaluating(const value_ref& exp);
+bool is_variable(const value_ref& exp);
+bool is_quoted(const value_ref& exp);
+bool is_assignment(const value_ref& exp);
+bool is_definition(const value_ref& exp);
+bool is_if(const value_ref& exp);
+bool is_lambda(const value_ref& exp);
+bool is_let(const value_ref& exp);
+bool is_begin(const value_ref& exp);
+bool is_cond(const value_ref& exp);
+bool is_and(const value_ref& exp);
+bool is_or(const value_ref& exp);
+bool is_eval(const value_ref& exp);
+bool is_apply(const value_ref& exp);
+
+void check_quoted(const value_ref& exp);
+value_ref get_text_of_quotation(const value_ref& quoted);
+
+void check_assignment(const value_ref& exp);
+value_ref get_assignment_variable(const value_ref& assignment);
+value_ref get_assignment_value(const value_ref& assignment);
+
+void check_definition(const value_ref& exp);
+value_ref get_definition_variable(const value_ref& definition);
+value_ref get_definition_value(const value_ref& definition);
+
+void check_if(const value_ref& exp);
+value_ref get_if_predicate(const value_ref& if_);
+value_ref get_if_consequent(const value_ref& if_);
+value_ref get_if_alternative(const value_ref& if_);
+value_ref make_if(
+    const value_ref& predicate,
+    const value_ref& consequent,
+    const value_ref& alternative);
+
+void check_lambda(const value_ref& exp);
+value_ref get_lambda_parameters(const value_ref& lambda);
+value_ref get_lambda_body(const value_ref& lambda);
+value_ref make_lambda(
+    const value_ref& params,
+    const value_ref& body);
+
+void check_let(const value_ref& exp);
+value_ref transform_let(const value_ref& let);
+
+void check_begin(const value_ref& exp);
+value_ref get_begin_actions(const value_ref& begin);
+value_ref transform_sequence(const value_ref& seq);
+
+void check_cond(const value_ref& exp);
+value_ref transform_cond(const value_ref& cond);
+
+void check_and(const value_ref& exp);
+value_ref get_and_expressions(const value_ref& and_);
+
+void check_or(const value_ref& exp);
+value_ref get_or_expressions(const value_ref& or_);
+
+void check_eval(const value_ref& exp);
+value_ref get_eval_expression(const value_ref& eval);
+
+void check_apply(const value_ref& exp);
+value_ref get_apply_operator(const value_ref& apply);
+value_ref get_apply_arguments(const value_ref& apply);
+void check_apply_arguments(const value_ref& args);
+
+void check_application(const value_ref& exp);
+
+bool has_no_exps(const value_ref& seq);
+bool is_last_exp(const value_ref& seq);
+value_ref get_first_exp(const value_ref& seq);
+value_ref get_rest_exps(const value_ref& seq);
+
+value_ref get_operator(const value_ref& compound);
+value_ref get_operands(const value_ref& compound);
+
+bool has_no_operands(const value_ref& operands);
+bool is_last_operand(const value_ref& operands);
+value_ref get_first_operand(const value_ref& operands);
+value_ref get_rest_operands(const value_ref& operands);
+
+value_ref make_empty_arglist();
+value_ref adjoin_arg(
+    const value_ref& arg,
+    const value_ref& arg_list);
 
 #endif  // SYNTAX_HPP_
@@ -109,6 +109,18 @@ void assert_to_str(const value& v, const string& expected, string v_str) {
     }
 }
 
+void assert_to_str(const value_ref& v, const string& expected, string v_str) {
+    string str_result = v.str();
+
+    report_test(BLUE("[") + v_str + BLUE("] --> [") + str_result + BLUE("]"));
+
+    if (str_result != expected) {
+        // string version of v is not equal to the expected
+        cerr << RED("expected \"" + expected + "\"") << '\n';
+        throw test_error();
+    }
+}
+
 void assert_iterator(const value_pair& v, const string& str_expected, string v_str) {
     // join v's items with ", "
     string str_result;
@@ -128,9 +140,9 @@ void assert_iterator(const value_pair& v, const string& str_expected, string v_s
     }
 }
 
-void assert_parse_output(const string& text, const shared_ptr<value_pair>& expected) {
+void assert_parse_output(const string& text, const ref_ptr<value_pair>& expected) {
     try {
-        shared_ptr<value> values = parse_values_from(text);
+        value_ref values = parse_values_from(text);
         report_test(BLUE("[") + text + BLUE("] --> [") + values->str() + BLUE("]"));
 
         if (*values == *expected) {
@@ -147,7 +159,7 @@ void assert_parse_output(const string& text, const shared_ptr<value_pair>& expec
 
 void assert_parse_error(const string& text, const string& substring) {
     try {
-        shared_ptr<value> values = parse_values_from(text);
+        value_ref values = parse_values_from(text);
         report_test(BLUE("[") + text + BLUE("] --> [") + values->str() + BLUE("]"));
     } catch (scheme_error& e) {
         report_test(BLUE("[") + text + BLUE("] --> [") RED("" + e.topic() + ": " + e.what() + "") BLUE("]"));
@@ -165,12 +177,12 @@ void assert_parse_error(const string& text, const string& substring) {
     throw test_error();
 }
 
-void assert_eval_output(evaluator& e, const string& input, const shared_ptr<value>& expected) {
+void assert_eval_output(evaluator& e, const string& input, const value_ref& expected) {
     try {
         auto output = e.evaluate(parse_values_from(input)->car());
-        report_test(BLUE("[") + input + BLUE("] --> [") + output->str() + BLUE("]"));
+        report_test(BLUE("[") + input + BLUE("] --> [") + output.str() + BLUE("]"));
 
-        if (*output == *expected) {
+        if (output.equals(expected)) {
             return;
         }
     } catch (scheme_error& e) {
@@ -178,16 +190,16 @@ void assert_eval_output(evaluator& e, const string& input, const shared_ptr<valu
     }
 
     // the output doesn't match or exception thrown
-    cerr << RED("expected " + expected->str() + "\n");
+    cerr << RED("expected " + expected.str() + "\n");
     throw test_error();
 }
 
 void assert_eval_to_str(evaluator& e, const string& input, const string& expected) {
     try {
         auto output = e.evaluate(parse_values_from(input)->car());
-        report_test(BLUE("[") + input + BLUE("] --> [") + output->str() + BLUE("]"));
+        report_test(BLUE("[") + input + BLUE("] --> [") + output.str() + BLUE("]"));
 
-        if (output->str() == expected) {
+        if (output.str() == expected) {
             return;
         }
     } catch (scheme_error& e) {
@@ -202,9 +214,9 @@ void assert_eval_to_str(evaluator& e, const string& input, const string& expecte
 void assert_eval_error(evaluator& e, const string& input, const string& substring) {
     try {
         auto output = e.evaluate(parse_values_from(input)->car());
-        report_test(BLUE("[") + input + BLUE("] --> [") + output->str() + BLUE("]"));
+        report_test(BLUE("[") + input + BLUE("] --> [") + output.str() + BLUE("]"));
 
-        if (output->type() == value_t::error) {
+        if (output.type() == value_t::error) {
             auto error = to_ptr<value_error>(output);
             if (error->string_().find(substring) != string::npos) {
                 return;
@@ -294,25 +306,43 @@ void assert_exception_not_thrown(string code, string type, string substring) {
 
 void test_value() {
     // number
-    shared_ptr<value_number> num1, num2;
-    ASSERT_TO_STR(*(num1 = make_number(3.14)), "3.14");
-    ASSERT_TRUE(num1->type() == value_t::number);
-    ASSERT_EQUAL(num1->number(), 3.14);
-    ASSERT_TO_STR(*(num2 = make_number(3.14)), "3.14");
-    ASSERT_TRUE(*num1 == *num2);
-    ASSERT_FALSE(num1 == num2);
+    ref_ptr<value_number> num1, num2;
+    ASSERT_TO_STR((num1 = make_number(3.14)), "3.14");
+    ASSERT_TRUE(num1.type() == value_t::number);
+    ASSERT_EQUAL(num1.number(), 3.14);
+    ASSERT_TO_STR((num2 = make_number(3.14)), "3.14");
+    ASSERT_TRUE(num1.equals(num2));
+    ASSERT_TRUE(num1 == num2);  // immediates
+    ASSERT_TRUE(num1.is_immediate());
+    ASSERT_EQUAL(num1.use_count(), 0u);
+    ASSERT_FALSE(num1 == make_number(2.71));
+    ASSERT_FALSE(num1.equals(make_number(2.71)));
+    ASSERT_FALSE(num1.equals(make_symbol("abc")));
+    ASSERT_TO_STR(make_number(-0.5), "-0.5");
+    ASSERT_TRUE(make_number(NAN).type() == value_t::number);
+
+    // boxed number
+    ref_ptr<value_number> boxed;
+    ASSERT_TO_STR(*(boxed = make_ref<value_number>(3.14)), "3.14");
+    ASSERT_FALSE(boxed.is_immediate());
+    ASSERT_EQUAL(boxed.number(), 3.14);
+    ASSERT_TRUE(boxed.equals(num1));
+    ASSERT_TRUE(num1.equals(boxed));
+    ASSERT_FALSE(boxed == num1);
 
     // symbol
-    shared_ptr<value_symbol> sym1, sym2;
+    ref_ptr<value_symbol> sym1, sym2;
     ASSERT_TO_STR(*(sym1 = make_symbol("abc")), "abc");
     ASSERT_TRUE(sym1->type() == value_t::symbol);
     ASSERT_EQUAL(sym1->symbol(), "abc");
     ASSERT_TO_STR(*(sym2 = make_symbol("abc")), "abc");
     ASSERT_TRUE(*sym1 == *sym2);
     ASSERT_TRUE(sym1 == sym2);
+    ASSERT_EQUAL(sym1->id(), sym2->id());
+    ASSERT_TRUE(make_symbol("abcd")->id() != sym1->id());
 
     // string
-    shared_ptr<value_string> str1, str2;
+    ref_ptr<value_string> str1, str2;
     ASSERT_TO_STR(*(str1 = make_string("abc")), "\"abc\"");
     ASSERT_TRUE(str1->type() == value_t::string);
     ASSERT_EQUAL(str1->string_(), "abc");
@@ -321,7 +351,7 @@ void test_value() {
     ASSERT_FALSE(str1 == str2);
 
     // error
-    shared_ptr<value_error> error1, error2;
+    ref_ptr<value_error> error1, error2;
     ASSERT_TO_STR(*(error1 = make_error("hello '%g'", 3.14)),
                   BOLD(RED("error:")) " " BOLD(WHITE("hello '3.14'")));
     ASSERT_TRUE(error1->type() == value_t::error);
@@ -332,7 +362,7 @@ void test_value() {
     ASSERT_FALSE(error1 == error2);
 
     // info
-    shared_ptr<value_info> info1, info2;
+    ref_ptr<value_info> info1, info2;
     ASSERT_TO_STR(*(info1 = make_info("hello '%g'", 3.14)), GREEN("hello '3.14'"));
     ASSERT_TRUE(info1->type() == value_t::info);
     ASSERT_EQUAL(info1->string_(), "hello '3.14'");
@@ -341,7 +371,7 @@ void test_value() {
     ASSERT_FALSE(info1 == info2);
 
     // bool
-    shared_ptr<value_bool> bool1, bool2;
+    ref_ptr<value_bool> bool1, bool2;
     ASSERT_TO_STR(*(bool1 = make_bool(true)), "true");
     ASSERT_TRUE(bool1->type() == value_t::bool_);
     ASSERT_EQUAL(bool1->truth(), true);
@@ -350,7 +380,7 @@ void test_value() {
     ASSERT_TRUE(bool1 == bool2);
 
     // nil
-    shared_ptr<value_nil> nil1, nil2;
+    ref_ptr<value_nil> nil1, nil2;
     ASSERT_TO_STR(*(nil1 = make_nil()), "()");
     ASSERT_TRUE(nil1->type() == value_t::nil);
     ASSERT_TO_STR(*(nil2 = make_nil()), "()");
@@ -358,21 +388,21 @@ void test_value() {
     ASSERT_TRUE(nil1 == nil2);
 
     // pair
-    shared_ptr<value_pair> pair1, pair2;
+    ref_ptr<value_pair> pair1, pair2;
     ASSERT_TO_STR(*(pair1 = make_vpair(3.14, "abc")), "(3.14 . abc)");
     ASSERT_TRUE(pair1->type() == value_t::pair);
-    ASSERT_TO_STR(*pair1->car(), "3.14");
-    ASSERT_TO_STR(*pair1->cdr(), "abc");
+    ASSERT_TO_STR(pair1->car(), "3.14");
+    ASSERT_TO_STR(pair1->cdr(), "abc");
     ASSERT_TO_STR(*(pair2 = make_vpair(3.14, "abc")), "(3.14 . abc)");
     ASSERT_TRUE(*pair1 == *pair2);
     ASSERT_FALSE(pair1 == pair2);
 
     // list
-    shared_ptr<value_pair> list1, list2;
+    ref_ptr<value_pair> list1, list2;
     ASSERT_TO_STR(*(list1 = make_list(3.14, "abc", nil, false)), "(3.14 abc () false)");
     ASSERT_TRUE(list1->type() == value_t::pair);
-    ASSERT_TO_STR(*list1->car(), "3.14");
-    ASSERT_TO_STR(*list1->cdr(), "(abc () false)");
+    ASSERT_TO_STR(list1->car(), "3.14");
+    ASSERT_TO_STR(list1->cdr(), "(abc () false)");
     ASSERT_TO_STR(*list1->pcdr()->car(), "abc");
     ASSERT_TO_STR(*list1->pcdr()->cdr(), "(() false)");
     ASSERT_TO_STR(*list1->pcdr()->pcdr()->car(), "()");
@@ -382,6 +412,46 @@ void test_value() {
     ASSERT_TO_STR(*(list2 = make_list(3.14, "abc", nil, false)), "(3.14 abc () false)");
     ASSERT_TRUE(*list1 == *list2);
     ASSERT_FALSE(list1 == list2);
+
+    // reference counting
+    ref_ptr<value_pair> ref1, ref2;
+    ref1 = make_vpair("x"s, "y"s);
+    ASSERT_EQUAL(ref1.use_count(), 1u);
+    ref2 = ref1;
+    ASSERT_EQUAL(ref1.use_count(), 2u);
+    ASSERT_TRUE(ref1 == ref2);
+    value_ref ref3 = ref2->car();
+    ASSERT_EQUAL(ref3.use_count(), 2u);
+    ref2.reset();
+    ASSERT_EQUAL(ref1.use_count(), 1u);
+    ASSERT_TRUE(ref2 == nullptr);
+    ref1.reset();
+    ASSERT_EQUAL(ref3.use_count(), 1u);
+    ASSERT_TO_STR(*ref3, "\"x\"");
+    ASSERT_EQUAL(value_pair(*make_vpair("x"s, "y"s)).cdr().use_count(), 2u);
+    ASSERT_EQUAL(make_vpair(1, nil)->cdr().use_count(), 0u);  // immortal
+
+    // slab allocation
+    ref_ptr<value_pair> kept;
+    {
+        slab_allocator allocator{0};
+        allocator_scope scope{allocator};
+        auto pair1 = make_vpair(1, 2);
+        auto pair2 = make_vpair(3, 4);
+        ASSERT_EQUAL(allocator.stats()[1].cell_size, 32u);
+        ASSERT_EQUAL(allocator.stats()[1].allocated, 2u);
+        ASSERT_EQUAL(allocator.stats()[1].slabs, 1u);
+        value_pair* freed = pair1.get();
+        pair1.reset();
+        ASSERT_EQUAL(allocator.stats()[1].freed, 1u);
+        ASSERT_EQUAL(allocator.stats()[1].live, 1u);
+        kept = make_vpair(5, 6);
+        ASSERT_TRUE(kept.get() == freed);  // reused cell
+        pair2.reset();
+        ASSERT_EQUAL(allocator.stats()[1].live, 1u);
+    }
+    ASSERT_TO_STR(*kept, "(5 . 6)");  // outlives the allocator
+    kept.reset();
 }
 
 void test_pair() {
@@ -436,18 +506,18 @@ void test_pair() {
     ASSERT_ITERATOR(*make_list(nil, nil, nil), "(), (), ()");
     ASSERT_ITERATOR(*make_list(1, "2", "3"s, make_vpair(nil, false)), "1, 2, \"3\", (() . false)");
 
-    // iterator mutation
-    value_pair val = *make_list(1, 2, 3, 4, 5);
-    ASSERT_ITERATOR(val, "1, 2, 3, 4, 5");
-    for (value& item : val) {
-        // mutate the value in-place with a setter
-        auto& number = reinterpret_cast<value_number&>(item);
-        number.number(number.number() * number.number());
+    // item mutation
+    auto val = make_list(1, 2, 3, 4, 5);
+    ASSERT_ITERATOR(*val, "1, 2, 3, 4, 5");
+    for (auto pair = val; pair != nil; pair = to_sptr<value_pair>(pair->cdr())) {
+        // immediates are replaced with the pair's setter
+        double number = pair->car().number();
+        pair->car(make_number(number * number));
     }
-    ASSERT_ITERATOR(val, "1, 4, 9, 16, 25");
+    ASSERT_ITERATOR(*val, "1, 4, 9, 16, 25");
 
     // cycle
-    shared_ptr<value_pair> v1, v2, v3, v4;
+    ref_ptr<value_pair> v1, v2, v3, v4;
     v1 = make_vpair(1, 2);
     ASSERT_EXCEPTION({ v1->car(v1); }, cycle_error, "cycle from (1 . 2)");
     v1 = make_vpair(1, 2);
@@ -502,27 +572,27 @@ void test_pair() {
 
 void test_equal() {
     // number
-    shared_ptr<value> num1, num2, num3;
-    ASSERT_TO_STR(*(num1 = make_value(3.14)), "3.14");
-    ASSERT_TO_STR(*(num2 = make_value(3.14)), "3.14");
-    ASSERT_TO_STR(*(num3 = make_value(6.28)), "6.28");
-
-    ASSERT_TRUE(*num1 == *num1);
-    ASSERT_TRUE(*num1 == *num2);
-    ASSERT_FALSE(*num1 == *num3);
-    ASSERT_TRUE(*num2 == *num1);
-    ASSERT_TRUE(*num2 == *num2);
-    ASSERT_FALSE(*num2 == *num3);
-    ASSERT_FALSE(*num3 == *num1);
-    ASSERT_FALSE(*num3 == *num2);
-    ASSERT_TRUE(*num3 == *num3);
-
-    ASSERT_FALSE(num1 == num2);
+    value_ref num1, num2, num3;
+    ASSERT_TO_STR((num1 = make_value(3.14)), "3.14");
+    ASSERT_TO_STR((num2 = make_value(3.14)), "3.14");
+    ASSERT_TO_STR((num3 = make_value(6.28)), "6.28");
+
+    ASSERT_TRUE(num1.equals(num1));
+    ASSERT_TRUE(num1.equals(num2));
+    ASSERT_FALSE(num1.equals(num3));
+    ASSERT_TRUE(num2.equals(num1));
+    ASSERT_TRUE(num2.equals(num2));
+    ASSERT_FALSE(num2.equals(num3));
+    ASSERT_FALSE(num3.equals(num1));
+    ASSERT_FALSE(num3.equals(num2));
+    ASSERT_TRUE(num3.equals(num3));
+
+    ASSERT_TRUE(num1 == num2);  // immediate
     ASSERT_FALSE(num2 == num3);
     ASSERT_FALSE(num1 == num3);
 
     // symbol
-    shared_ptr<value> sym1, sym2, sym3;
+    value_ref sym1, sym2, sym3;
     ASSERT_TO_STR(*(sym1 = make_value("abc")), "abc");
     ASSERT_TO_STR(*(sym2 = make_value("abc")), "abc");
     ASSERT_TO_STR(*(sym3 = make_value("ab")), "ab");
@@ -542,7 +612,7 @@ void test_equal() {
     ASSERT_FALSE(sym1 == sym3);
 
     // string
-    shared_ptr<value> str1, str2, str3;
+    value_ref str1, str2, str3;
     ASSERT_TO_STR(*(str1 = make_value("abc"s)), "\"abc\"");
     ASSERT_TO_STR(*(str2 = make_value("abc"s)), "\"abc\"");
     ASSERT_TO_STR(*(str3 = make_value("ab"s)), "\"ab\"");
@@ -562,7 +632,7 @@ void test_equal() {
     ASSERT_FALSE(str1 == str3);
 
     // bool
-    shared_ptr<value> bool1, bool2, bool3;
+    value_ref bool1, bool2, bool3;
     ASSERT_TO_STR(*(bool1 = make_value(true)), "true");
     ASSERT_TO_STR(*(bool2 = make_value(true)), "true");
     ASSERT_TO_STR(*(bool3 = make_value(false)), "false");
@@ -586,7 +656,7 @@ void test_equal() {
     ASSERT_TRUE(bool3 == false_);  // predefined
 
     // nil
-    shared_ptr<value> nil1, nil2, nil3;
+    value_ref nil1, nil2, nil3;
     ASSERT_TO_STR(*(nil1 = make_nil()), "()");
     ASSERT_TO_STR(*(nil2 = make_nil()), "()");
     ASSERT_TO_STR(*(nil3 = nil), "()");
@@ -609,7 +679,7 @@ void test_equal() {
     ASSERT_TRUE(nil3 == nil);  // predefined
 
     // pair
-    shared_ptr<value> pair1, pair2, pair3;
+    value_ref pair1, pair2, pair3;
     ASSERT_TO_STR(*(pair1 = make_vpair(3.14, "abc")), "(3.14 . abc)");
     ASSERT_TO_STR(*(pair2 = make_vpair(3.14, "abc")), "(3.14 . abc)");
     ASSERT_TO_STR(*(pair3 = make_vpair(3.14, "abc"s)), "(3.14 . \"abc\")");
@@ -629,7 +699,7 @@ void test_equal() {
     ASSERT_FALSE(pair1 == pair3);
 
     // list
-    shared_ptr<value> list1, list2, list3;
+    value_ref list1, list2, list3;
     ASSERT_TO_STR(*(list1 = make_list(1, "2", make_vpair("3"s, 4))), "(1 2 (\"3\" . 4))");
     ASSERT_TO_STR(*(list2 = make_list(1, "2", make_vpair("3"s, 4))), "(1 2 (\"3\" . 4))");
     ASSERT_TO_STR(*(list3 = make_list(1, "2", "3"s, 4)), "(1 2 \"3\" 4)");
@@ -651,21 +721,21 @@ void test_equal() {
 
 void test_to_str() {
     // number
-    ASSERT_TO_STR(*make_value(0), "0");
-    ASSERT_TO_STR(*make_value(1), "1");
-    ASSERT_TO_STR(*make_value(-1), "-1");
-    ASSERT_TO_STR(*make_value(3.14), "3.14");
-    ASSERT_TO_STR(*make_value(-3.14), "-3.14");
-    ASSERT_TO_STR(*make_value(1e-20), "1e-20");
-    ASSERT_TO_STR(*make_value(1e+20), "1e+20");
-    ASSERT_TO_STR(*make_value(3.14e2), "314");
-    ASSERT_TO_STR(*make_value(3.14e-2), "0.0314");
-    ASSERT_TO_STR(*make_value(123'456'789'012), "123456789012");
-    ASSERT_TO_STR(*make_value(1'234'567'890'123), "1.23456789012e+12");
-    ASSERT_TO_STR(*make_value(123'456.789'012), "123456.789012");
-    ASSERT_TO_STR(*make_value(123'456.789'012'3), "123456.789012");
-    ASSERT_TO_STR(*make_value(0.123'456'789'012), "0.123456789012");
-    ASSERT_TO_STR(*make_value(0.123'456'789'012'3), "0.123456789012");
+    ASSERT_TO_STR(make_value(0), "0");
+    ASSERT_TO_STR(make_value(1), "1");
+    ASSERT_TO_STR(make_value(-1), "-1");
+    ASSERT_TO_STR(make_value(3.14), "3.14");
+    ASSERT_TO_STR(make_value(-3.14), "-3.14");
+    ASSERT_TO_STR(make_value(1e-20), "1e-20");
+    ASSERT_TO_STR(make_value(1e+20), "1e+20");
+    ASSERT_TO_STR(make_value(3.14e2), "314");
+    ASSERT_TO_STR(make_value(3.14e-2), "0.0314");
+    ASSERT_TO_STR(make_value(123'456'789'012), "123456789012");
+    ASSERT_TO_STR(make_value(1'234'567'890'123), "1.23456789012e+12");
+    ASSERT_TO_STR(make_value(123'456.789'012), "123456.789012");
+    ASSERT_TO_STR(make_value(123'456.789'012'3), "123456.789012");
+    ASSERT_TO_STR(make_value(0.123'456'789'012), "0.123456789012");
+    ASSERT_TO_STR(make_value(0.123'456'789'012'3), "0.123456789012");
 
     // symbol
     ASSERT_TO_STR(*make_value(""), "");
@@ -714,7 +784,7 @@ void test_to_str() {
     ASSERT_TO_STR(*make_nil(), "()");
 
     // identity
-    ASSERT_TO_STR(*make_value(make_value(1)), "1");
+    ASSERT_TO_STR(make_value(make_value(1)), "1");
     ASSERT_TO_STR(*make_value(make_value("abc")), "abc");
     ASSERT_TO_STR(*make_value(make_value("abc"s)), "\"abc\"");
     ASSERT_TO_STR(*make_value(true_), "true");
@@ -915,7 +985,7 @@ void test_code() {
         for (const auto& translated : code) {
             // compare each line of the code with the original
             const auto& original_line = running->car();
-            const shared_ptr<value> translated_line = translated->to_value();
+            const value_ref translated_line = translated->to_value();
 
             if (*translated_line != *original_line) {
                 cerr << RED("" + translated_line->str() + " != " + original_line->str() + "") << '\n';
@@ -929,7 +999,7 @@ void test_code() {
 
 void test_machine() {
     // data for the machine unit tests
-    vector<tuple<path, string, vector<pair<vector<pair<string, shared_ptr<value>>>, shared_ptr<value>>>>> data = {
+    vector<tuple<path, string, vector<pair<vector<pair<string, value_ref>>, value_ref>>>> data = {
         {
             "./lib/machines/gcd.scm",
             "a",
@@ -969,79 +1039,118 @@ void test_machine() {
 
     // primitives to bind for the tests
 
-    auto add = [](const vector<value_pair*>& args) -> shared_ptr<value> {
+    auto add = [](const vector<value_pair*>& args) -> value_ref {
         return make_number(
-            to_ptr<value_number>(args[0]->car())->number() +
-            to_ptr<value_number>(args[1]->car())->number());
+            args[0]->car().number() +
+            args[1]->car().number());
     };
 
-    auto subtract = [](const vector<value_pair*>& args) -> shared_ptr<value> {
+    auto subtract = [](const vector<value_pair*>& args) -> value_ref {
         return make_number(
-            to_ptr<value_number>(args[0]->car())->number() -
-            to_ptr<value_number>(args[1]->car())->number());
+            args[0]->car().number() -
+            args[1]->car().number());
     };
 
-    auto multiply = [](const vector<value_pair*>& args) -> shared_ptr<value> {
+    auto multiply = [](const vector<value_pair*>& args) -> value_ref {
         return make_number(
-            to_ptr<value_number>(args[0]->car())->number() *
-            to_ptr<value_number>(args[1]->car())->number());
+            args[0]->car().number() *
+            args[1]->car().number());
     };
 
-    auto remainder = [](const vector<value_pair*>& args) -> shared_ptr<value> {
+    auto remainder = [](const vector<value_pair*>& args) -> value_ref {
         return make_number(std::fmod(
-            to_ptr<value_number>(args[0]->car())->number(),
-            to_ptr<value_number>(args[1]->car())->number()));
+            args[0]->car().number(),
+            args[1]->car().number()));
     };
 
-    auto equal = [](const vector<value_pair*>& args) -> shared_ptr<value> {
-        return (to_ptr<value_number>(args[0]->car())->number() ==
-                to_ptr<value_number>(args[1]->car())->number())
+    auto equal = [](const vector<value_pair*>& args) -> value_ref {
+        return (args[0]->car().number() ==
+                args[1]->car().number())
                    ? true_
                    : false_;
     };
 
-    auto less = [](const vector<value_pair*>& args) -> shared_ptr<value> {
-        return (to_ptr<value_number>(args[0]->car())->number() <
-                to_ptr<value_number>(args[1]->car())->number())
+    auto less = [](const vector<value_pair*>& args) -> value_ref {
+        return (args[0]->car().number() <
+                args[1]->car().number())
                    ? true_
                    : false_;
     };
 
-    for (const auto& [path, output_register, test_cases] : data) {
-        // create the machine from source
-        shared_ptr<value_pair> source = parse_values_from(path);
-        std::vector<shared_ptr<code>> code = translate_to_code(source);
-        machine m{code};
-
-        // bind the primitives
-        m.bind_op("+", add);
-        m.bind_op("-", subtract);
-        m.bind_op("*", multiply);
-        m.bind_op("rem", remainder);
-        m.bind_op("=", equal);
-        m.bind_op("<", less);
-
-        for (const auto& [inputs, expected] : test_cases) {
-            auto result = m.run(inputs, output_register);
-
-            // contruct the report line
-            ostringstream s;
-            s << path.filename().stem().string() << "(";  // filename
-            for (const auto& p : inputs) {
-                s << *p.second << ", ";  // input
-            }
-            s.seekp(-2, s.cur);      // drop trailing ", "
-            s << ") = " << *result;  // output
-            report_test(s.str());
-
-            if (*result != *expected) {
-                cerr << RED("expected \"" + expected->str() + "\"") << '\n';
-                throw test_error();
+    for (const auto engine : {machine_engine::switch_, machine_engine::threaded}) {
+        for (const auto& [path, output_register, test_cases] : data) {
+            // create the machine from source
+            ref_ptr<value_pair> source = parse_values_from(path);
+            std::vector<shared_ptr<code>> code = translate_to_code(source);
+            machine m{code, engine};
+
+            // bind the primitives
+            m.bind_op("+", add);
+            m.bind_op("-", subtract);
+            m.bind_op("*", multiply);
+            m.bind_op("rem", remainder);
+            m.bind_op("=", equal);
+            m.bind_op("<", less);
+
+            for (const auto& [inputs, expected] : test_cases) {
+                auto result = m.run(inputs, output_register);
+
+                // contruct the report line
+                ostringstream s;
+                s << path.filename().stem().string() << "(";  // filename
+                for (const auto& p : inputs) {
+                    s << p.second << ", ";  // input
+                }
+                s.seekp(-2, s.cur);     // drop trailing ", "
+                s << ") = " << result;  // output
+                report_test(s.str());
+
+                if (!result.equals(expected)) {
+                    cerr << RED("expected \"" + expected.str() + "\"") << '\n';
+                    throw test_error();
+                }
             }
         }
     }
 }
 
+void test_gc() {
+    // manual collection only
+    evaluator e{path{"./lib/machines/evaluator.scm"}, machine_engine::threaded, SLAB_SPARE_SLABS, 0};
+
+    // closures over their own environment: cycles
+    ASSERT_EVAL_OUTPUT(e, "(define (make) (define (self) self) self)", make_info("make is defined"));
+    ASSERT_EVAL_TO_STR(e, "(make)", "(lambda () self)");
+    ASSERT_EVAL_TO_STR(e, "(make)", "(lambda () self)");
+    auto kept = e.evaluate(parse_values_from("(make)")->car());
+
+    e.collect();
+    ASSERT_EQUAL(e.collector_stats().collected_times, 1u);
+    ASSERT_TRUE(e.collector_stats().collected_values >= 4u);  // 2 x (env + closure)
+    ASSERT_EQUAL(e.collector_stats().before - e.collector_stats().after, e.collector_stats().collected_values);
+
+    // held from outside: not collected
+    ASSERT_TO_STR(*kept, "(lambda () self)");
+    ASSERT_EVAL_TO_STR(e, "((make))", "(lambda () self)");
+    e.collect();
+    ASSERT_TO_STR(*kept, "(lambda () self)");
+
+    // nothing new to collect
+    size_t collected = e.collector_stats().collected_values;
+    e.collect();
+    ASSERT_EQUAL(e.collector_stats().collected_values, collected);
+    ASSERT_EVAL_TO_STR(e, "(make)", "(lambda () self)");
+
+    // collection triggered by the allocated bytes
+    evaluator e2{path{"./lib/machines/evaluator.scm"}, machine_engine::threaded, SLAB_SPARE_SLABS, 64 * 1024};
+    ASSERT_EVAL_OUTPUT(e2, "(define (make) (define (self) self) self)", make_info("make is defined"));
+    for (size_t i = 0; i < 1000; i++) {
+        e2.evaluate(parse_values_from("(make)")->car());
+    }
+    ASSERT_TRUE(e2.collector_stats().collected_times > 0u);
+    ASSERT_TRUE(e2.collector_stats().collected_values > 0u);
+}
+
 void test_syntax(evaluator& e) {
     // self-evaluating
     ASSERT_EVAL_OUTPUT(e, "1", make_number(1));
@@ -1186,6 +1295,17 @@ void test_syntax(evaluator& e) {
     ASSERT_EVAL_OUTPUT(e, "(let ((x 10) (y 20)) (+ x y))", make_number(30));
     ASSERT_EVAL_OUTPUT(e, "(let ((x 10) (y 20)) (let ((z 30)) (+ (* x y) z)))", make_number(230));
     ASSERT_EVAL_OUTPUT(e, "(let ((x 10)) (let ((y 20)) (let ((z 30)) (+ x (* y z)))))", make_number(610));
+    ASSERT_EVAL_OUTPUT(e, "(define (l1 x) (let ((y (* x 2))) (+ x y)))", make_info("l1 is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(l1 1)", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(l1 10)", make_number(30));
+
+    // let memoized by the source pair
+    ASSERT_EVAL_OUTPUT(e, "(define l2 '(let ((x 1)) x))", make_info("l2 is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(eval l2)", make_number(1));
+    ASSERT_EVAL_OUTPUT(e, "(eval l2)", make_number(1));
+    auto l2_binding = to_ptr<value_pair>(to_ptr<value_pair>(to_ptr<value_pair>(e.global().at("l2"))->pcdr()->car())->car());
+    to_ptr<value_pair>(l2_binding->cdr())->car(make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "(eval l2)", make_number(2));
 
     // let errors
     ASSERT_EVAL_ERROR(e, "(let)", "no variables");
@@ -1444,6 +1564,25 @@ void test_syntax(evaluator& e) {
     ASSERT_EVAL_OUTPUT(e, "(f8 1 2)", make_list(1, 2));
     ASSERT_EVAL_OUTPUT(e, "(f8 1 2 3)", make_list(1, 2, 3));
 
+    // lexical scoping
+    ASSERT_EVAL_OUTPUT(e, "(define s 1)", make_info("s is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(((lambda (s) (lambda (t) (+ s t))) 10) 100)", make_number(110));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (s) ((lambda (s) s) 2)) 3)", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (t) (+ s t)) 3)", make_number(4));
+    ASSERT_EVAL_OUTPUT(e, "((lambda () s (define s 2) s))", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "((lambda () (define u s) (define s 2) u))", make_number(1));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (s) (define s 5) s) 3)", make_number(5));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (s) (set! s (+ s 1)) s) 3)", make_number(4));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (x . y) (let ((z x)) (+ z x))) 1 2)", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (x) (let () (define w x)) w) 7)", make_number(7));
+    ASSERT_EVAL_OUTPUT(e, "((lambda (x) (eval '(define w 8)) (+ x w)) 1)", make_number(9));
+    ASSERT_EVAL_OUTPUT(e, "(define (counter) (define m 0) (lambda () (set! m (+ m 1)) m))", make_info("counter is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(define cnt (counter))", make_info("cnt is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(cnt)", make_number(1));
+    ASSERT_EVAL_OUTPUT(e, "(cnt)", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "s", make_number(1));
+    ASSERT_EVAL_ERROR(e, "((lambda (x) v) 1)", "v is unbound");
+
     // application errors
     ASSERT_EVAL_ERROR(e, "(1)", "can't apply 1");
     ASSERT_EVAL_ERROR(e, "(1 2 3)", "can't apply 1");
@@ -1454,6 +1593,71 @@ void test_syntax(evaluator& e) {
     ASSERT_EVAL_ERROR(e, "(+ . 1)", "can't apply to 1");
 }
 
+void test_compile(evaluator& e) {
+    // self-evaluating and quoted
+    ASSERT_EVAL_OUTPUT(e, "(compile 1)", make_number(1));
+    ASSERT_EVAL_OUTPUT(e, "(compile \"abc\")", make_string("abc"));
+    ASSERT_EVAL_OUTPUT(e, "(compile ''x)", make_symbol("x"));
+    ASSERT_EVAL_OUTPUT(e, "(compile ''(1 2 3))", make_list(1, 2, 3));
+
+    // definition, assignment, and lookup
+    ASSERT_EVAL_OUTPUT(e, "(compile '(define cx 10))", make_info("cx is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(compile 'cx)", make_number(10));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(set! cx 20))", nil);
+    ASSERT_EVAL_OUTPUT(e, "cx", make_number(20));
+    ASSERT_EVAL_ERROR(e, "(compile 'cy)", "cy is unbound");
+
+    // special forms
+    ASSERT_EVAL_OUTPUT(e, "(compile '(if true 1 2))", make_number(1));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(if false 1 2))", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(and))", true_);
+    ASSERT_EVAL_OUTPUT(e, "(compile '(and 1 2 3))", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(and 1 false 3))", false_);
+    ASSERT_EVAL_OUTPUT(e, "(compile '(or))", false_);
+    ASSERT_EVAL_OUTPUT(e, "(compile '(or false 2 3))", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(begin 1 2 3))", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(let ((x 1) (y 2)) (+ x y)))", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(cond (false 1) ((+ 1 1) 2) (else 3)))", make_number(2));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(cond (false 1) (else 3)))", make_number(3));
+
+    // compiled procedures
+    ASSERT_EVAL_TO_STR(e, "(compile '(lambda (x y) x))", "<compiled (x y)>");
+    ASSERT_EVAL_TO_STR(e, "(compile '(lambda x x))", "<compiled x>");
+    ASSERT_EVAL_OUTPUT(e, "(compile '((lambda (x . y) y) 1 2 3))", make_list(2, 3));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(((lambda (x) (lambda (y) (+ x y))) 1) 2))", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(define (cf x y) (define z (* x y)) (+ z 1)))", make_info("cf is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(cf 2 3))", make_number(7));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(define (cc) (define n 0) (lambda () (set! n (+ n 1)) n)))", make_info("cc is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(define cn (cc)))", make_info("cn is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(cn))", make_number(1));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(cn))", make_number(2));
+
+    // mixing compiled and interpreted
+    ASSERT_EVAL_OUTPUT(e, "(cf 3 4)", make_number(13));
+    ASSERT_EVAL_OUTPUT(e, "(cn)", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(define (ci x) (* x 2))", make_info("ci is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(ci (cf 1 1)))", make_number(4));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(apply + '(1 2 3)))", make_number(6));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(apply cf '(1 2)))", make_number(3));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(apply ci '(5)))", make_number(10));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(eval '(cf 2 2)))", make_number(5));
+
+    // rebound primitive names
+    ASSERT_EVAL_OUTPUT(e, "(compile '((lambda (+) (+ 1 2)) (lambda (a b) 7)))", make_number(7));
+    ASSERT_EVAL_OUTPUT(e, "(define plus +)", make_info("plus is defined"));
+    ASSERT_EVAL_OUTPUT(e, "(define (+ a b) 42)", make_info("+ is updated"));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(+ 1 2))", make_number(42));
+    ASSERT_EVAL_OUTPUT(e, "(define + plus)", make_info("+ is updated"));
+    ASSERT_EVAL_OUTPUT(e, "(compile '(+ 1 2))", make_number(3));
+
+    // errors
+    ASSERT_EVAL_ERROR(e, "(compile)", "expects 1 arg");
+    ASSERT_EVAL_ERROR(e, "(compile '(1 2))", "can't apply 1");
+    ASSERT_EVAL_ERROR(e, "(compile '(if))", "no predicate");
+    ASSERT_EVAL_ERROR(e, "(compile '(lambda (1) 1))", "some parameters are not symbols");
+    ASSERT_EVAL_ERROR(e, "(compile '(f (lambda x)))", "no body");
+}
+
 int main() {
     evaluator e{path{"./lib/machines/evaluator.scm"}};
 
@@ -1465,8 +1669,10 @@ int main() {
         RUN_TEST_FUNCTION(test_parse);
         RUN_TEST_FUNCTION(test_code);
         RUN_TEST_FUNCTION(test_machine);
+        RUN_TEST_FUNCTION(test_gc);
 
         RUN_EVAL_TEST_FUNCTION(e, test_syntax);
+        RUN_EVAL_TEST_FUNCTION(e, test_compile);
 
         cout << "all tests have been passed!\n";
         return EXIT_SUCCESS;
@@ -11,7 +11,6 @@ using std::defaultfloat;
 using std::ostream;
 using std::ostringstream;
 using std::setprecision;
-using std::shared_ptr;
 using std::string;
 using std::unordered_map;
 using std::vector;
@@ -20,36 +19,41 @@ using std::vector;
 
 value::operator bool() const {
     return (
-        _type != value_t::bool_ ||
+        type() != value_t::bool_ ||
         reinterpret_cast<const value_bool*>(this)->truth());
 }
 
 // value_number
 
 ostream& value_number::write(ostream& os) const {
-    // write with a 12-digit precision, then restore the default
-    return (os << setprecision(12) << _number << defaultfloat);
+    return write(os, number());
 }
 
 bool value_number::equals(const value& other) const {
     if (other.type() == value_t::number) {
-        return (reinterpret_cast<const value_number&>(other)._number == _number);
+        return (reinterpret_cast<const value_number&>(other).number() == number());
     } else {
         return false;
     }
 }
 
+ostream& value_number::write(ostream& os, double number) {
+    // write with a 12-digit precision, then restore the default
+    return (os << setprecision(12) << number << defaultfloat);
+}
+
 // value_symbol
 
-const shared_ptr<value_symbol>& value_symbol::get(const string& symbol) {
+const ref_ptr<value_symbol>& value_symbol::get(const string& symbol) {
     // static table of content-to-value mappings
-    static unordered_map<string, shared_ptr<value_symbol>> _odarray;
+    // (never destroyed: the symbols are immortal)
+    static auto& _odarray = *new unordered_map<string, ref_ptr<value_symbol>>;
 
-    shared_ptr<value_symbol>& val = _odarray[symbol];
+    ref_ptr<value_symbol>& val = _odarray[symbol];
 
     if (!val) {
         // create a new value
-        val.reset(new value_symbol(symbol));
+        val = ref_ptr<value_symbol>::immortal(new value_symbol(symbol, _odarray.size() - 1));
     }
 
     return val;
@@ -91,10 +95,10 @@ ostream& value_info::write(ostream& os) const {
 
 // value_bool
 
-const shared_ptr<value_bool>& value_bool::get(bool truth) {
+const ref_ptr<value_bool>& value_bool::get(bool truth) {
     // static singletons: true and false
-    static const shared_ptr<value_bool> true_ = shared_ptr<value_bool>(new value_bool(true));
-    static const shared_ptr<value_bool> false_ = shared_ptr<value_bool>(new value_bool(false));
+    static const auto true_ = ref_ptr<value_bool>::immortal(new value_bool(true));
+    static const auto false_ = ref_ptr<value_bool>::immortal(new value_bool(false));
 
     return (truth ? true_ : false_);
 }
@@ -106,34 +110,36 @@ ostream& value_bool::write(ostream& os) const {
 
 // value_pair
 
+thread_local size_t value_pair::_mutations = 0;
+
 ostream& value_pair::write(ostream& os) const {
-    if (car()->type() == value_t::symbol &&                  // first item is a symbol
+    if (car().type() == value_t::symbol &&                   // first item is a symbol
         to_ptr<value_symbol>(car())->symbol() == "quote" &&  // first item is a quote symbol
-        cdr()->type() == value_t::pair &&                    // there is a second item
+        cdr().type() == value_t::pair &&                     // there is a second item
         pcdr()->cdr() == nil) {                              // there is no third item
         // (quote x) -> 'x
         // (quote (x y z)) -> '(x y z)
-        os << '\'' << pcdr()->car()->str();
+        os << '\'' << pcdr()->car().str();
 
         return os;
     }
 
     os << "(";
     const value_pair* running{this};
-    running->car()->write(os);  // write the first car
+    running->car().write(os);  // write the first car
     while (true) {
-        value_t cdr_type = running->cdr()->type();
+        value_t cdr_type = running->cdr().type();
         if (cdr_type == value_t::pair) {
             // go to the next cdr
             running = running->pcdr();
             // write the next car
             os << " ";
-            running->car()->write(os);
+            running->car().write(os);
         } else {
             if (cdr_type != value_t::nil) {
                 // write the non-pair cdr
                 os << " . ";
-                running->cdr()->write(os);
+                running->cdr().write(os);
             }
             break;
         }
@@ -145,21 +151,22 @@ ostream& value_pair::write(ostream& os) const {
 
 bool value_pair::equals(const value& other) const {
     if (other.type() == this->type()) {
-        const value* running1 = this;
-        const value* running2 = &other;
-        while (running1->type() == value_t::pair && running1->type() == running2->type()) {
-            const value_pair* pair1 = reinterpret_cast<const value_pair*>(running1);
-            const value_pair* pair2 = reinterpret_cast<const value_pair*>(running2);
-
-            if (!pair1->car()->equals(*pair2->car())) {
+        const value_pair* pair1 = this;
+        const value_pair* pair2 = reinterpret_cast<const value_pair*>(&other);
+        while (true) {
+            if (!pair1->car().equals(pair2->car())) {
                 return false;
             }
 
-            running1 = pair1->cdr().get();
-            running2 = pair2->cdr().get();
-        }
+            const value_ref& cdr1 = pair1->cdr();
+            const value_ref& cdr2 = pair2->cdr();
+            if (cdr1.type() != value_t::pair || cdr2.type() != value_t::pair) {
+                return cdr1.equals(cdr2);
+            }
 
-        return running1->equals(*running2);
+            pair1 = pair1->pcdr();
+            pair2 = pair2->pcdr();
+        }
     } else {
         return false;
     }
@@ -168,7 +175,7 @@ bool value_pair::equals(const value& other) const {
 bool value_pair::is_list() const {
     const value_pair* running{this};
     while (true) {
-        value_t cdr_type = running->cdr()->type();
+        value_t cdr_type = running->cdr().type();
         if (cdr_type == value_t::pair) {
             // the cdr is a pair: go to the next cdr
             running = running->pcdr();
@@ -184,7 +191,7 @@ size_t value_pair::length() const {
     const value_pair* running{this};
     while (true) {
         ++result;  // increment the length
-        auto cdr_type = running->cdr()->type();
+        auto cdr_type = running->cdr().type();
         if (cdr_type == value_t::pair) {
             // the cdr is a pair: go to the next cdr
             running = running->pcdr();
@@ -199,8 +206,8 @@ size_t value_pair::length() const {
     }
 }
 
-void value_pair::_throw_on_cycle_from(const shared_ptr<value>& other) {
-    if (other->type() == value_t::pair) {
+void value_pair::_throw_on_cycle_from(const value_ref& other) {
+    if (other.type() == value_t::pair) {
         const value_pair* running{to_ptr<value_pair>(other)};
         while (running != nilptr) {
             if (running == this) {
@@ -209,7 +216,7 @@ void value_pair::_throw_on_cycle_from(const shared_ptr<value>& other) {
 
             _throw_on_cycle_from(running->car());
 
-            if (running->cdr()->type() == value_t::pair) {
+            if (running->cdr().type() == value_t::pair) {
                 running = running->pcdr();
             } else {
                 break;
@@ -220,9 +227,9 @@ void value_pair::_throw_on_cycle_from(const shared_ptr<value>& other) {
 
 // value_nil
 
-const shared_ptr<value_nil>& value_nil::get() {
+const ref_ptr<value_nil>& value_nil::get() {
     // static singleton: nil
-    static const shared_ptr<value_nil> nil = shared_ptr<value_nil>(new value_nil);
+    static const auto nil = ref_ptr<value_nil>::immortal(new value_nil);
 
     return nil;
 }
@@ -243,7 +250,10 @@ const char* get_type_name(value_t t) {
         {value_t::pair, "pair"},
         {value_t::machine_op, "machine op"},
         {value_t::instruction, "instruction"},
+        {value_t::code, "code"},
+        {value_t::address, "address"},
         {value_t::environment, "environment"},
+        {value_t::dispatch_table, "dispatch table"},
         {value_t::primitive_op, "primitive op"},
         {value_t::compound_op, "compound op"},
         {value_t::compiled_op, "compiled op"},
@@ -2,13 +2,18 @@
 #define VALUE_HPP_
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 
+#include "allocator.hpp"
 #include "constants.hpp"
 #include "error.hpp"
 
@@ -23,7 +28,7 @@ class cycle_error : public scheme_error {
 
 // value hierarchy
 
-enum class value_t {
+enum class value_t : uint8_t {
     number,
     symbol,
     string,
@@ -35,7 +40,10 @@ enum class value_t {
     pair,
     machine_op,
     instruction,
+    code,
+    address,
     environment,
+    dispatch_table,
     primitive_op,
     compound_op,
     compiled_op,
@@ -46,13 +54,19 @@ using std::forward;
 using std::forward_iterator_tag;
 using std::is_base_of;
 using std::is_convertible;
-using std::make_shared;
+using std::memcpy;
+using std::nullptr_t;
 using std::ostream;
 using std::ostringstream;
-using std::reinterpret_pointer_cast;
-using std::shared_ptr;
 using std::string;
 
+template <typename T>
+class ref_ptr;
+
+class garbage_collector;
+class value_number;
+class value_tracer;
+
 class value {
    public:
     virtual ~value() {}  // virtual destructor
@@ -77,15 +91,273 @@ class value {
 
     explicit operator bool() const;
 
+    // the values live in the current thread's slab allocator
+    static void* operator new(size_t size) {
+        return slab_allocator::current().allocate(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        slab_allocator::deallocate(ptr, size);
+    }
+
    protected:
     value(value_t type) : _type{type} {}
 
+    // copies start with no references
+    value(const value& other) : _type{other._type} {}
+    value& operator=(const value& other) {
+        _type = other._type;
+        return *this;
+    }
+
+    // for the collector: visit the referenced values
+    virtual void _trace(value_tracer& /* tracer */) const {}
+
+    // for the collector: drop the referenced values
+    // (breaks the cycles among the garbage values)
+    virtual void _clear() {}
+
+    // tagged handles: a handle word with non-zero top 16 bits is
+    // an immediate (NaN-boxed) double, offset by 2^49 to keep it
+    // out of the (48-bit) pointer range; otherwise it is a pointer,
+    // with the low bit set if the value is immortal (not counted).
+    // an immediate has no object: the handle decodes the word
+
+    static constexpr uint64_t _double_offset = uint64_t{1} << 49;
+    static constexpr uint64_t _immortal_bit = 1;
+
+    // an immortal's count: never reaches zero
+    // and makes it a root for the collector
+    static constexpr uint32_t _immortal_refs = uint32_t{1} << 30;
+
+    static bool _is_immediate(uint64_t word) {
+        return (word >> 48) != 0;
+    }
+
+    static uint64_t _encode(double number) {
+        uint64_t bits;
+        if (number != number) {
+            // canonical NaN: keeps the encoded top bits non-zero
+            bits = uint64_t{0x7ff8} << 48;
+        } else {
+            memcpy(&bits, &number, sizeof(bits));
+        }
+        return bits + _double_offset;
+    }
+
+    static double _decode(uint64_t word) {
+        double number;
+        uint64_t bits = word - _double_offset;
+        memcpy(&number, &bits, sizeof(number));
+        return number;
+    }
+
     // for efficient type checking
     value_t _type;
+
+    // a pair read by memoized syntax checks or
+    // transformations: its mutations are counted
+    mutable bool _syntax{false};
+
+   private:
+    template <typename T>
+    friend class ref_ptr;
+    friend class garbage_collector;
+
+    // reached by the collector's marking
+    mutable bool _marked{false};
+
+    // intrusive (non-atomic) reference count
+    mutable uint32_t _refs{0};
+};
+
+// reference-counted tagged handle to a value:
+// the interpreter is single-threaded, so the count
+// lives in the value header and is not atomic.
+// immediates and immortals are never counted.
+// an immediate number has no object to point to:
+// type(), number(), truth(), write(), str(), and equals()
+// read it from the handle, get() is for the others
+
+template <typename T>
+class ref_ptr {
+   public:
+    ref_ptr() noexcept : _word{0} {}
+    ref_ptr(nullptr_t) noexcept : _word{0} {}
+    explicit ref_ptr(T* ptr) noexcept : _word{_to_word(ptr)} { _retain(); }
+
+    ref_ptr(const ref_ptr& other) noexcept : _word{other._word} { _retain(); }
+    ref_ptr(ref_ptr&& other) noexcept : _word{other._word} { other._word = 0; }
+
+    template <typename U,
+              typename enable_if<
+                  is_convertible<U*, T*>::value,
+                  bool>::type = true>  // poor man's concept
+    ref_ptr(const ref_ptr<U>& other) noexcept : _word{other.word()} {
+        _retain();
+    }
+
+    ~ref_ptr() { _release(); }
+
+    ref_ptr& operator=(const ref_ptr& other) noexcept {
+        ref_ptr(other).swap(*this);  // safe on self-assignment
+        return *this;
+    }
+
+    ref_ptr& operator=(ref_ptr&& other) noexcept {
+        ref_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    // an immediate number handle
+    static ref_ptr immediate(double number) noexcept {
+        return _from_word(value::_encode(number));
+    }
+
+    // a handle to a value that is never freed
+    static ref_ptr immortal(T* ptr) noexcept {
+        ptr->_refs = value::_immortal_refs;
+        return _from_word(_to_word(ptr) | value::_immortal_bit);
+    }
+
+    // a handle of another type to the same value
+    template <typename U>
+    static ref_ptr cast(const ref_ptr<U>& other) noexcept {
+        ref_ptr result = _from_word(other.word());
+        result._retain();
+        return result;
+    }
+
+    void swap(ref_ptr& other) noexcept {
+        std::swap(_word, other._word);
+    }
+
+    void reset(T* ptr = nullptr) {
+        ref_ptr(ptr).swap(*this);
+    }
+
+    // the allocated (or immortal) value: not an immediate
+    T* get() const noexcept {
+        assert(!is_immediate());
+        return reinterpret_cast<T*>(_word & ~value::_immortal_bit);
+    }
+
+    T& operator*() const noexcept { return *get(); }
+    T* operator->() const noexcept { return get(); }
+
+    explicit operator bool() const noexcept { return _word != 0; }
+
+    uint32_t use_count() const noexcept { return _counted() ? _ptr()->_refs : 0; }
+
+    bool is_immediate() const noexcept { return value::_is_immediate(_word); }
+
+    // neither null, nor immediate, nor immortal
+    bool is_counted() const noexcept { return _counted(); }
+
+    // the raw handle word
+    uint64_t word() const noexcept { return _word; }
+
+    // immediate or not (defined after value_number)
+    value_t type() const;
+    double number() const;
+    bool truth() const;
+    ostream& write(ostream& os) const;
+    template <typename U>
+    bool equals(const ref_ptr<U>& other) const;
+
+    string str() const {
+        ostringstream s;
+        write(s);
+
+        return s.str();
+    }
+
+   private:
+    static uint64_t _to_word(T* ptr) {
+        return reinterpret_cast<uint64_t>(static_cast<const value*>(ptr));
+    }
+
+    static ref_ptr _from_word(uint64_t word) {
+        ref_ptr result;
+        result._word = word;
+        return result;
+    }
+
+    bool _counted() const {
+        return _word != 0 && !value::_is_immediate(_word) && !(_word & value::_immortal_bit);
+    }
+
+    value* _ptr() const {
+        return reinterpret_cast<value*>(_word);
+    }
+
+    void _retain() {
+        if (_counted()) {
+            ++_ptr()->_refs;
+        }
+    }
+
+    void _release() {
+        if (_counted() && --_ptr()->_refs == 0) {
+            delete _ptr();
+        }
+    }
+
+    uint64_t _word;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ref_ptr<T>& a, const ref_ptr<U>& b) {
+    if (a.is_immediate() || b.is_immediate()) {
+        return a.word() == b.word();
+    } else {
+        return a.get() == b.get();
+    }
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ref_ptr<T>& a, const ref_ptr<U>& b) {
+    return !(a == b);
+}
+
+template <typename T>
+inline bool operator==(const ref_ptr<T>& a, nullptr_t) {
+    return !a;
+}
+
+template <typename T>
+inline bool operator!=(const ref_ptr<T>& a, nullptr_t) {
+    return static_cast<bool>(a);
+}
+
+template <typename T, typename... Args>
+inline ref_ptr<T> make_ref(Args&&... args) {
+    return ref_ptr<T>(new T(forward<Args>(args)...));
+}
+
+using value_ref = ref_ptr<value>;
+
+// visits the counted values referenced by
+// a value (or a root) for the collector
+
+class value_tracer {
+   public:
+    virtual ~value_tracer() {}
+
+    template <typename T>
+    void operator()(const ref_ptr<T>& ref) {
+        if (ref.is_counted()) {
+            _visit(ref.get());
+        }
+    }
+
+   protected:
+    virtual void _visit(value* v) = 0;
 };
 
 class value_number : public value {
    public:
+    // boxed: make_number creates immediates instead
     value_number(double number) : value(value_t::number), _number(number) {}
 
     double number() const { return _number; }
@@ -96,18 +368,66 @@ class value_number : public value {
     ostream& write(ostream& os) const override;
     bool equals(const value& other) const override;
 
+    // the number's notation
+    static ostream& write(ostream& os, double number);
+
    private:
     double _number;
 };
 
+template <typename T>
+inline value_t ref_ptr<T>::type() const {
+    return (is_immediate() ? value_t::number : get()->type());
+}
+
+template <typename T>
+inline double ref_ptr<T>::number() const {
+    if (is_immediate()) {
+        return value::_decode(_word);
+    } else {
+        return static_cast<const value_number*>(static_cast<const value*>(get()))->number();
+    }
+}
+
+template <typename T>
+inline bool ref_ptr<T>::truth() const {
+    // a number is true
+    return (is_immediate() || static_cast<bool>(*get()));
+}
+
+template <typename T>
+inline ostream& ref_ptr<T>::write(ostream& os) const {
+    if (is_immediate()) {
+        return value_number::write(os, value::_decode(_word));
+    } else {
+        return get()->write(os);
+    }
+}
+
+template <typename T>
+template <typename U>
+inline bool ref_ptr<T>::equals(const ref_ptr<U>& other) const {
+    if (is_immediate() || other.is_immediate()) {
+        // a boxed number equals an immediate
+        return (type() == value_t::number &&
+                other.type() == value_t::number &&
+                number() == other.number());
+    } else {
+        return get()->equals(*other.get());
+    }
+}
+
 class value_symbol : public value {
    public:
     // singleton instance getter
-    static const shared_ptr<value_symbol>& get(const string& symbol);
+    static const ref_ptr<value_symbol>& get(const string& symbol);
 
     // getter only
     const string& symbol() const { return _symbol; }
 
+    // small and dense: in the order of interning
+    size_t id() const { return _id; }
+
     // can't copy or move a singleton
     value_symbol(const value_symbol&) = delete;
     void operator=(value_symbol const&) = delete;
@@ -120,9 +440,10 @@ class value_symbol : public value {
 
    private:
     // can't instantiate a singleton
-    value_symbol(const string symbol) : value(value_t::symbol), _symbol(symbol) {}
+    value_symbol(const string symbol, size_t id) : value(value_t::symbol), _symbol(symbol), _id(id) {}
 
     string _symbol;
+    size_t _id;
 };
 
 class value_string : public value {
@@ -188,7 +509,7 @@ class value_info : public value_format {
 class value_bool : public value {
    public:
     // singleton instance getter
-    static const shared_ptr<value_bool>& get(bool truth);
+    static const ref_ptr<value_bool>& get(bool truth);
 
     // getter only
     bool truth() const { return _truth; }
@@ -209,47 +530,48 @@ class value_bool : public value {
 };
 
 // singleton bools
-const shared_ptr<value_bool> true_ = value_bool::get(true);
-const shared_ptr<value_bool> false_ = value_bool::get(false);
+const ref_ptr<value_bool> true_ = value_bool::get(true);
+const ref_ptr<value_bool> false_ = value_bool::get(false);
 
 class value_pair : public value {
    public:
-    template <typename T>
+    // iterates over the handles: an
+    // immediate item has no object
     struct value_iterator {
        public:
         // iterator traits
         using iterator_category = forward_iterator_tag;
         using difference_type = ptrdiff_t;
-        using value_type = T;
-        using pointer = T*;
-        using reference = T&;
+        using value_type = value_ref;
+        using pointer = const value_ref*;
+        using reference = const value_ref&;
 
         value_iterator(const value_pair* ptr) : _ptr(ptr) {}
 
         reference operator*() const {
-            return *(_at_cdr ? _ptr->_cdr : _ptr->_car);
+            return (_at_cdr ? _ptr->_cdr : _ptr->_car);
         }
 
         pointer operator->() {
-            return (_at_cdr ? _ptr->_cdr : _ptr->_car).get();
+            return &(_at_cdr ? _ptr->_cdr : _ptr->_car);
         }
 
-        value_iterator<T>& operator++() {
+        value_iterator& operator++() {
             _advance();
             return *this;
         }
 
-        value_iterator<T> operator++(int) {
-            value_iterator<T> tmp = *this;
+        value_iterator operator++(int) {
+            value_iterator tmp = *this;
             _advance();
             return tmp;
         }
 
-        friend bool operator==(const value_iterator<T>& a, const value_iterator<T>& b) {
+        friend bool operator==(const value_iterator& a, const value_iterator& b) {
             return a._ptr == b._ptr && a._at_cdr == b._at_cdr;
         };
 
-        friend bool operator!=(const value_iterator<T>& a, const value_iterator<T>& b) {
+        friend bool operator!=(const value_iterator& a, const value_iterator& b) {
             return a._ptr != b._ptr || a._at_cdr != b._at_cdr;
         };
 
@@ -258,7 +580,7 @@ class value_pair : public value {
             // move the iterator one step forward.
             // if the terminal cdr is not a pair,
             // return it before terminating
-            value_t cdr_type = _ptr->cdr()->type();
+            value_t cdr_type = _ptr->cdr().type();
             if (cdr_type == value_t::pair) {
                 // cdr is a pair
                 _ptr = reinterpret_cast<value_pair*>(_ptr->cdr().get());
@@ -281,18 +603,18 @@ class value_pair : public value {
         bool _at_cdr{false};
     };
 
-    using iterator = value_iterator<value>;
-    using const_iterator = value_iterator<const value>;
+    using iterator = value_iterator;
+    using const_iterator = value_iterator;
 
-    // car and cdr shared ptrs are passed by copying
+    // car and cdr handles are passed by copying
     value_pair(
         value_t type,
-        const shared_ptr<value>& car,
-        const shared_ptr<value>& cdr)
+        const value_ref& car,
+        const value_ref& cdr)
         : value(type), _car(car), _cdr(cdr) {}
     value_pair(
-        const shared_ptr<value>& car,
-        const shared_ptr<value>& cdr)
+        const value_ref& car,
+        const value_ref& cdr)
         : value_pair(value_t::pair, car, cdr) {}
 
     virtual iterator begin() const {
@@ -312,8 +634,8 @@ class value_pair : public value {
     }
 
     // getters
-    const shared_ptr<value>& car() const { return _car; }
-    const shared_ptr<value>& cdr() const { return _cdr; }
+    const value_ref& car() const { return _car; }
+    const value_ref& cdr() const { return _cdr; }
 
     // naked pair getters
     const value_pair* pcar() const {
@@ -324,36 +646,62 @@ class value_pair : public value {
     }
 
     // setters
-    void car(const shared_ptr<value>& car, bool check_cycle = true) {
+    void car(const value_ref& car, bool check_cycle = true) {
         if (check_cycle) {
             _throw_on_cycle_from(car);
         }
         _car = car;
+        if (_syntax) {
+            ++_mutations;
+        }
     }
-    void cdr(const shared_ptr<value>& cdr, bool check_cycle = true) {
+    void cdr(const value_ref& cdr, bool check_cycle = true) {
         if (check_cycle) {
             _throw_on_cycle_from(cdr);
         }
         _cdr = cdr;
+        if (_syntax) {
+            ++_mutations;
+        }
     }
 
+    // the pair is read by memoized syntax checks or
+    // transformations: its setters count the mutations
+    void mark_syntax() const { _syntax = true; }
+
+    // the mutations of the marked pairs on the current thread
+    static size_t mutations() { return _mutations; }
+
     ostream& write(ostream& os) const override;
     bool equals(const value& other) const override;
 
     virtual bool is_list() const;
     virtual size_t length() const;
 
+   protected:
+    void _trace(value_tracer& tracer) const override {
+        tracer(_car);
+        tracer(_cdr);
+    }
+
+    void _clear() override {
+        _car.reset();
+        _cdr.reset();
+    }
+
    private:
-    void _throw_on_cycle_from(const shared_ptr<value>& other);
+    void _throw_on_cycle_from(const value_ref& other);
 
-    shared_ptr<value> _car;
-    shared_ptr<value> _cdr;
+    value_ref _car;
+    value_ref _cdr;
+
+    static thread_local size_t _mutations;
 };
 
 class value_nil : public value_pair {
    public:
     // singleton instance getter
-    static const shared_ptr<value_nil>& get();
+    static const ref_ptr<value_nil>& get();
 
     // can't copy or move a singleton
     value_nil(const value_nil&) = delete;
@@ -395,7 +743,7 @@ class value_nil : public value_pair {
 };
 
 // singleton nil
-const shared_ptr<value_pair> nil = value_nil::get();
+const ref_ptr<value_pair> nil = value_nil::get();
 value_pair* const nilptr = nil.get();
 
 // factory functions
@@ -404,84 +752,84 @@ template <typename T,
           typename enable_if<
               is_convertible<T, double>::value,
               bool>::type = true>  // poor man's concept
-inline shared_ptr<value_number> make_value(T number) {
-    // from the number
-    return make_shared<value_number>(number);
+inline ref_ptr<value_number> make_value(T number) {
+    // from the number: an immediate
+    return ref_ptr<value_number>::immediate(number);
 }
 
 template <typename T,
           typename enable_if<
               is_convertible<T, double>::value,
               bool>::type = true>  // poor man's concept
-inline shared_ptr<value_number> make_number(T number) {
+inline ref_ptr<value_number> make_number(T number) {
     return make_value(number);
 }
 
-inline const shared_ptr<value_symbol>& make_value(const char* symbol) {
+inline const ref_ptr<value_symbol>& make_value(const char* symbol) {
     // from the singleton table
     return value_symbol::get(symbol);
 }
 
-inline const shared_ptr<value_symbol>& make_symbol(const char* symbol) {
+inline const ref_ptr<value_symbol>& make_symbol(const char* symbol) {
     return make_value(symbol);
 }
 
-inline const shared_ptr<value_symbol>& make_symbol(const string& symbol) {
+inline const ref_ptr<value_symbol>& make_symbol(const string& symbol) {
     return make_value(symbol.c_str());
 }
 
-inline shared_ptr<value_string> make_value(const string& string_) {
+inline ref_ptr<value_string> make_value(const string& string_) {
     // from the string
-    return make_shared<value_string>(string_);
+    return make_ref<value_string>(string_);
 }
 
-inline shared_ptr<value_string> make_string(const char* string_) {
+inline ref_ptr<value_string> make_string(const char* string_) {
     return make_value(string(string_));
 }
 
-inline shared_ptr<value_string> make_string(const string& string_) {
+inline ref_ptr<value_string> make_string(const string& string_) {
     return make_value(string_);
 }
 
-inline const shared_ptr<value_bool>& make_value(bool truth) {
+inline const ref_ptr<value_bool>& make_value(bool truth) {
     // from the singletons
     return value_bool::get(truth);
 }
 
-inline const shared_ptr<value_bool>& make_bool(bool truth) {
+inline const ref_ptr<value_bool>& make_bool(bool truth) {
     return make_value(truth);
 }
 
-inline const shared_ptr<value_nil>& make_nil() {
+inline const ref_ptr<value_nil>& make_nil() {
     // from the singleton
     return value_nil::get();
 }
 
-inline shared_ptr<value> make_value(const shared_ptr<value>& val) {
+inline value_ref make_value(const value_ref& val) {
     // from const lvalue reference: copy
     return val;
 }
 
-inline shared_ptr<value>& make_value(shared_ptr<value>& val) {
+inline value_ref& make_value(value_ref& val) {
     // from lvalue reference: identity
     return val;
 }
 
-inline shared_ptr<value>& make_value(shared_ptr<value>&& val) {
+inline value_ref& make_value(value_ref&& val) {
     // from rvalue reference: identity
     return val;
 }
 
 template <typename T1, typename T2>
-shared_ptr<value_pair> make_vpair(T1&& car, T2&& cdr) {
+ref_ptr<value_pair> make_vpair(T1&& car, T2&& cdr) {
     // from two separate universal references: car and cdr
-    return make_shared<value_pair>(
+    return make_ref<value_pair>(
         make_value(forward<T1>(car)),
         make_value(forward<T2>(cdr)));
 }
 
 template <typename Head, typename... Tail>
-shared_ptr<value_pair> make_list(Head&& first, Tail&&... rest) {
+ref_ptr<value_pair> make_list(Head&& first, Tail&&... rest) {
     if constexpr (sizeof...(rest) > 0) {
         return make_vpair(
             make_value(forward<Head>(first)),    // the head
@@ -494,13 +842,13 @@ shared_ptr<value_pair> make_list(Head&& first, Tail&&... rest) {
 }
 
 template <typename... Args>
-inline shared_ptr<value_error> make_error(const char* format, Args... args) {
-    return make_shared<value_error>(format, forward<Args>(args)...);
+inline ref_ptr<value_error> make_error(const char* format, Args... args) {
+    return make_ref<value_error>(format, forward<Args>(args)...);
 }
 
 template <typename... Args>
-inline shared_ptr<value_info> make_info(const char* format, Args... args) {
-    return make_shared<value_info>(format, forward<Args>(args)...);
+inline ref_ptr<value_info> make_info(const char* format, Args... args) {
+    return make_ref<value_info>(format, forward<Args>(args)...);
 }
 
 // helper functions
@@ -509,6 +857,11 @@ inline ostream& operator<<(ostream& os, const value& v) {
     return v.write(os);
 }
 
+template <typename T>
+inline ostream& operator<<(ostream& os, const ref_ptr<T>& v) {
+    return v.write(os);
+}
+
 inline bool operator==(const value& v1, const value& v2) {
     return (&v1 == &v2 || v1.equals(v2));
 }
@@ -527,16 +880,16 @@ template <typename T,
           typename enable_if<
               is_base_of<value, T>::value,
               bool>::type = true>  // poor man's concept
-inline shared_ptr<T> to_sptr(const shared_ptr<value>& v) {
-    return reinterpret_pointer_cast<T>(v);
+inline ref_ptr<T> to_sptr(const value_ref& v) {
+    return ref_ptr<T>::cast(v);
 }
 
 template <typename T,
           typename enable_if<
               is_base_of<value, T>::value,
               bool>::type = true>  // poor man's concept
-inline T* to_ptr(const shared_ptr<value>& v) {
-    return reinterpret_cast<T*>(v.get());
+inline T* to_ptr(const value_ref& v) {
+    return static_cast<T*>(v.get());
 }
 
 #endif  // VALUE_HPP_